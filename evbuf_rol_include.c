@@ -0,0 +1,97 @@
+#pragma once
+/*************************************************************************
+ *
+ *  evbuf_rol_include.c -
+ *
+ *   Event buffer budget for the module readouts.
+ *
+ *   The end of the buffer the event is built in is set at each trigger
+ *   (rolBufSet), less ROL_BUF_MARGIN words.  A module limits its DMA to
+ *   the space left before that end (rolBufLimit).  Its bank header,
+ *   padding and a truncation marker may run past it, into the margin
+ *   (ROL_BUF_RESERVE words a bank, for up to 8 banks).  Buffers are
+ *   sized with the margin on top.  If the block did not fit (rolBufShort:
+ *   the DMA filled the limit without reaching the block trailer), the
+ *   readout scheduler drops the rest of the block from the module and
+ *   writes a marker bank after the module's bank:
+ *
+ *     ROL_TRUNC_BANK, num = module index (order of registration)
+ *       words kept
+ *       words dropped
+ *
+ *   A module bank staged ahead of its turn that no longer fits in the
+ *   event is dropped as a whole, with the same marker (0 words kept).
+ *
+ *   With no end set (rolBufEnd == NULL), e.g. lists that do not use the
+ *   readout scheduler, the modules read up to their own maximum.
+ */
+
+#include <stdlib.h>
+
+#define ROL_BUF_RESERVE 8           /* words: bank header, padding, marker bank */
+#define ROL_BUF_MARGIN  (8 * ROL_BUF_RESERVE)
+#define ROL_TRUNC_BANK  0xEE
+
+unsigned int *rolBufEnd = NULL;     /* end of the current buffer, less the margin */
+int rolBufTrunc = 0;                /* set by rolBufShort(), for the scheduler */
+
+static inline void
+rolBufSet(unsigned int *buf, int bytes)
+{
+  rolBufEnd = (buf) ? buf + (bytes >> 2) - ROL_BUF_MARGIN : NULL;
+}
+
+/* Words a module may read at dma_dabufp, for a block of up to nwords.
+   Even, for 64 bit transfers. */
+static inline int
+rolBufLimit(int nwords)
+{
+  int room;
+
+  if(rolBufEnd == NULL)
+    return nwords;
+
+  room = rolBufEnd - dma_dabufp;
+  if(room >= nwords)
+    return nwords;
+
+  return (room > 0) ? (room & ~1) : 0;
+}
+
+/* Block trailer (type 1) at the end of data, possibly followed by a
+   filler (type 15).  Data as read (byte swapped). */
+static inline int
+rolBufBlockComplete(volatile unsigned int *data, int nwords)
+{
+  unsigned int word;
+
+  if(nwords <= 0)
+    return 0;
+
+  word = LSWAP(data[nwords - 1]);
+  if(((word & 0xF8000000) == 0xF8000000) && (nwords > 1))
+    word = LSWAP(data[nwords - 2]);
+
+  return ((word & 0xF8000000) == 0x88000000);
+}
+
+/* After a DMA of up to limit (from rolBufLimit) words of a block of up
+   to full words: 1 if the block was cut short by the buffer budget. */
+static inline int
+rolBufShort(volatile unsigned int *data, int nread, int limit, int full)
+{
+  if(limit >= full)
+    return 0;
+
+  if((nread > 0) && ((nread < limit) || rolBufBlockComplete(data, nread)))
+    return 0;
+
+  rolBufTrunc = 1;
+  return 1;
+}
+
+/*
+  Local Variables:
+  compile-command: "make -k"
+  End:
+*/
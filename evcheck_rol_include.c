@@ -0,0 +1,336 @@
+#pragma once
+/*************************************************************************
+ *
+ *  evcheck_rol_include.c -
+ *
+ *   Event number and time stamp check of the module blocks against the
+ *   TI trigger block, in the ROC, to catch a module out of step as it
+ *   happens.
+ *
+ *   Every rolCheckEvery blocks, rocTrigger picks up the first event of
+ *   the TI trigger block (rolCheckStart), each module its own block
+ *   header (rolCheckBlock, from the readout), and the two are compared
+ *   once all modules are read (rolCheckTrigger).  Fields are taken at
+ *   fixed offsets, nothing is scanned:
+ *
+ *     TI (host order)    1: 0xFF1x bank header   2: event header
+ *                        3: event number   4, 5: time stamp (48 bits)
+ *     FADC / SSP         0: block header (type 0)
+ *                        1: event header (type 2), event number (22 bits)
+ *                     2, 3: trigger time (type 3, 2 x 24 bits)
+ *
+ *   A module block is flagged if
+ *     - its event number is not the TI's (22 bits)
+ *     - its time stamp is off from the TI's by more than ROL_CHECK_TS_TOL
+ *       ticks, beyond the offset seen at the first check of the run
+ *     - the words at those offsets are not the headers
+ *   Flags are counted per module, and written with rolLog at most once
+ *   per module every ROL_CHECK_REPORT_MS.  Counts are printed at End.
+ *   Modules not read out for a trigger (rolSchedTable) are not checked.
+ *
+ *   Set with rolCheckSetEvery(int every);  0: no checks, 1: every block
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "poll_rol_include.c"
+#include "log_rol_include.c"
+
+#define ROL_CHECK_MAX         8
+#define ROL_CHECK_REPORT_MS   1000
+#ifndef ROL_CHECK_EVERY
+#define ROL_CHECK_EVERY       1
+#endif
+#ifndef ROL_CHECK_TS_TOL
+#define ROL_CHECK_TS_TOL      2           /* ticks */
+#endif
+
+#define ROL_CHECK_TS_MASK     0xFFFFFFFFFFFFULL
+
+typedef struct
+{
+  char name[24];
+  char fmt_event[96];                 /* rolLog formats, with the name */
+  char fmt_time[96];
+  char fmt_format[96];
+
+  /* this trigger */
+  int seen, bad;
+  unsigned int header, evnum;
+  uint64_t ts;
+
+  /* time stamp offset from the TI, at the first check */
+  int have_offset;
+  int64_t offset;
+
+  /* per-run statistics */
+  unsigned int nchecked;
+  unsigned int nevent, ntime, nformat;
+  unsigned int first_bad;             /* TI event number */
+  int64_t slip_max;
+
+  /* reports */
+  unsigned long long report_ns;
+  unsigned int nquiet;                /* flags not written since */
+} ROL_CHECK;
+
+static ROL_CHECK rolCheck[ROL_CHECK_MAX];
+static int nrolCheck = 0;
+
+int rolCheckEvery = ROL_CHECK_EVERY;
+
+static int rolCheckSample = 0;        /* checking this trigger */
+static int rolCheckCount = 0;         /* blocks to the next check */
+static unsigned int rolCheckEvnum = 0;
+static uint64_t rolCheckTs = 0;
+
+/* per-run statistics */
+static unsigned int rolCheckNsample = 0, rolCheckTiFormat = 0;
+
+void
+rolCheckSetEvery(int every)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, every);
+      return;
+    }
+
+  rolCheckEvery = (every > 0) ? every : 0;
+  if(rolCheckEvery)
+    daLogMsg("INFO","Setting event number / time stamp check (every %d blocks)",
+	     rolCheckEvery);
+  else
+    daLogMsg("INFO","Disabling event number / time stamp check");
+}
+
+/* Register a module (at Download).  Returns its id for rolCheckBlock(),
+   -1 if there is no room. */
+int
+rolCheckRegister(const char *name)
+{
+  ROL_CHECK *c;
+  int id;
+
+  for(id = 0; id < nrolCheck; id++)
+    if(strncmp(rolCheck[id].name, name, sizeof(rolCheck[id].name) - 1) == 0)
+      return id;
+
+  if(nrolCheck >= ROL_CHECK_MAX)
+    {
+      printf("%s: ERROR: Too many modules (max = %d).  Ignoring %s\n",
+	     __func__, ROL_CHECK_MAX, name);
+      return -1;
+    }
+
+  c = &rolCheck[nrolCheck];
+  memset(c, 0, sizeof(ROL_CHECK));
+  strncpy(c->name, name, sizeof(c->name) - 1);
+  snprintf(c->fmt_event, sizeof(c->fmt_event),
+	   "%s: block of event %%ld, TI event %%ld (%%ld more not shown)\n", name);
+  snprintf(c->fmt_time, sizeof(c->fmt_time),
+	   "%s: time stamp %%ld ticks off, TI event %%ld (%%ld more not shown)\n", name);
+  snprintf(c->fmt_format, sizeof(c->fmt_format),
+	   "%s: 0x%%08lx for the event header, TI event %%ld (%%ld more not shown)\n",
+	   name);
+
+  return nrolCheck++;
+}
+
+/* Forget the offsets and counts.  Called at Go. */
+void
+rolCheckGo()
+{
+  int id;
+
+  for(id = 0; id < nrolCheck; id++)
+    {
+      ROL_CHECK *c = &rolCheck[id];
+
+      c->seen = c->bad = 0;
+      c->have_offset = 0;
+      c->offset = 0;
+      c->nchecked = c->nevent = c->ntime = c->nformat = 0;
+      c->first_bad = 0;
+      c->slip_max = 0;
+      c->report_ns = 0;
+      c->nquiet = 0;
+    }
+
+  rolCheckSample = rolCheckCount = 0;
+  rolCheckNsample = rolCheckTiFormat = 0;
+}
+
+/* Before the readout of a trigger: check this one?  Takes the first
+   event of the TI trigger block (tiReadTriggerBlock). */
+static inline void
+rolCheckStart(volatile unsigned int *tiblock, int nwords)
+{
+  rolCheckSample = 0;
+  if((rolCheckEvery == 0) || (--rolCheckCount > 0))
+    return;
+  rolCheckCount = rolCheckEvery;
+
+  if((nwords < 6) || ((tiblock[1] >> 20) != 0xFF1) || ((tiblock[2] & 0xFFFF) < 3))
+    {
+      rolCheckTiFormat++;
+      return;
+    }
+
+  rolCheckEvnum = tiblock[3];
+  rolCheckTs = tiblock[4] | ((uint64_t)(tiblock[5] & 0xFFFF) << 32);
+  rolCheckSample = 1;
+}
+
+/* The block read from a module (data as read, before any packing) */
+static inline void
+rolCheckBlock(int id, volatile unsigned int *data, int nwords)
+{
+  ROL_CHECK *c;
+  unsigned int w1, w2;
+
+  if(!rolCheckSample || (id < 0))
+    return;
+
+  c = &rolCheck[id];
+  c->seen = 1;
+  c->bad = 1;
+  c->header = (nwords > 1) ? LSWAP(data[1]) : 0;
+
+  if(nwords < 4)
+    return;
+
+  w1 = c->header;
+  w2 = LSWAP(data[2]);
+  if(((LSWAP(data[0]) & 0xF8000000) != 0x80000000) ||
+     ((w1 & 0xF8000000) != 0x90000000) || ((w2 & 0xF8000000) != 0x98000000))
+    return;
+
+  c->evnum = w1 & 0x3FFFFF;
+  c->ts = (w2 & 0xFFFFFF) | ((uint64_t)(LSWAP(data[3]) & 0xFFFFFF) << 24);
+  c->bad = 0;
+}
+
+/* Time for another report from this module? */
+static int
+rolCheckReport(ROL_CHECK *c)
+{
+  unsigned long long now = rolPollNow();
+
+  if(c->report_ns && (now - c->report_ns < 1000000ULL * ROL_CHECK_REPORT_MS))
+    {
+      c->nquiet++;
+      return 0;
+    }
+
+  c->report_ns = now;
+  return 1;
+}
+
+/* Count a flag, and write it (fmt: what was seen, the TI event number) */
+static void
+rolCheckFlag(ROL_CHECK *c, unsigned int *count, const char *fmt, long seen)
+{
+  if((c->nevent + c->ntime + c->nformat) == 0)
+    c->first_bad = rolCheckEvnum;
+  (*count)++;
+
+  if(rolCheckReport(c))
+    {
+      rolLog(ROL_LOG_WARN, fmt, seen, (long) rolCheckEvnum, (long) c->nquiet);
+      c->nquiet = 0;
+    }
+}
+
+/* After the readout of a trigger: compare the modules read with the TI */
+static inline void
+rolCheckTrigger()
+{
+  int id;
+  int64_t delta, slip;
+
+  if(!rolCheckSample)
+    return;
+  rolCheckSample = 0;
+  rolCheckNsample++;
+
+  for(id = 0; id < nrolCheck; id++)
+    {
+      ROL_CHECK *c = &rolCheck[id];
+
+      if(!c->seen)
+	continue;
+      c->seen = 0;
+      c->nchecked++;
+
+      if(c->bad)
+	{
+	  rolCheckFlag(c, &c->nformat, c->fmt_format, (long) c->header);
+	  continue;
+	}
+
+      if(c->evnum != (rolCheckEvnum & 0x3FFFFF))
+	{
+	  rolCheckFlag(c, &c->nevent, c->fmt_event, (long) c->evnum);
+	  continue;
+	}
+
+      /* 48 bit difference, signed */
+      delta = (int64_t)(((c->ts - rolCheckTs) & ROL_CHECK_TS_MASK) << 16) >> 16;
+      if(!c->have_offset)
+	{
+	  c->offset = delta;
+	  c->have_offset = 1;
+	  continue;
+	}
+
+      slip = delta - c->offset;
+      if((slip > ROL_CHECK_TS_TOL) || (slip < -ROL_CHECK_TS_TOL))
+	{
+	  if(((slip < 0) ? -slip : slip) > ((c->slip_max < 0) ? -c->slip_max : c->slip_max))
+	    c->slip_max = slip;
+	  rolCheckFlag(c, &c->ntime, c->fmt_time, (long) slip);
+	}
+    }
+}
+
+void
+rolCheckStatus()
+{
+  int id;
+
+  if((nrolCheck == 0) || (rolCheckEvery == 0))
+    return;
+
+  printf("\n%s: Event number / time stamp checks (every %d blocks) - %u blocks checked",
+	 __func__, rolCheckEvery, rolCheckNsample);
+  if(rolCheckTiFormat)
+    printf(", %u TI blocks without event number / time stamp", rolCheckTiFormat);
+  printf("\n");
+
+  if(rolCheckNsample == 0)
+    return;
+
+  printf("  Module      Checked   Event    Time  Format   TI offset  Slip max  First bad\n");
+  printf("-------------------------------------------------------------------------------\n");
+  for(id = 0; id < nrolCheck; id++)
+    {
+      ROL_CHECK *c = &rolCheck[id];
+
+      printf("  %-10s %8u %7u %7u %7u  %10lld %9lld",
+	     c->name, c->nchecked, c->nevent, c->ntime, c->nformat,
+	     (long long) c->offset, (long long) c->slip_max);
+      if(c->nevent + c->ntime + c->nformat)
+	printf("  %9u", c->first_bad);
+      printf("\n");
+    }
+  printf("-------------------------------------------------------------------------------\n");
+}
+
+/*
+  Local Variables:
+  compile-command: "make -k"
+  End:
+*/
@@ -11,6 +11,12 @@
 
 #include "fadcLib.h"        /* library of FADC250 routines */
 #include "fadc250Config.h"
+#include "poll_rol_include.c"
+#include "log_rol_include.c"
+#include "pack_rol_include.c"
+#include "evbuf_rol_include.c"
+#include "sizemon_rol_include.c"
+#include "evcheck_rol_include.c"
 
 /* FADC Library Variables */
 extern int32_t nfadc;
@@ -21,6 +27,7 @@ extern uint32_t fadcA32Base;
 /* Increment address to find next fADC250 */
 #define FADC_INCR (1<<19)
 #define FADC_BANK 0x3
+#define FADC_PACKED_BANK (0x100 | FADC_BANK)
 
 #define FADC_READ_CONF_FILE {			\
     fadc250Config("/home/solid/sbsvme22/cfg/fa250/sbsvme22.cnf");	\
@@ -28,15 +35,46 @@ extern uint32_t fadcA32Base;
       fadc250Config(configFilename);		\
   }
 
+/* Give up waiting for block ready after (us) */
+#ifndef FA250_READY_TIMEOUT
+#define FA250_READY_TIMEOUT 500
+#endif
+ROL_POLL fa250_Poll;
+ROL_PACK fa250_Pack;
+int fa250_MaxWords(); // routine prototype
+static int fa250_Size = -1;
+static int fa250_Check = -1;
+
 /* for the calculation of maximum data words in the block transfer */
 unsigned int MAXFADCWORDS=0;
 
+/* Per board (faSlot(ifa) order): words of a block from its own mode,
+   window and channel mask, at Go.  MAXFADCWORDS is their sum.  The words
+   seen per block are tracked against them. */
+typedef struct
+{
+  int32_t  mode;
+  uint32_t ptw, nsb, nsa, np, chmask;
+  unsigned int maxwords;            /* budget */
+  unsigned int nblocks;             /* seen, this run */
+  unsigned int words_max;
+  unsigned long long words_sum;
+} FA250_BOARD;
+
+FA250_BOARD fa250_Board[FA_MAX_BOARDS];
+static signed char fa250_SlotIndex[32];
+
 void
 fa250_Download(char* configFilename)
 {
   unsigned short iflag;
   int ifa, stat;
 
+  rolPollInit(&fa250_Poll, "FADC250", FA250_READY_TIMEOUT);
+  rolPackInit(&fa250_Pack, "FADC250", ROL_PACK_FADC);
+  fa250_Size = rolSizeRegister("FADC250");
+  fa250_Check = rolCheckRegister("FADC250");
+
   /*****************
    *   FADC SETUP
    *****************/
@@ -104,30 +142,140 @@ fa250_Prestart()
 
 }
 
+/* Words per channel per event for a processing mode (most if unknown) */
+static unsigned int
+fa250_ChannelWords(int mode, unsigned int ptw, unsigned int nsb,
+		   unsigned int nsa, unsigned int np)
+{
+  unsigned int raw = 1 + (ptw + 1) / 2;               /* header + 2 samples/word */
+  unsigned int pulse = 1 + ((nsb & 0x7) + nsa + 1) / 2;
+  unsigned int param = 1 + 2 * np;                    /* header + 2 words/pulse */
+
+  switch(mode)
+    {
+    case 1:  return raw;
+    case 2:  return np * pulse;                       /* pulse raw */
+    case 3:  return np;                               /* integral */
+    case 4:  return np;                               /* time */
+    case 7:  return 2 * np;                           /* integral + time */
+    case 8:  return raw + np;
+    case 9:  return param;
+    case 10: return raw + param;
+    default:
+      return raw + ((np * pulse > param) ? np * pulse : param);
+    }
+}
+
+/* Block words of each board, from its own settings */
+static void
+fa250_BoardWords(int blocklevel)
+{
+  FA250_BOARD *b;
+  uint32_t pl = 0;
+  int ifa, ich, nch;
+
+  memset(fa250_SlotIndex, -1, sizeof(fa250_SlotIndex));
+  MAXFADCWORDS = 0;
+
+  for(ifa = 0; ifa < nfadc; ifa++)
+    {
+      b = &fa250_Board[ifa];
+      memset(b, 0, sizeof(FA250_BOARD));
+      fa250_SlotIndex[faSlot(ifa) & 0x1f] = ifa;
+
+      faGetProcMode(faSlot(ifa), &b->mode, &pl, &b->ptw, &b->nsb, &b->nsa, &b->np);
+      b->chmask = faGetChannelMask(faSlot(ifa)) & 0xFFFF;
+      for(ich = 0, nch = 0; ich < FA_MAX_ADC_CHANNELS; ich++)
+	nch += (b->chmask >> ich) & 1;
+
+      /* Block Header + Trailer + 2 possible filler words
+	 + blockLevel * (Event Header + Header2 + Timestamp1 + Timestamp2 +
+	                 nchan * words per channel)
+	 + scaler readout (16 channels + header/trailer) */
+      b->maxwords = 4 + blocklevel *
+	(4 + nch * fa250_ChannelWords(b->mode, b->ptw, b->nsb, b->nsa, b->np)) + 18;
+      MAXFADCWORDS += b->maxwords;
+    }
+}
+
+/* Words of each board in a block as read (multiblock: one after another).
+   Hops from trailer to header, back from the end of the block, with the
+   word count of each block trailer: a few words per board, not the data. */
+static void
+fa250_BoardCount(volatile unsigned int *data, int nwords)
+{
+  unsigned int w;
+  int i = nwords - 1, start, slot, ifa, n, filler = 0;
+
+  while(i >= 0)
+    {
+      w = LSWAP(data[i]);
+      if((w & 0xF8000000) == 0xF8000000)        /* filler */
+	{
+	  filler++;
+	  i--;
+	  continue;
+	}
+      if((w & 0xF8000000) != 0x88000000)        /* not a block trailer */
+	return;
+
+      slot = (w >> 22) & 0x1f;
+      n = w & 0x3FFFFF;
+      start = i - n + 1;
+      if((n < 2) || (start < 0) ||
+	 ((LSWAP(data[start]) & 0xFFC00000) != (0x80000000 | (slot << 22))))
+	return;
+
+      ifa = fa250_SlotIndex[slot];
+      if(ifa >= 0)
+	{
+	  n += filler;
+	  fa250_Board[ifa].nblocks++;
+	  fa250_Board[ifa].words_sum += n;
+	  if(n > fa250_Board[ifa].words_max)
+	    fa250_Board[ifa].words_max = n;
+	}
+
+      filler = 0;
+      i = start - 1;
+    }
+}
+
+/* Budget and words seen, per board */
+void
+fa250_BoardStatus()
+{
+  FA250_BOARD *b;
+  int ifa;
+
+  printf("  FADC250 block words per board (budget %d words)\n", MAXFADCWORDS);
+  printf("    Slot Mode  PTW  NP  Channels  Budget    Avg     Max\n");
+  for(ifa = 0; ifa < nfadc; ifa++)
+    {
+      b = &fa250_Board[ifa];
+      printf("    %4d %4d %4d %3d    0x%04x  %6u %6.1f  %6u%s\n",
+	     faSlot(ifa), b->mode, b->ptw, b->np, b->chmask, b->maxwords,
+	     (b->nblocks) ? (double) b->words_sum / b->nblocks : 0.,
+	     b->words_max, (b->words_max > b->maxwords) ? "  over budget" : "");
+    }
+}
+
 void
 fa250_Go()
 {
-  int32_t fadc_mode = 0;
-  uint32_t blocklevel = 0, pl=0, ptw=0, nsb=0, nsa=0, np=0;
+  uint32_t blocklevel = 0;
+
 
+  rolPollClear(&fa250_Poll);
 
   /* Get the current block level */
   blocklevel = tiGetCurrentBlockLevel();
 
   faGSetBlockLevel(blocklevel);
 
-  /* Get the FADC mode and window size to determine max data size */
-  faGetProcMode(faSlot(0), &fadc_mode, &pl, &ptw,
-		&nsb, &nsa, &np);
-
-  /* Set Max words from fadc (proc mode == 1 produces the most)
-     nfadc * ( Block Header + Trailer + 2  # 2 possible filler words
-               blockLevel * ( Event Header + Header2 + Timestamp1 + Timestamp2 +
-	                      nchan * (Channel Header + (WindowSize / 2) )
-             ) +
-     scaler readout # 16 channels + header/trailer
-   */
-  MAXFADCWORDS = nfadc * (4 + blocklevel * (4 + 16 * (1 + (ptw / 2))) + 18);
+  /* Max words from each FADC's mode, window and enabled channels */
+  fa250_BoardWords(blocklevel);
+  rolPackGo(&fa250_Pack, fa250_MaxWords());
 
   /*  Enable FADC */
   faGEnable(0, 0);
@@ -145,15 +293,32 @@ fa250_End()
   /* FADC Event status - Is all data read out */
   faGStatus(0);
 
+  fa250_BoardStatus();
+  rolPackStatus(&fa250_Pack);
+
   printf("%s: done\n", __func__);
 
 }
 
-void
-fa250_Trigger(int arg)
+/* Last readiness check, for error reporting in fa250_Readout() */
+static unsigned int fa250_datascan = 0;
+
+/* Non-blocking check for a block ready in all initialized modules */
+int
+fa250_Ready()
+{
+  unsigned int scanmask = faScanMask();
+
+  fa250_datascan = faGBlockReady(scanmask, 1);
+
+  return (fa250_datascan == scanmask);
+}
+
+/* Readout the FADC bank.  ready = 0 if the block was never ready. */
+int
+fa250_Readout(int arg, int ready)
 {
-  int ifa = 0, stat, nwords, dCnt;
-  unsigned int datascan, scanmask;
+  int ifa = 0, nwords, dCnt = 0, maxwords, truncated = 0;
   int roType = 2, roCount = 0, blockError = 0;
 
   roCount = tiGetIntCount();
@@ -171,65 +336,128 @@ fa250_Trigger(int arg)
   /* fADC250 Readout */
   BANKOPEN(FADC_BANK,BT_UI4,0);
 
-  /* Mask of initialized modules */
-  scanmask = faScanMask();
-  /* Check scanmask for block ready up to 100 times */
-  datascan = faGBlockReady(scanmask, 100);
-  stat = (datascan == scanmask);
-
-  if(stat)
+  if(ready)
     {
       if(nfadc == 1)
 	roType = 1;   /* otherwise roType = 2   multiboard reaodut with token passing */
-      nwords = faReadBlock(0, dma_dabufp, MAXFADCWORDS, roType);
+      maxwords = rolBufLimit(MAXFADCWORDS);
+      nwords = faReadBlock(0, dma_dabufp, maxwords, roType);
+      truncated = rolBufShort(dma_dabufp, nwords, maxwords, MAXFADCWORDS);
+      if(truncated)
+	rolLog(ROL_LOG_ERROR, "Event %ld: FADC block truncated at %ld words\n",
+	       roCount, nwords);
 
       /* Check for ERROR in block read */
       blockError = faGetBlockError(1);
 
       if(blockError)
 	{
-	  printf("ERROR: Slot %d: in transfer (event = %d), nwords = 0x%x\n",
+	  rolLog(ROL_LOG_ERROR, "Slot %ld: in transfer (event = %ld), nwords = 0x%lx\n",
 		 faSlot(ifa), roCount, nwords);
 
 	  for(ifa = 0; ifa < nfadc; ifa++)
 	    faResetToken(faSlot(ifa));
 
 	  if(nwords > 0)
-	    dma_dabufp += nwords;
+	    {
+	      dma_dabufp += nwords;
+	      dCnt = nwords;
+	    }
 	}
       else
 	{
+	  fa250_BoardCount(dma_dabufp, nwords);
+	  rolCheckBlock(fa250_Check, dma_dabufp, nwords);
+	  if(!truncated)
+	    rolSizeAdd(fa250_Size, nwords, 1);
 	  dma_dabufp += nwords;
-	  faResetToken(faSlot(0));
+	  dCnt = nwords;
+	  if(!truncated)   /* else when the rest is dropped */
+	    faResetToken(faSlot(0));
 	}
     }
   else
     {
-      printf("ERROR: Event %d: Datascan != Scanmask  (0x%08x != 0x%08x)\n",
-	     roCount, datascan, scanmask);
+      rolLog(ROL_LOG_ERROR, "Event %ld: Datascan != Scanmask  (0x%08lx != 0x%08lx)\n",
+	     roCount, fa250_datascan, faScanMask());
+      rolSizeAdd(fa250_Size, 0, 0);
+    }
+
+  if(rolPackEnable && (dCnt > 0))
+    {
+      unsigned int *end = rolPackBank(&fa250_Pack, StartOfBank, dma_dabufp,
+				      FADC_PACKED_BANK);
+      dCnt -= dma_dabufp - end;
+      dma_dabufp = end;
     }
   BANKCLOSE;
 
+  return dCnt;
+}
 
-  /* Check for SYNC Event */
-  if(tiGetSyncEventFlag() == 1)
+/* Largest FADC bank, in words, for the block level of this run */
+int
+fa250_MaxWords()
+{
+  return MAXFADCWORDS + 2;
+}
+
+/* Read out a block not wanted for this trigger, or the rest of a
+   truncated block, to dma_dabufp (not kept) */
+int
+fa250_Discard()
+{
+  int ifa, nwords;
+
+  vmeDmaConfig(2,5,1);
+  nwords = faReadBlock(0, dma_dabufp, MAXFADCWORDS, (nfadc == 1) ? 1 : 2);
+
+  if(faGetBlockError(1))
     {
       for(ifa = 0; ifa < nfadc; ifa++)
+	faResetToken(faSlot(ifa));
+    }
+  else
+    faResetToken(faSlot(0));
+
+  return nwords;
+}
+
+/* Check for data left in the modules after a SYNC Event */
+void
+fa250_SyncCheck()
+{
+  int ifa;
+
+  for(ifa = 0; ifa < nfadc; ifa++)
+    {
+      int davail = faBready(faSlot(ifa));
+      if(davail > 0)
 	{
-	  int davail = faBready(faSlot(ifa));
-	  if(davail > 0)
-	    {
-	      printf("%s: ERROR: fADC250 Data available (%d) after readout in SYNC event \n",
-		     __func__, davail);
+	  rolLog(ROL_LOG_ERROR, "fa250_SyncCheck: fADC250 Data available (%ld) after readout in SYNC event \n",
+		 davail);
 
-	      while(faBready(faSlot(ifa)))
-		{
-		  vmeDmaFlush(faGetA32(faSlot(ifa)));
-		}
+	  while(faBready(faSlot(ifa)))
+	    {
+	      vmeDmaFlush(faGetA32(faSlot(ifa)));
 	    }
 	}
     }
+}
 
+/* Standalone readout, for lists that do not use the readout scheduler */
+void
+fa250_Trigger(int arg)
+{
+  int ready;
+
+  ready = rolPollWait(&fa250_Poll, fa250_Ready);
+
+  fa250_Readout(arg, ready);
+
+  /* Check for SYNC Event */
+  if(tiGetSyncEventFlag() == 1)
+    fa250_SyncCheck();
 }
 
 void
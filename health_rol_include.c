@@ -0,0 +1,230 @@
+#pragma once
+/*************************************************************************
+ *
+ *  health_rol_include.c -
+ *
+ *   Background health monitor: a low priority thread that, during the
+ *   run (Go to End), calls the registered sample routines every
+ *   rolHealthIntervalMs.
+ *
+ *   The routines of all modules are called back to back, in one batch.
+ *   The batch holds the VME bus lock, which keeps it apart from the
+ *   SSP-MPD recovery steps and the timeout dump only: the readout does
+ *   not take that lock.  Before the batch, the monitor waits up to
+ *   ROL_HEALTH_IDLE_WAIT_MS for the readout to be idle (rolHealthBusy,
+ *   set by rocTrigger), and goes ahead anyway after that, so a busy
+ *   readout still gets sampled.  That wait only makes a sample between
+ *   two triggers likely: a trigger can start right after it, and the
+ *   sampling then overlaps its readout.
+ *
+ *   A sample routine gets the seconds since its previous sample (0 for
+ *   the first of the run), keeps its own trends and notes the warnings
+ *   it raises.  Its report routine, called once the bus lock is
+ *   released, writes them (daLogMsg).
+ *
+ *   Set with rolHealthSetInterval(int ms);   0: no monitor
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "poll_rol_include.c"
+
+#define ROL_HEALTH_MAX           8
+#define ROL_HEALTH_IDLE_WAIT_MS  20
+#define ROL_HEALTH_IDLE_CHECK_US 100
+#ifndef ROL_HEALTH_INTERVAL_MS
+#define ROL_HEALTH_INTERVAL_MS   1000
+#endif
+
+typedef struct
+{
+  const char *name;
+  void (*sample)(double dt);
+  void (*report)();
+} ROL_HEALTH;
+
+static ROL_HEALTH rolHealth[ROL_HEALTH_MAX];
+static int nrolHealth = 0;
+
+unsigned int rolHealthIntervalMs = ROL_HEALTH_INTERVAL_MS;
+volatile int rolHealthBusy = 0;           /* readout in a trigger */
+
+static pthread_t rolHealthThread;
+static volatile int rolHealthRunning = 0;
+
+/* per-run statistics */
+static unsigned int rolHealthNsample = 0, rolHealthNforced = 0;
+static unsigned long long rolHealthTime_sum = 0, rolHealthTime_max = 0;
+
+void
+rolHealthSetInterval(unsigned int ms)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, ms);
+      return;
+    }
+
+  rolHealthIntervalMs = ms;
+  if(ms)
+    daLogMsg("INFO","Setting health monitor interval (%d ms)", ms);
+  else
+    daLogMsg("INFO","Disabling health monitor");
+}
+
+/* Register a sample routine, and the routine that writes the warnings
+   it raised (may be NULL), at Download.  Returns OK or ERROR. */
+int
+rolHealthRegister(const char *name, void (*sample)(double dt), void (*report)())
+{
+  int id;
+
+  for(id = 0; id < nrolHealth; id++)
+    if(rolHealth[id].sample == sample)
+      return OK;
+
+  if(nrolHealth >= ROL_HEALTH_MAX)
+    {
+      printf("%s: ERROR: Too many health monitors (max = %d).  Ignoring %s\n",
+	     __func__, ROL_HEALTH_MAX, name);
+      return ERROR;
+    }
+
+  rolHealth[nrolHealth].name = name;
+  rolHealth[nrolHealth].sample = sample;
+  rolHealth[nrolHealth].report = report;
+  nrolHealth++;
+
+  return OK;
+}
+
+/* Readout in (1) / out of (0) a trigger */
+static inline void
+rolHealthTrigger(int busy)
+{
+  __atomic_store_n(&rolHealthBusy, busy, __ATOMIC_RELAXED);
+}
+
+/* Sleep until t (ns, rolPollNow), in short steps so a stop is seen.
+   Returns 0 if the monitor was stopped. */
+static int
+rolHealthSleepUntil(unsigned long long t)
+{
+  struct timespec ts;
+  unsigned long long now;
+
+  while(rolHealthRunning && ((now = rolPollNow()) < t))
+    {
+      ts.tv_sec = 0;
+      ts.tv_nsec = ((t - now) > 10000000ULL) ? 10000000L : (long)(t - now);
+      nanosleep(&ts, NULL);
+    }
+
+  return rolHealthRunning;
+}
+
+static void *
+rolHealthWorker(void *arg)
+{
+  struct sched_param param;
+  struct timespec idle = {0, 1000L * ROL_HEALTH_IDLE_CHECK_US};
+  unsigned long long next, t0, t1, last = 0, dt;
+  int id, nwait, maxwait;
+
+  /* Only when the CPU has nothing else to do */
+  memset(&param, 0, sizeof(param));
+#ifdef SCHED_IDLE
+  pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+  maxwait = (1000 * ROL_HEALTH_IDLE_WAIT_MS) / ROL_HEALTH_IDLE_CHECK_US;
+  next = rolPollNow();
+
+  while(rolHealthSleepUntil(next))
+    {
+      /* Most likely between two triggers (not a hand off) */
+      for(nwait = 0; rolHealthBusy && (nwait < maxwait); nwait++)
+	nanosleep(&idle, NULL);
+      if(nwait == maxwait)
+	rolHealthNforced++;
+
+      t0 = rolPollNow();
+      vmeBusLock();
+      for(id = 0; id < nrolHealth; id++)
+	rolHealth[id].sample((last) ? 1e-9 * (t0 - last) : 0.);
+      vmeBusUnlock();
+      t1 = rolPollNow();
+      last = t0;
+
+      /* Warnings (daLogMsg) without the bus lock */
+      for(id = 0; id < nrolHealth; id++)
+	if(rolHealth[id].report)
+	  rolHealth[id].report();
+
+      dt = t1 - t0;
+      rolHealthNsample++;
+      rolHealthTime_sum += dt;
+      if(dt > rolHealthTime_max)
+	rolHealthTime_max = dt;
+
+      next += 1000000ULL * rolHealthIntervalMs;
+      if(next < t1)
+	next = t1;
+    }
+
+  return NULL;
+}
+
+/* Start the monitor.  Called at Go, after the modules' Go. */
+void
+rolHealthStart()
+{
+  rolHealthNsample = rolHealthNforced = 0;
+  rolHealthTime_sum = rolHealthTime_max = 0;
+
+  if(rolHealthRunning || (rolHealthIntervalMs == 0) || (nrolHealth == 0))
+    return;
+
+  rolHealthRunning = 1;
+  if(pthread_create(&rolHealthThread, NULL, rolHealthWorker, NULL) != 0)
+    {
+      printf("%s: ERROR: Unable to start the health monitor\n", __func__);
+      rolHealthRunning = 0;
+    }
+}
+
+/* Stop the monitor.  Called at End. */
+void
+rolHealthStop()
+{
+  if(!rolHealthRunning)
+    return;
+
+  rolHealthRunning = 0;
+  pthread_join(rolHealthThread, NULL);
+}
+
+void
+rolHealthStatus()
+{
+  if((nrolHealth == 0) || (rolHealthIntervalMs == 0))
+    return;
+
+  printf("\n%s: Health monitor (every %d ms) - %d samples",
+	 __func__, rolHealthIntervalMs, rolHealthNsample);
+  if(rolHealthNsample)
+    printf(", %.1f / %.1f us avg/max, %d while the readout was busy",
+	   1e-3 * rolHealthTime_sum / rolHealthNsample, 1e-3 * rolHealthTime_max,
+	   rolHealthNforced);
+  printf("\n");
+}
+
+/*
+  Local Variables:
+  compile-command: "make -k"
+  End:
+*/
@@ -0,0 +1,306 @@
+#pragma once
+/*************************************************************************
+ *
+ *  log_rol_include.c -
+ *
+ *   Messages and diagnostic dumps from the trigger path, handled by a
+ *   worker thread outside of the readout.
+ *
+ *   rolLog(level, fmt, ...) queues a record: the format (a string
+ *   constant, used as is later) and up to ROL_LOG_NARGS integer
+ *   arguments, to be printed with %ld / %lx.  Levels ROL_LOG_INFO,
+ *   ROL_LOG_WARN and ROL_LOG_ERROR also go to daLogMsg.  Nothing is
+ *   formatted and no lock is taken in the caller.  If the queue is full
+ *   the record is dropped, and counted.
+ *
+ *   Slow status dumps (many single cycle VME reads, daLogMsg's) are
+ *   registered once with rolLogDiagRegister() and then requested from
+ *   the trigger path with rolLogDiagRequest(), which only sets a flag.
+ *   A request made while the same dump is pending is merged into it.
+ *
+ *   rolLogFlush() waits until the queue is empty and the requested dumps
+ *   are done (e.g. at End, before the summaries).
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define ROL_LOG_SIZE      1024        /* records, power of 2 */
+#define ROL_LOG_NARGS     4
+#define ROL_LOG_MAX_DIAG  16
+#define ROL_LOG_IDLE_US   1000        /* worker sleep when there is nothing to do */
+
+enum rolLogLevel
+  {
+    ROL_LOG_PRINT = 0,                /* printf only */
+    ROL_LOG_INFO,
+    ROL_LOG_WARN,
+    ROL_LOG_ERROR
+  };
+
+typedef struct
+{
+  volatile uint32_t seq;              /* slot sequence (bounded MPMC queue) */
+  int32_t     level;
+  const char *fmt;
+  uint32_t    evnum;
+  long        arg[ROL_LOG_NARGS];
+} ROL_LOG_RECORD;
+
+typedef struct
+{
+  const char *name;
+  void (*dump)();
+  unsigned int nrequest, ndone;
+} ROL_LOG_DIAG;
+
+static ROL_LOG_RECORD rolLogQueue[ROL_LOG_SIZE];
+static volatile uint32_t rolLogHead = 0, rolLogTail = 0;
+static volatile uint32_t rolLogDropped = 0;
+
+static ROL_LOG_DIAG rolLogDiag[ROL_LOG_MAX_DIAG];
+static int nrolLogDiag = 0;
+static volatile uint32_t rolLogDiagPending = 0;
+static volatile int rolLogBusy = 0;
+
+static pthread_t rolLogThread;
+static volatile int rolLogRunning = 0;
+
+#define rolLog(level, fmt, ...)						\
+  rolLogPush(level, fmt,						\
+	     sizeof((long[]){0, ##__VA_ARGS__}) / sizeof(long) - 1,	\
+	     (long[]){0, ##__VA_ARGS__} + 1)
+
+/* Queue a record.  Safe from any thread, never blocks. */
+static inline int
+rolLogPush(int level, const char *fmt, int nargs, const long *arg)
+{
+  ROL_LOG_RECORD *r;
+  uint32_t pos, seq;
+  int i;
+
+  pos = __atomic_load_n(&rolLogHead, __ATOMIC_RELAXED);
+  while(1)
+    {
+      r = &rolLogQueue[pos & (ROL_LOG_SIZE - 1)];
+      seq = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+
+      if(seq == pos)
+	{
+	  if(__atomic_compare_exchange_n(&rolLogHead, &pos, pos + 1, 1,
+					 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	    break;
+	}
+      else if((int32_t)(seq - pos) < 0)
+	{
+	  __atomic_add_fetch(&rolLogDropped, 1, __ATOMIC_RELAXED);
+	  return ERROR;
+	}
+      else
+	pos = __atomic_load_n(&rolLogHead, __ATOMIC_RELAXED);
+    }
+
+  if(nargs > ROL_LOG_NARGS)
+    nargs = ROL_LOG_NARGS;
+
+  r->level = level;
+  r->fmt = fmt;
+  r->evnum = tiGetIntCount();
+  for(i = 0; i < nargs; i++)
+    r->arg[i] = arg[i];
+  for(; i < ROL_LOG_NARGS; i++)
+    r->arg[i] = 0;
+
+  __atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+
+  return OK;
+}
+
+/* Register a slow status dump.  Returns its id for rolLogDiagRequest(). */
+int
+rolLogDiagRegister(const char *name, void (*dump)())
+{
+  int id;
+
+  for(id = 0; id < nrolLogDiag; id++)
+    if(rolLogDiag[id].dump == dump)
+      return id;
+
+  if(nrolLogDiag >= ROL_LOG_MAX_DIAG)
+    {
+      printf("%s: ERROR: Too many diagnostics (max = %d).  Ignoring %s\n",
+	     __func__, ROL_LOG_MAX_DIAG, name);
+      return -1;
+    }
+
+  id = nrolLogDiag++;
+  rolLogDiag[id].name = name;
+  rolLogDiag[id].dump = dump;
+  rolLogDiag[id].nrequest = rolLogDiag[id].ndone = 0;
+
+  return id;
+}
+
+/* Ask the worker to run a status dump */
+static inline void
+rolLogDiagRequest(int id)
+{
+  if((id < 0) || (id >= nrolLogDiag))
+    return;
+
+  rolLogDiag[id].nrequest++;
+  __atomic_or_fetch(&rolLogDiagPending, 1u << id, __ATOMIC_RELEASE);
+}
+
+static void
+rolLogWrite(ROL_LOG_RECORD *r)
+{
+  static const char *levelName[] = {"", "INFO", "WARN", "ERROR"};
+  char msg[512];
+  int len;
+
+  snprintf(msg, sizeof(msg), r->fmt, r->arg[0], r->arg[1], r->arg[2], r->arg[3]);
+
+  printf("[%6u] %s", r->evnum, msg);
+  if((r->level > ROL_LOG_PRINT) && (r->level <= ROL_LOG_ERROR))
+    {
+      len = strlen(msg);
+      if((len > 0) && (msg[len - 1] == '\n'))
+	msg[len - 1] = 0;
+      daLogMsg((char *)levelName[r->level], "%s", msg);
+    }
+}
+
+/* Write out everything queued, then run the requested dumps.
+   Returns the number of things done. */
+static int
+rolLogDrain()
+{
+  ROL_LOG_RECORD *r;
+  uint32_t pos, pending, dropped;
+  int id, n = 0;
+
+  while(1)
+    {
+      pos = rolLogTail;
+      r = &rolLogQueue[pos & (ROL_LOG_SIZE - 1)];
+      if(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != pos + 1)
+	break;
+
+      rolLogWrite(r);
+
+      __atomic_store_n(&r->seq, pos + ROL_LOG_SIZE, __ATOMIC_RELEASE);
+      rolLogTail = pos + 1;
+      n++;
+    }
+
+  dropped = __atomic_exchange_n(&rolLogDropped, 0, __ATOMIC_RELAXED);
+  if(dropped)
+    {
+      printf("%s: WARN: %u log records dropped (queue full)\n", __func__, dropped);
+      n++;
+    }
+
+  pending = __atomic_exchange_n(&rolLogDiagPending, 0, __ATOMIC_ACQUIRE);
+  for(id = 0; pending && (id < nrolLogDiag); id++)
+    {
+      if((pending & (1u << id)) == 0)
+	continue;
+
+      printf("%s: ---- %s ----\n", __func__, rolLogDiag[id].name);
+      rolLogDiag[id].dump();
+      rolLogDiag[id].ndone++;
+      n++;
+    }
+
+  if(n)
+    fflush(stdout);
+
+  return n;
+}
+
+static void *
+rolLogWorker(void *arg)
+{
+  struct timespec idle = {0, 1000L * ROL_LOG_IDLE_US};
+
+  while(rolLogRunning)
+    {
+      rolLogBusy = 1;
+      if(rolLogDrain() == 0)
+	{
+	  rolLogBusy = 0;
+	  nanosleep(&idle, NULL);
+	}
+    }
+
+  rolLogDrain();
+  rolLogBusy = 0;
+
+  return NULL;
+}
+
+/* Start the worker (once).  Called at Download. */
+void
+rolLogInit()
+{
+  int i;
+
+  if(rolLogRunning)
+    return;
+
+  for(i = 0; i < ROL_LOG_SIZE; i++)
+    rolLogQueue[i].seq = i;
+  rolLogHead = rolLogTail = 0;
+  rolLogDropped = 0;
+  rolLogDiagPending = 0;
+
+  rolLogRunning = 1;
+  if(pthread_create(&rolLogThread, NULL, rolLogWorker, NULL) != 0)
+    {
+      printf("%s: ERROR: Unable to start the log worker.  Messages will be written at End.\n",
+	     __func__);
+      rolLogRunning = 0;
+    }
+}
+
+/* Wait for the queue and the requested dumps to be done */
+void
+rolLogFlush()
+{
+  struct timespec wait = {0, 100000};
+  int itry;
+
+  if(!rolLogRunning)
+    {
+      rolLogDrain();
+      return;
+    }
+
+  for(itry = 0; itry < 100000; itry++)
+    {
+      if((rolLogHead == rolLogTail) && (rolLogDiagPending == 0) && !rolLogBusy)
+	break;
+      nanosleep(&wait, NULL);
+    }
+}
+
+/* Stop the worker.  Called at Cleanup. */
+void
+rolLogStop()
+{
+  if(!rolLogRunning)
+    return;
+
+  rolLogRunning = 0;
+  pthread_join(rolLogThread, NULL);
+}
+
+/*
+  Local Variables:
+  compile-command: "make -k"
+  End:
+*/
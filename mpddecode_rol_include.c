@@ -0,0 +1,372 @@
+#pragma once
+/*************************************************************************
+ *
+ *  mpddecode_rol_include.c -
+ *
+ *   Decoder for the MPD data of the SSP blocks, as read out (words
+ *   byte swapped) by sspMpd_Readout().
+ *
+ *   Block format (after LSWAP):
+ *     header words have bit 31 set, and the tag in bits 27-30
+ *       0  block header              1  block trailer
+ *       2  event header (event number in bits 0-21)
+ *       3  time stamp (bits 0-23), one more word with bits 24-47
+ *       5  MPD frame: fiber in bits 16-20, MPD rotary in bits 0-4
+ *      15  filler
+ *     an MPD frame is followed by 3 words per strip, each with two 13 bit
+ *     signed samples (bits 0-12 and 13-25) and in bits 26-30
+ *       word 0: strip bits 0-4,  word 1: strip bits 5-6,  word 2: APV
+ *
+ *   One event at a time is decoded into an MPD_DECODE: the samples in
+ *   adc[fiber][apv][sample][strip], with the strips present flagged in
+ *   present[fiber][apv] (bit per strip).  Samples of strips not present
+ *   are left from earlier events.
+ *
+ *     MPD_DECODE *d = mpdDecodeCreate();
+ *     int pos = 0;
+ *     while(mpdDecodeNext(d, buf, nwords, &pos))
+ *       ... d->fiberMask, d->apvMask[fiber], d->adc ...
+ *
+ *   mpdDecodeNext() byte swaps, unpacks and sign extends four strips at
+ *   a time with SSE2 (SSSE3 for the swap, if enabled).
+ *   mpdDecodeNextScalar() is the word by word reference, and what
+ *   mpdDecodeNext() is without SSE2.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#define MPD_DECODE_NFIBER   16
+#define MPD_DECODE_NAPV     16
+#define MPD_DECODE_NCH      128
+#define MPD_DECODE_NSAMPLE  6
+
+typedef struct
+{
+  /* event */
+  uint32_t evnum;                    /* event header */
+  uint64_t timestamp;
+  uint32_t fiberMask;                /* fibers with an MPD frame */
+  uint32_t nstrips;
+  uint32_t nerror;                   /* fiber or APV out of range, strip not complete */
+  uint16_t apvMask[MPD_DECODE_NFIBER];   /* APVs with strips */
+  uint64_t present[MPD_DECODE_NFIBER][MPD_DECODE_NAPV][MPD_DECODE_NCH / 64];
+  int16_t  adc[MPD_DECODE_NFIBER][MPD_DECODE_NAPV][MPD_DECODE_NSAMPLE][MPD_DECODE_NCH];
+
+  /* decoder */
+  int started;
+} MPD_DECODE;
+
+MPD_DECODE *
+mpdDecodeCreate()
+{
+  MPD_DECODE *d;
+
+  if(posix_memalign((void **)&d, 64, sizeof(MPD_DECODE)) != 0)
+    return NULL;
+  memset(d, 0, sizeof(MPD_DECODE));
+
+  return d;
+}
+
+void
+mpdDecodeFree(MPD_DECODE *d)
+{
+  free(d);
+}
+
+static inline uint32_t
+mpdDecodeSwap(uint32_t w)
+{
+  return __builtin_bswap32(w);
+}
+
+static inline int
+mpdDecodeStrip(int w)
+{
+  return ((int32_t) w << 19) >> 19;
+}
+
+static void
+mpdDecodeStart(MPD_DECODE *d, uint32_t evnum)
+{
+  int fiber;
+
+  for(fiber = 0; fiber < MPD_DECODE_NFIBER; fiber++)
+    if(d->fiberMask & (1u << fiber))
+      {
+	memset(d->present[fiber], 0, sizeof(d->present[fiber]));
+	d->apvMask[fiber] = 0;
+      }
+
+  d->evnum = evnum;
+  d->timestamp = 0;
+  d->fiberMask = 0;
+  d->nstrips = 0;
+  d->nerror = 0;
+  d->started = 1;
+}
+
+/* One strip: ch / apv from the tag bits, 6 samples */
+static inline void
+mpdDecodePut(MPD_DECODE *d, int fiber, int ch, int apv, const int16_t *s)
+{
+  int16_t (*adc)[MPD_DECODE_NCH];
+
+  if(apv >= MPD_DECODE_NAPV)
+    {
+      d->nerror++;
+      return;
+    }
+
+  adc = d->adc[fiber][apv];
+  adc[0][ch] = s[0];
+  adc[1][ch] = s[1];
+  adc[2][ch] = s[2];
+  adc[3][ch] = s[3];
+  adc[4][ch] = s[4];
+  adc[5][ch] = s[5];
+
+  d->present[fiber][apv][ch >> 6] |= 1ULL << (ch & 63);
+  d->apvMask[fiber] |= 1 << apv;
+  d->nstrips++;
+}
+
+/* Header word (swapped) of the block.  Returns 1 at the end of an event
+   (the word is then left for the next call). */
+static inline int
+mpdDecodeHeader(MPD_DECODE *d, uint32_t val, const uint32_t *buf, int nwords,
+		int *pos, int *fiber)
+{
+  int tag = (val >> 27) & 0xf;
+
+  *fiber = -1;
+
+  switch(tag)
+    {
+    case 2:
+      if(d->started)
+	return 1;
+      mpdDecodeStart(d, val & 0x3FFFFF);
+      break;
+
+    case 1:
+      if(d->started)
+	{
+	  (*pos)++;
+	  return 1;
+	}
+      break;
+
+    case 3:
+      d->timestamp = val & 0xFFFFFF;
+      if((*pos + 1 < nwords) && !(mpdDecodeSwap(buf[*pos + 1]) & 0x80000000))
+	{
+	  (*pos)++;
+	  d->timestamp |= (uint64_t)(mpdDecodeSwap(buf[*pos]) & 0xFFFFFF) << 24;
+	}
+      break;
+
+    case 5:
+      if(!d->started)
+	mpdDecodeStart(d, 0);
+      *fiber = (val >> 16) & 0x1f;
+      if(*fiber >= MPD_DECODE_NFIBER)
+	{
+	  d->nerror++;
+	  *fiber = -1;
+	}
+      else
+	d->fiberMask |= 1u << *fiber;
+      break;
+    }
+
+  (*pos)++;
+  return 0;
+}
+
+/* Reference decoder, one word at a time */
+int
+mpdDecodeNextScalar(MPD_DECODE *d, const uint32_t *buf, int nwords, int *pos)
+{
+  uint32_t val;
+  int fiber = -1, idx = 0, ch = 0;
+  int16_t s[MPD_DECODE_NSAMPLE];
+
+  d->started = 0;
+
+  while(*pos < nwords)
+    {
+      val = mpdDecodeSwap(buf[*pos]);
+
+      if(val & 0x80000000)
+	{
+	  if(idx)
+	    d->nerror++;
+	  idx = 0;
+	  if(mpdDecodeHeader(d, val, buf, nwords, pos, &fiber))
+	    return 1;
+	  continue;
+	}
+
+      (*pos)++;
+      if(fiber < 0)
+	continue;
+
+      s[idx * 2 + 0] = mpdDecodeStrip(val);
+      s[idx * 2 + 1] = mpdDecodeStrip(val >> 13);
+
+      if(idx == 0)
+	ch = (val >> 26) & 0x1f;
+      else if(idx == 1)
+	ch |= ((val >> 26) & 0x3) << 5;
+      else
+	mpdDecodePut(d, fiber, ch, (val >> 26) & 0x1f, s);
+
+      idx = (idx + 1) % 3;
+    }
+
+  if(idx)
+    d->nerror++;
+
+  return d->started;
+}
+
+#if defined(__SSE2__)
+
+static inline __m128i
+mpdDecodeSwap4(__m128i v)
+{
+#if defined(__SSSE3__)
+  return _mm_shuffle_epi8(v, _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11,
+					  4, 5, 6, 7, 0, 1, 2, 3));
+#else
+  v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+  v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+  return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+#endif
+}
+
+/* The two samples of 4 words, sign extended, as 8 int16 in word order */
+static inline __m128i
+mpdDecodeSamples4(__m128i w)
+{
+  __m128i lo = _mm_srai_epi32(_mm_slli_epi32(w, 19), 19);
+  __m128i hi = _mm_srai_epi32(_mm_slli_epi32(w, 6), 19);
+
+  return _mm_or_si128(_mm_and_si128(lo, _mm_set1_epi32(0xFFFF)),
+		      _mm_slli_epi32(hi, 16));
+}
+
+/* Strips of an MPD frame from *pos, 4 at a time, up to the next header
+   word.  Returns with *pos at the first word not used. */
+static inline void
+mpdDecodeFrame4(MPD_DECODE *d, const uint32_t *buf, int nwords, int *pos, int fiber)
+{
+  int16_t s[4 * MPD_DECODE_NSAMPLE] __attribute__((aligned(16)));
+  uint8_t t[16] __attribute__((aligned(16)));
+  const uint32_t *p;
+  __m128i w0, w1, w2;
+  int k;
+
+  while(*pos + 12 <= nwords)
+    {
+      p = &buf[*pos];
+      w0 = mpdDecodeSwap4(_mm_loadu_si128((const __m128i *) &p[0]));
+      w1 = mpdDecodeSwap4(_mm_loadu_si128((const __m128i *) &p[4]));
+      w2 = mpdDecodeSwap4(_mm_loadu_si128((const __m128i *) &p[8]));
+
+      /* a header word in there: finish word by word */
+      if(_mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(_mm_or_si128(w0, w1), w2))))
+	return;
+
+      _mm_store_si128((__m128i *) &s[0], mpdDecodeSamples4(w0));
+      _mm_store_si128((__m128i *) &s[8], mpdDecodeSamples4(w1));
+      _mm_store_si128((__m128i *) &s[16], mpdDecodeSamples4(w2));
+
+      _mm_store_si128((__m128i *) t,
+		      _mm_packus_epi16(_mm_packs_epi32(_mm_srli_epi32(w0, 26),
+						       _mm_srli_epi32(w1, 26)),
+				       _mm_packs_epi32(_mm_srli_epi32(w2, 26),
+						       _mm_setzero_si128())));
+
+      for(k = 0; k < 4; k++)
+	mpdDecodePut(d, fiber, (t[3 * k] & 0x1f) | ((t[3 * k + 1] & 0x3) << 5),
+		     t[3 * k + 2] & 0x1f, &s[k * MPD_DECODE_NSAMPLE]);
+
+      *pos += 12;
+    }
+}
+
+/* Decode the next event of a block, from word *pos.  Returns 1 with the
+   event in d, 0 when there are no more events. */
+int
+mpdDecodeNext(MPD_DECODE *d, const uint32_t *buf, int nwords, int *pos)
+{
+  uint32_t val, w[3];
+  int fiber = -1, idx = 0;
+  int16_t s[MPD_DECODE_NSAMPLE];
+
+  d->started = 0;
+
+  while(*pos < nwords)
+    {
+      val = mpdDecodeSwap(buf[*pos]);
+
+      if(val & 0x80000000)
+	{
+	  if(idx)
+	    d->nerror++;
+	  idx = 0;
+	  if(mpdDecodeHeader(d, val, buf, nwords, pos, &fiber))
+	    return 1;
+	  if(fiber >= 0)
+	    mpdDecodeFrame4(d, buf, nwords, pos, fiber);
+	  continue;
+	}
+
+      /* end of a frame, fewer than 4 strips */
+      (*pos)++;
+      if(fiber < 0)
+	continue;
+
+      w[idx++] = val;
+      if(idx == 3)
+	{
+	  s[0] = mpdDecodeStrip(w[0]);  s[1] = mpdDecodeStrip(w[0] >> 13);
+	  s[2] = mpdDecodeStrip(w[1]);  s[3] = mpdDecodeStrip(w[1] >> 13);
+	  s[4] = mpdDecodeStrip(w[2]);  s[5] = mpdDecodeStrip(w[2] >> 13);
+	  mpdDecodePut(d, fiber, ((w[0] >> 26) & 0x1f) | (((w[1] >> 26) & 0x3) << 5),
+		       (w[2] >> 26) & 0x1f, s);
+	  idx = 0;
+	}
+    }
+
+  if(idx)
+    d->nerror++;
+
+  return d->started;
+}
+
+#else
+
+int
+mpdDecodeNext(MPD_DECODE *d, const uint32_t *buf, int nwords, int *pos)
+{
+  return mpdDecodeNextScalar(d, buf, nwords, pos);
+}
+
+#endif
+
+/*
+  Local Variables:
+  compile-command: "make -k"
+  End:
+*/
@@ -0,0 +1,682 @@
+#pragma once
+/*************************************************************************
+ *
+ *  pack_rol_include.c -
+ *
+ *   Lossless packing of the module banks (FADC250, SSP MPD) before they
+ *   leave the ROC.
+ *
+ *   The header words of the data (bit 31 set) are kept as they are.  The
+ *   other words are split in fields (lanes) of the data format, and each
+ *   field is replaced by its difference to the same field of the word
+ *   `stride' words back (zigzag coded), so that ADC samples become small
+ *   numbers.  Groups of 128 of them are bit packed, per lane, with the
+ *   number of bits that makes the group smallest; the few values that do
+ *   not fit are stored after it (exceptions).
+ *
+ *   Packed bank (32 bit words, host order):
+ *     0  ROL_PACK_MAGIC << 16 | layout << 8 | ROL_PACK_VERSION
+ *     1  words before packing
+ *     2  words after packing (including this header)
+ *     3  header words
+ *        positions of the header words: bytes with the number of data
+ *          words before each one (255: add 255 and go on), 4 per word
+ *        header words, as read
+ *        per group of 128 data words, per lane:
+ *          nexc << 8 | bits,  4 x bits words,  nexc words (index << 16 | value)
+ *
+ *   Bit packing of 128 values v[i] with b bits: value i goes in column
+ *   i % 4, and the values of a column fill the words of that column
+ *   (word 4 * k + column) from bit 0 up.  This is what four 32 bit SSE2
+ *   lanes do side by side, and what rolPackEncode() does.
+ *   rolPackEncodeScalar() writes the same thing word by word.
+ *
+ *   rolPackDecode() gives back the words as read (tools/rolunpack).
+ *
+ *   In the readout list:
+ *     ROL_PACK fa250_Pack;
+ *     rolPackInit(&fa250_Pack, "FADC250", ROL_PACK_FADC);   Download
+ *     rolPackGo(&fa250_Pack, fa250_MaxWords());             Go
+ *     dma_dabufp = rolPackBank(&fa250_Pack, StartOfBank, dma_dabufp, tag);
+ *                                                   before BANKCLOSE
+ *     rolPackStatus(&fa250_Pack);                           End
+ *   A bank that does not get smaller is left as read, with its tag, as is
+ *   one larger than the words the buffers were made for at Go.
+ *
+ *   Included with ROL_PACK_READER defined, only the packing and
+ *   unpacking are compiled (tools/rolunpack.c).
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define ROL_PACK_MAGIC      0x504B    /* "PK" */
+#define ROL_PACK_VERSION    1
+#define ROL_PACK_HEADER     4
+#define ROL_PACK_GROUP      128       /* data words per group */
+#define ROL_PACK_MAX_LANES  3
+
+/* Words needed for the packed bank of n words, and for the scratch */
+#define ROL_PACK_MAX_OUT(n) \
+  (ROL_PACK_HEADER + 2 + (n) + ((n) / 2) + \
+   ((n) / ROL_PACK_GROUP + 1) * ROL_PACK_MAX_LANES * (1 + 4 * 16))
+#define ROL_PACK_SCRATCH(n) (4 + 2 * (n) + 2 * ROL_PACK_GROUP)
+
+enum rolPackLayouts
+  {
+    ROL_PACK_FADC = 0,
+    ROL_PACK_MPD,
+    ROL_PACK_NLAYOUT
+  };
+
+typedef struct
+{
+  const char *name;
+  int stride;                          /* words back, for the differences */
+  int nlanes;
+  int shift[ROL_PACK_MAX_LANES];
+  int width[ROL_PACK_MAX_LANES];       /* all lanes together: 32 bits */
+} ROL_PACK_LAYOUT;
+
+static const ROL_PACK_LAYOUT rolPackLayout[ROL_PACK_NLAYOUT] =
+  {
+    /* FADC250 raw samples: two per word, in bits 0-12 and 16-28 */
+    {"fadc", 1, 2, {0, 16, 0}, {16, 16, 0}},
+    /* MPD: samples in bits 0-12 and 13-25, strip / APV in bits 26-31,
+       3 words per strip */
+    {"mpd",  3, 3, {0, 13, 26}, {13, 13, 6}},
+  };
+
+static inline uint32_t
+rolPackSwap(uint32_t w)
+{
+  return __builtin_bswap32(w);
+}
+
+/* Bits needed for v */
+static inline int
+rolPackBits(uint32_t v)
+{
+  return (v) ? 32 - __builtin_clz(v) : 0;
+}
+
+/* Bits per value for a group (the rest are exceptions) */
+static int
+rolPackChooseBits(const uint32_t *zz, int width, int *nexc)
+{
+  int cnt[33], i, b, best = width, bestcost, over = 0;
+
+  memset(cnt, 0, sizeof(cnt));
+  for(i = 0; i < ROL_PACK_GROUP; i++)
+    cnt[rolPackBits(zz[i])]++;
+
+  bestcost = 4 * width;
+  *nexc = 0;
+  for(b = width - 1; b >= 0; b--)
+    {
+      over += cnt[b + 1];
+      if(4 * b + over <= bestcost)
+	{
+	  bestcost = 4 * b + over;
+	  best = b;
+	  *nexc = over;
+	}
+    }
+
+  return best;
+}
+
+/* Bit pack 128 values with b bits, 4 columns */
+static uint32_t *
+rolPackBitsScalar(const uint32_t *v, int b, uint32_t *out)
+{
+  uint32_t mask = (1u << b) - 1, acc, x;
+  int col, r, shift, w;
+
+  if(b == 0)
+    return out;
+
+  for(col = 0; col < 4; col++)
+    {
+      acc = 0;
+      shift = 0;
+      w = 0;
+      for(r = 0; r < ROL_PACK_GROUP / 4; r++)
+	{
+	  x = v[4 * r + col] & mask;
+	  acc |= x << shift;
+	  shift += b;
+	  if(shift >= 32)
+	    {
+	      out[4 * w + col] = acc;
+	      w++;
+	      shift -= 32;
+	      acc = (shift) ? x >> (b - shift) : 0;
+	    }
+	}
+    }
+
+  return out + 4 * b;
+}
+
+static uint32_t *
+rolPackExceptions(const uint32_t *v, int b, uint32_t *out)
+{
+  int i;
+
+  for(i = 0; i < ROL_PACK_GROUP; i++)
+    if(v[i] >> b)
+      *out++ = (i << 16) | v[i];
+
+  return out;
+}
+
+/* Difference to the word stride back, of one lane, zigzag coded */
+static inline uint32_t
+rolPackZigzag(uint32_t x, uint32_t ref, int shift, int width)
+{
+  uint32_t mask = (width < 32) ? (1u << width) - 1 : ~0u;
+  int32_t d = (int32_t)((((x >> shift) & mask) - ((ref >> shift) & mask)) << (32 - width))
+    >> (32 - width);
+
+  return ((uint32_t) d << 1) ^ (uint32_t)(d >> 31);
+}
+
+/* Header words: positions and values.  Data words (swapped) go to data. */
+static uint32_t *
+rolPackSplitScalar(const uint32_t *raw, int n, uint32_t *out, uint32_t *data,
+		   int *ndata, uint32_t *hdr, int *nhdr)
+{
+  uint8_t *gap = (uint8_t *) out;
+  int i, last = -1, g, nb = 0;
+  uint32_t v;
+
+  *ndata = *nhdr = 0;
+  for(i = 0; i < n; i++)
+    {
+      v = rolPackSwap(raw[i]);
+      if(v & 0x80000000)
+	{
+	  for(g = i - last - 1; g >= 255; g -= 255)
+	    gap[nb++] = 255;
+	  gap[nb++] = g;
+	  last = i;
+	  hdr[(*nhdr)++] = raw[i];
+	}
+      else
+	data[(*ndata)++] = v;
+    }
+
+  while(nb & 3)
+    gap[nb++] = 0;
+
+  return out + nb / 4;
+}
+
+/* Rest of the bank, after the header words */
+static uint32_t *
+rolPackGroupsScalar(int layout, const uint32_t *data, int ndata, uint32_t *zz,
+		    uint32_t *out)
+{
+  const ROL_PACK_LAYOUT *L = &rolPackLayout[layout];
+  int g, lane, i, j, b, nexc;
+
+  for(g = 0; g < ndata; g += ROL_PACK_GROUP)
+    for(lane = 0; lane < L->nlanes; lane++)
+      {
+	for(i = 0; i < ROL_PACK_GROUP; i++)
+	  {
+	    j = g + i;
+	    zz[i] = (j < ndata) ?
+	      rolPackZigzag(data[j], (j >= L->stride) ? data[j - L->stride] : 0,
+			    L->shift[lane], L->width[lane]) : 0;
+	  }
+
+	b = rolPackChooseBits(zz, L->width[lane], &nexc);
+	*out++ = (nexc << 8) | b;
+	out = rolPackBitsScalar(zz, b, out);
+	out = rolPackExceptions(zz, b, out);
+      }
+
+  return out;
+}
+
+static int
+rolPackFinish(int layout, int n, uint32_t *out0, uint32_t *out, int nhdr)
+{
+  out0[0] = (ROL_PACK_MAGIC << 16) | (layout << 8) | ROL_PACK_VERSION;
+  out0[1] = n;
+  out0[2] = out - out0;
+  out0[3] = nhdr;
+
+  return out - out0;
+}
+
+/* Reference packing, word by word.  out: ROL_PACK_MAX_OUT(n) words,
+   scratch: ROL_PACK_SCRATCH(n) words.  Returns the packed words. */
+int
+rolPackEncodeScalar(int layout, const uint32_t *raw, int n, uint32_t *out,
+		    uint32_t *scratch)
+{
+  uint32_t *data = scratch, *hdr = scratch + n, *zz = scratch + 2 * n, *p;
+  int ndata, nhdr;
+
+  p = rolPackSplitScalar(raw, n, out + ROL_PACK_HEADER, data, &ndata, hdr, &nhdr);
+  memcpy(p, hdr, nhdr * sizeof(uint32_t));
+  p = rolPackGroupsScalar(layout, data, ndata, zz, p + nhdr);
+
+  return rolPackFinish(layout, n, out, p, nhdr);
+}
+
+#if defined(__SSE2__)
+
+static inline __m128i
+rolPackSwap4(__m128i v)
+{
+  v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+  v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+  return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+static uint32_t *
+rolPackSplit4(const uint32_t *raw, int n, uint32_t *out, uint32_t *data,
+	      int *ndata, uint32_t *hdr, int *nhdr)
+{
+  uint8_t *gap = (uint8_t *) out;
+  int i = 0, k, last = -1, g, nb = 0;
+  uint32_t v;
+  __m128i w;
+
+  *ndata = *nhdr = 0;
+  while(i < n)
+    {
+      if(i + 4 <= n)
+	{
+	  w = rolPackSwap4(_mm_loadu_si128((const __m128i *) &raw[i]));
+	  if(_mm_movemask_ps(_mm_castsi128_ps(w)) == 0)
+	    {
+	      _mm_storeu_si128((__m128i *) &data[*ndata], w);
+	      *ndata += 4;
+	      i += 4;
+	      continue;
+	    }
+	}
+
+      for(k = 0; (k < 4) && (i < n); k++, i++)
+	{
+	  v = rolPackSwap(raw[i]);
+	  if(v & 0x80000000)
+	    {
+	      for(g = i - last - 1; g >= 255; g -= 255)
+		gap[nb++] = 255;
+	      gap[nb++] = g;
+	      last = i;
+	      hdr[(*nhdr)++] = raw[i];
+	    }
+	  else
+	    data[(*ndata)++] = v;
+	}
+    }
+
+  while(nb & 3)
+    gap[nb++] = 0;
+
+  return out + nb / 4;
+}
+
+static uint32_t *
+rolPackBits4(const uint32_t *v, int b, uint32_t *out)
+{
+  __m128i mask = _mm_set1_epi32((1u << b) - 1), acc = _mm_setzero_si128(), x;
+  int r, shift = 0;
+
+  if(b == 0)
+    return out;
+
+  for(r = 0; r < ROL_PACK_GROUP / 4; r++)
+    {
+      x = _mm_and_si128(_mm_loadu_si128((const __m128i *) &v[4 * r]), mask);
+      acc = _mm_or_si128(acc, _mm_sll_epi32(x, _mm_cvtsi32_si128(shift)));
+      shift += b;
+      if(shift >= 32)
+	{
+	  _mm_storeu_si128((__m128i *) out, acc);
+	  out += 4;
+	  shift -= 32;
+	  acc = (shift) ? _mm_srl_epi32(x, _mm_cvtsi32_si128(b - shift)) :
+	    _mm_setzero_si128();
+	}
+    }
+
+  return out;
+}
+
+static uint32_t *
+rolPackGroups4(int layout, const uint32_t *data, int ndata, uint32_t *zz,
+	       uint32_t *out)
+{
+  const ROL_PACK_LAYOUT *L = &rolPackLayout[layout];
+  int g, lane, i, b, nexc, w, s;
+  __m128i x, ref, mask, d;
+
+  for(g = 0; g < ndata; g += ROL_PACK_GROUP)
+    for(lane = 0; lane < L->nlanes; lane++)
+      {
+	w = L->width[lane];
+	s = L->shift[lane];
+	mask = _mm_set1_epi32((w < 32) ? (1u << w) - 1 : ~0u);
+
+	/* data[-stride .. -1] are 0 */
+	for(i = 0; i < ROL_PACK_GROUP; i += 4)
+	  {
+	    x = _mm_loadu_si128((const __m128i *) &data[g + i]);
+	    ref = _mm_loadu_si128((const __m128i *) &data[g + i - L->stride]);
+	    x = _mm_and_si128(_mm_srl_epi32(x, _mm_cvtsi32_si128(s)), mask);
+	    ref = _mm_and_si128(_mm_srl_epi32(ref, _mm_cvtsi32_si128(s)), mask);
+	    d = _mm_sll_epi32(_mm_sub_epi32(x, ref), _mm_cvtsi32_si128(32 - w));
+	    d = _mm_sra_epi32(d, _mm_cvtsi32_si128(32 - w));
+	    _mm_storeu_si128((__m128i *) &zz[i],
+			     _mm_xor_si128(_mm_slli_epi32(d, 1), _mm_srai_epi32(d, 31)));
+	  }
+	for(i = ndata - g; i < ROL_PACK_GROUP; i++)
+	  zz[i] = 0;
+
+	b = rolPackChooseBits(zz, w, &nexc);
+	*out++ = (nexc << 8) | b;
+	out = rolPackBits4(zz, b, out);
+	out = rolPackExceptions(zz, b, out);
+      }
+
+  return out;
+}
+
+/* Packing, 4 words at a time.  Same output as rolPackEncodeScalar(). */
+int
+rolPackEncode(int layout, const uint32_t *raw, int n, uint32_t *out, uint32_t *scratch)
+{
+  uint32_t *data = scratch + 4, *hdr = scratch + 4 + n + ROL_PACK_GROUP, *p;
+  int ndata, nhdr;
+
+  memset(scratch, 0, 4 * sizeof(uint32_t));
+  p = rolPackSplit4(raw, n, out + ROL_PACK_HEADER, data, &ndata, hdr, &nhdr);
+  /* the group loads go up to a group past the data */
+  memset(&data[ndata], 0, ROL_PACK_GROUP * sizeof(uint32_t));
+  memcpy(p, hdr, nhdr * sizeof(uint32_t));
+  p = rolPackGroups4(layout, data, ndata, hdr + nhdr, p + nhdr);
+
+  return rolPackFinish(layout, n, out, p, nhdr);
+}
+
+#else
+
+int
+rolPackEncode(int layout, const uint32_t *raw, int n, uint32_t *out, uint32_t *scratch)
+{
+  return rolPackEncodeScalar(layout, raw, n, out, scratch);
+}
+
+#endif
+
+/* Position of the next header word, from the gap bytes */
+static inline int
+rolPackNextHeader(const uint8_t *gap, int *ig, int pos)
+{
+  while(gap[*ig] == 255)
+    {
+      pos += 255;
+      (*ig)++;
+    }
+
+  return pos + gap[(*ig)++] + 1;
+}
+
+/* Unpack a bank.  Returns the words as read (up to maxout), or -1 if
+   it is not a packed bank or is damaged. */
+int
+rolPackDecode(const uint32_t *in, int nin, uint32_t *out, int maxout)
+{
+  const ROL_PACK_LAYOUT *L;
+  const uint8_t *gap;
+  const uint32_t *hdr, *p, *end;
+  uint32_t *data, v[ROL_PACK_GROUP], mask, bmask, ref;
+  int layout, n, nhdr, ndata, ih, ig, i, j, g, lane, b, nexc, bit, pos;
+  int32_t d;
+
+  if((nin < ROL_PACK_HEADER) || ((in[0] >> 16) != ROL_PACK_MAGIC) ||
+     ((in[0] & 0xFF) != ROL_PACK_VERSION))
+    return -1;
+
+  layout = (in[0] >> 8) & 0xFF;
+  n = in[1];
+  nhdr = in[3];
+  if((layout >= ROL_PACK_NLAYOUT) || (in[2] > nin) || (n > maxout) || (nhdr > n))
+    return -1;
+  L = &rolPackLayout[layout];
+  end = in + in[2];
+  ndata = n - nhdr;
+
+  /* size of the header word positions */
+  gap = (const uint8_t *) &in[ROL_PACK_HEADER];
+  for(ih = 0, ig = 0, pos = -1; ih < nhdr; ih++)
+    {
+      if((const uint32_t *) &gap[ig + 1] > end)
+	return -1;
+      pos = rolPackNextHeader(gap, &ig, pos);
+    }
+  if(pos >= n)
+    return -1;
+  hdr = &in[ROL_PACK_HEADER] + (ig + 3) / 4;
+  p = hdr + nhdr;
+
+  data = (uint32_t *) calloc(ndata + 1, sizeof(uint32_t));
+  if(data == NULL)
+    return -1;
+
+  for(g = 0; g < ndata; g += ROL_PACK_GROUP)
+    for(lane = 0; lane < L->nlanes; lane++)
+      {
+	if(p >= end)
+	  goto damaged;
+	b = *p & 0xFF;
+	nexc = *p >> 8;
+	p++;
+	if((b > L->width[lane]) || (nexc > ROL_PACK_GROUP) || (p + 4 * b + nexc > end))
+	  goto damaged;
+
+	bmask = (1u << b) - 1;
+	for(i = 0; i < ROL_PACK_GROUP; i++)
+	  {
+	    if(b == 0)
+	      {
+		v[i] = 0;
+		continue;
+	      }
+	    bit = (i / 4) * b;
+	    v[i] = p[4 * (bit >> 5) + (i % 4)] >> (bit & 31);
+	    if((bit & 31) + b > 32)
+	      v[i] |= p[4 * ((bit >> 5) + 1) + (i % 4)] << (32 - (bit & 31));
+	    v[i] &= bmask;
+	  }
+	p += 4 * b;
+	for(i = 0; i < nexc; i++, p++)
+	  v[(*p >> 16) & (ROL_PACK_GROUP - 1)] = *p & 0xFFFF;
+
+	mask = (1u << L->width[lane]) - 1;
+	for(i = 0; (i < ROL_PACK_GROUP) && (g + i < ndata); i++)
+	  {
+	    j = g + i;
+	    d = (int32_t)(v[i] >> 1) ^ -(int32_t)(v[i] & 1);
+	    ref = (j >= L->stride) ? (data[j - L->stride] >> L->shift[lane]) & mask : 0;
+	    data[j] |= ((ref + d) & mask) << L->shift[lane];
+	  }
+      }
+
+  /* header words back at their positions */
+  pos = (nhdr) ? rolPackNextHeader(gap, (ig = 0, &ig), -1) : n;
+  for(i = 0, j = 0, ih = 0; i < n; i++)
+    {
+      if(i == pos)
+	{
+	  out[i] = hdr[ih++];
+	  pos = (ih < nhdr) ? rolPackNextHeader(gap, &ig, pos) : n;
+	}
+      else
+	out[i] = rolPackSwap(data[j++]);
+    }
+
+  free(data);
+  return n;
+
+ damaged:
+  free(data);
+  return -1;
+}
+
+#ifndef ROL_PACK_READER
+
+#include "poll_rol_include.c"
+
+#ifndef ROL_PACK_ENABLE
+#define ROL_PACK_ENABLE 0
+#endif
+int rolPackEnable = ROL_PACK_ENABLE;
+
+typedef struct
+{
+  const char *name;
+  int layout;
+  uint32_t *out, *scratch;
+  int size;                            /* bank words the buffers are for */
+
+  /* per-run statistics */
+  unsigned int nbank, npacked, nlarge;
+  unsigned long long words_in, words_out;
+  unsigned long long time_ns;
+} ROL_PACK;
+
+void
+rolPackSetEnable(int enable)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, enable);
+    }
+  else
+    {
+      rolPackEnable = (enable) ? 1 : 0;
+
+      daLogMsg("INFO","Setting bank packing (%d)", rolPackEnable);
+    }
+}
+
+void
+rolPackInit(ROL_PACK *p, const char *name, int layout)
+{
+  if(p->out)
+    free(p->out);
+  if(p->scratch)
+    free(p->scratch);
+
+  memset(p, 0, sizeof(ROL_PACK));
+  p->name = name;
+  p->layout = layout;
+}
+
+/* Clear the statistics, and make the buffers for banks up to maxWords
+   words (the module's largest bank for this run).  Called at Go. */
+void
+rolPackGo(ROL_PACK *p, int maxWords)
+{
+  p->nbank = p->npacked = p->nlarge = 0;
+  p->words_in = p->words_out = 0;
+  p->time_ns = 0;
+
+  if(maxWords == p->size)
+    return;
+
+  free(p->out);
+  free(p->scratch);
+  p->size = maxWords;
+  p->out = (uint32_t *) malloc(ROL_PACK_MAX_OUT(p->size) * sizeof(uint32_t));
+  p->scratch = (uint32_t *) malloc(ROL_PACK_SCRATCH(p->size) * sizeof(uint32_t));
+  if((p->out == NULL) || (p->scratch == NULL))
+    {
+      printf("%s: ERROR allocating %s packing buffers (%d words).  Not packing.\n",
+	     __func__, p->name, maxWords);
+      free(p->out);
+      free(p->scratch);
+      p->out = p->scratch = NULL;
+      p->size = 0;
+    }
+}
+
+/* Pack the bank that starts at bank (BANKOPEN's StartOfBank) and ends at
+   end (dma_dabufp), if that makes it smaller.  The packed bank gets the
+   tag `tag'.  Returns the new end of the bank. */
+unsigned int *
+rolPackBank(ROL_PACK *p, unsigned int *bank, unsigned int *end, int tag)
+{
+  unsigned int *data = bank + 2;
+  int n = end - data, npack;
+  unsigned long long t0;
+
+  if(!rolPackEnable || (n <= 0))
+    return end;
+
+  /* Buffers made at Go (rolPackGo) */
+  if(n > p->size)
+    {
+      p->nlarge++;
+      return end;
+    }
+
+  t0 = rolPollNow();
+
+  npack = rolPackEncode(p->layout, (const uint32_t *) data, n, p->out, p->scratch);
+
+  p->nbank++;
+  p->words_in += n;
+  if(npack < n)
+    {
+      memcpy(data, p->out, npack * sizeof(uint32_t));
+      bank[1] = (tag << 16) | (bank[1] & 0xFFFF);
+      end = data + npack;
+      p->npacked++;
+      p->words_out += npack;
+    }
+  else
+    p->words_out += n;
+
+  p->time_ns += rolPollNow() - t0;
+
+  return end;
+}
+
+void
+rolPackStatus(ROL_PACK *p)
+{
+  if(p->nbank == 0)
+    return;
+
+  printf("  %-10s packing: %u banks (%u packed), %llu -> %llu words (x %.2f), %.1f MB/s\n",
+	 p->name, p->nbank, p->npacked, p->words_in, p->words_out,
+	 (p->words_out) ? (double) p->words_in / p->words_out : 0.,
+	 (p->time_ns) ? 4e3 * p->words_in / p->time_ns : 0.);
+  if(p->nlarge)
+    printf("  %-10s packing: %u banks too large for the buffers, left as read\n",
+	   p->name, p->nlarge);
+}
+
+#endif /* ROL_PACK_READER */
+
+/*
+  Local Variables:
+  compile-command: "make -k"
+  End:
+*/
@@ -0,0 +1,434 @@
+#pragma once
+/*************************************************************************
+ *
+ *  pedcache_rol_include.c -
+ *
+ *   Binary cache of the APV pedestal file (gem_ped_*.dat) and the
+ *   common-mode range file (CommonModeRange_*.txt) used by the SSP MPD
+ *   event builder.
+ *
+ *   The cache is a fixed layout file (PED_CACHE): a versioned header with
+ *   a checksum of the tables, the mtime/size/hash of the two text files it
+ *   was made from, then the tables.  It is used with mmap, no parsing.
+ *
+ *   pedCacheOpen() maps the cache, and rebuilds it from the text files
+ *   when it is missing, damaged, for another SSP slot, or out of date.
+ *   Out of date: the mtime or size of a text file differs and its hash
+ *   differs too (a touched but unchanged file only has its stamp updated).
+ *
+ *   tools/pedcache builds and prints a cache from the command line.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#define PED_CACHE_MAGIC    0x50454443  /* "PEDC" */
+#define PED_CACHE_VERSION  1
+#define PED_CACHE_NFIBER   16
+#define PED_CACHE_NAPV     16
+#define PED_CACHE_NCH      128
+
+/* Stamp of a text source file */
+typedef struct
+{
+  int32_t  exists;
+  uint32_t hash;         /* FNV-1a of the contents */
+  int64_t  size;
+  int64_t  mtime_ns;
+} PED_CACHE_SOURCE;
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;         /* of the whole file */
+  uint32_t checksum;     /* FNV-1a of everything after the header */
+  int32_t  ssp_slot;     /* pedestals are for this SSP */
+  int32_t  napv_ped;     /* APVs found in the pedestal file */
+  int32_t  ncm;          /* entries in the common-mode file */
+  int32_t  reserved;
+  PED_CACHE_SOURCE ped;
+  PED_CACHE_SOURCE cm;
+} PED_CACHE_HEADER;
+
+typedef struct
+{
+  PED_CACHE_HEADER hdr;
+
+  /* from the pedestal file: strip offset and rms (ADC), as int */
+  int32_t offset[PED_CACHE_NFIBER][PED_CACHE_NAPV][PED_CACHE_NCH];
+  int32_t rms[PED_CACHE_NFIBER][PED_CACHE_NAPV][PED_CACHE_NCH];
+
+  /* from the common-mode file */
+  int32_t cm_set[PED_CACHE_NFIBER][PED_CACHE_NAPV];
+  int32_t cm_min[PED_CACHE_NFIBER][PED_CACHE_NAPV];
+  int32_t cm_max[PED_CACHE_NFIBER][PED_CACHE_NAPV];
+} PED_CACHE;
+
+static inline uint32_t
+pedCacheHash(uint32_t h, const void *data, size_t n)
+{
+  const unsigned char *p = (const unsigned char *) data;
+
+  while(n--)
+    {
+      h ^= *p++;
+      h *= 16777619u;
+    }
+
+  return h;
+}
+
+#define PED_CACHE_HASH_INIT 2166136261u
+
+static uint32_t
+pedCacheChecksum(const PED_CACHE *c)
+{
+  return pedCacheHash(PED_CACHE_HASH_INIT, (const char *)c + sizeof(PED_CACHE_HEADER),
+		      sizeof(PED_CACHE) - sizeof(PED_CACHE_HEADER));
+}
+
+/* mtime and size of a text file.  Returns 0 if it does not exist. */
+static int
+pedCacheStat(const char *name, PED_CACHE_SOURCE *src)
+{
+  struct stat st;
+
+  memset(src, 0, sizeof(PED_CACHE_SOURCE));
+  if((name == NULL) || (stat(name, &st) != 0))
+    return 0;
+
+  src->exists = 1;
+  src->size = st.st_size;
+  src->mtime_ns = (int64_t) st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+
+  return 1;
+}
+
+/* Stamp and hash of a text file */
+static int
+pedCacheStamp(const char *name, PED_CACHE_SOURCE *src)
+{
+  char buf[65536];
+  size_t n;
+  FILE *f;
+
+  if(!pedCacheStat(name, src))
+    return 0;
+
+  f = fopen(name, "r");
+  if(f == NULL)
+    {
+      src->exists = 0;
+      return 0;
+    }
+
+  src->hash = PED_CACHE_HASH_INIT;
+  while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    src->hash = pedCacheHash(src->hash, buf, n);
+  fclose(f);
+
+  return 1;
+}
+
+/* Read the pedestal file:
+     APV <ssp slot> <fiber> <apv>
+     <strip> <offset> <rms>
+     ...
+   Only the APVs of sspSlot are kept. */
+static int
+pedCacheParsePedestal(PED_CACHE *c, const char *name, int sspSlot)
+{
+  int sspSlotID = -1, fiberID = -1, apvId = -1, stripNo;
+  float ped_offset, ped_rms;
+  char buf[10];
+  int i1, i2, i3, n;
+  char *line_ptr = NULL;
+  size_t line_len = 0;
+  FILE *f;
+
+  f = fopen(name, "r");
+  if(f == NULL)
+    return -1;
+
+  while(getline(&line_ptr, &line_len, f) != -1)
+    {
+      n = sscanf(line_ptr, "%10s %d %d %d", buf, &i1, &i2, &i3);
+      if( (n == 4) && !strcmp("APV", buf))
+	{
+	  sspSlotID = i1;
+	  fiberID = i2;
+	  apvId = i3;
+	  if((sspSlotID == sspSlot) &&
+	     (fiberID >= 0) && (fiberID < PED_CACHE_NFIBER) &&
+	     (apvId >= 0) && (apvId < PED_CACHE_NAPV))
+	    c->hdr.napv_ped++;
+	  continue;
+	}
+
+      n = sscanf(line_ptr, "%d %f %f", &stripNo, &ped_offset, &ped_rms);
+      if( (n == 3) && (sspSlotID == sspSlot) &&
+	  (fiberID >= 0) && (fiberID < PED_CACHE_NFIBER) &&
+	  (apvId >= 0) && (apvId < PED_CACHE_NAPV) &&
+	  (stripNo >= 0) && (stripNo < PED_CACHE_NCH) )
+	{
+	  c->offset[fiberID][apvId][stripNo] = (int)ped_offset;
+	  c->rms[fiberID][apvId][stripNo] = (int)ped_rms;
+	}
+    }
+
+  if(line_ptr)
+    free(line_ptr);
+  fclose(f);
+
+  return 0;
+}
+
+/* Read the common-mode file: <fiber> <apv> <min> <max> per line */
+static int
+pedCacheParseCommonMode(PED_CACHE *c, const char *name)
+{
+  int fiberID, apvId, cModeMin, cModeMax;
+  char *line_ptr = NULL;
+  size_t line_len = 0;
+  FILE *f;
+
+  f = fopen(name, "r");
+  if(f == NULL)
+    return -1;
+
+  while(getline(&line_ptr, &line_len, f) != -1)
+    {
+      if(sscanf(line_ptr, "%d %d %d %d", &fiberID, &apvId, &cModeMin, &cModeMax) != 4)
+	continue;
+
+      if((fiberID < 0) || (fiberID >= PED_CACHE_NFIBER) ||
+	 (apvId < 0) || (apvId >= PED_CACHE_NAPV))
+	continue;
+
+      c->cm_set[fiberID][apvId] = 1;
+      c->cm_min[fiberID][apvId] = cModeMin;
+      c->cm_max[fiberID][apvId] = cModeMax;
+      c->hdr.ncm++;
+    }
+
+  if(line_ptr)
+    free(line_ptr);
+  fclose(f);
+
+  return 0;
+}
+
+/* Write a cache (to a temporary file, then renamed) */
+static int
+pedCacheWrite(const PED_CACHE *c, const char *cacheName)
+{
+  char tmp[1024];
+  FILE *f;
+  int rval = 0;
+
+  snprintf(tmp, sizeof(tmp), "%s.%d", cacheName, (int) getpid());
+  f = fopen(tmp, "w");
+  if(f == NULL)
+    return -1;
+
+  if(fwrite(c, sizeof(PED_CACHE), 1, f) != 1)
+    rval = -1;
+  if(fclose(f) != 0)
+    rval = -1;
+
+  if((rval == 0) && (rename(tmp, cacheName) != 0))
+    rval = -1;
+  if(rval != 0)
+    unlink(tmp);
+
+  return rval;
+}
+
+/* Build a cache from the text files.  Returns a malloc'ed PED_CACHE. */
+PED_CACHE *
+pedCacheBuild(const char *pedName, const char *cmName, int sspSlot)
+{
+  PED_CACHE *c;
+
+  c = (PED_CACHE *) calloc(1, sizeof(PED_CACHE));
+  if(c == NULL)
+    return NULL;
+
+  c->hdr.magic = PED_CACHE_MAGIC;
+  c->hdr.version = PED_CACHE_VERSION;
+  c->hdr.size = sizeof(PED_CACHE);
+  c->hdr.ssp_slot = sspSlot;
+
+  if(pedCacheStamp(pedName, &c->hdr.ped))
+    if(pedCacheParsePedestal(c, pedName, sspSlot) != 0)
+      c->hdr.ped.exists = 0;
+
+  if(pedCacheStamp(cmName, &c->hdr.cm))
+    if(pedCacheParseCommonMode(c, cmName) != 0)
+      c->hdr.cm.exists = 0;
+
+  c->hdr.checksum = pedCacheChecksum(c);
+
+  return c;
+}
+
+/* Is a mapped cache usable?  Returns 0 if yes, else the reason. */
+static const char *
+pedCacheCheck(const PED_CACHE *c, size_t size, int sspSlot)
+{
+  if(size != sizeof(PED_CACHE))
+    return "wrong size";
+  if((c->hdr.magic != PED_CACHE_MAGIC) || (c->hdr.version != PED_CACHE_VERSION))
+    return "wrong version";
+  if(c->hdr.size != sizeof(PED_CACHE))
+    return "wrong size";
+  if(c->hdr.ssp_slot != sspSlot)
+    return "other SSP slot";
+  if(c->hdr.checksum != pedCacheChecksum(c))
+    return "bad checksum";
+
+  return NULL;
+}
+
+/* Does a source stamp still describe the text file?  The file is hashed
+   only if its mtime or size changed.  Sets *touched if only the stamp
+   changed. */
+static int
+pedCacheSourceValid(const PED_CACHE_SOURCE *cached, const char *name, int *touched)
+{
+  PED_CACHE_SOURCE now;
+
+  pedCacheStat(name, &now);
+  if(now.exists != cached->exists)
+    return 0;
+  if(!now.exists)
+    return 1;
+  if((now.size == cached->size) && (now.mtime_ns == cached->mtime_ns))
+    return 1;
+
+  pedCacheStamp(name, &now);
+  if(now.hash != cached->hash)
+    return 0;
+
+  *touched = 1;
+  return 1;
+}
+
+static PED_CACHE *
+pedCacheMap(const char *cacheName, size_t *size)
+{
+  struct stat st;
+  void *p;
+  int fd;
+
+  fd = open(cacheName, O_RDONLY);
+  if(fd < 0)
+    return NULL;
+
+  if((fstat(fd, &st) != 0) || (st.st_size < (off_t) sizeof(PED_CACHE_HEADER)))
+    {
+      close(fd);
+      return NULL;
+    }
+
+  p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(p == MAP_FAILED)
+    return NULL;
+
+  *size = st.st_size;
+  return (PED_CACHE *) p;
+}
+
+static PED_CACHE *pedCacheMapped = NULL;
+static size_t pedCacheMappedSize = 0;
+static PED_CACHE *pedCacheBuilt = NULL;
+
+/* Release what the last pedCacheOpen() returned */
+void
+pedCacheClose()
+{
+  if(pedCacheMapped)
+    munmap(pedCacheMapped, pedCacheMappedSize);
+  pedCacheMapped = NULL;
+  pedCacheMappedSize = 0;
+
+  if(pedCacheBuilt)
+    free(pedCacheBuilt);
+  pedCacheBuilt = NULL;
+}
+
+/* The tables for the pedestal / common-mode files, from the cache file,
+   rebuilt first if needed.  Valid until the next pedCacheOpen() or
+   pedCacheClose().  NULL only if out of memory. */
+const PED_CACHE *
+pedCacheOpen(const char *pedName, const char *cmName, const char *cacheName, int sspSlot)
+{
+  const char *why = "missing";
+  size_t size = 0;
+  PED_CACHE *c;
+  int touched = 0;
+
+  pedCacheClose();
+
+  c = pedCacheMap(cacheName, &size);
+  if(c)
+    {
+      why = pedCacheCheck(c, size, sspSlot);
+      if((why == NULL) &&
+	 !(pedCacheSourceValid(&c->hdr.ped, pedName, &touched) &&
+	   pedCacheSourceValid(&c->hdr.cm, cmName, &touched)))
+	why = "out of date";
+
+      if(why == NULL)
+	{
+	  pedCacheMapped = c;
+	  pedCacheMappedSize = size;
+
+	  if(!touched)
+	    return c;
+
+	  /* Same contents, new stamps: write the stamps, keep the tables */
+	  pedCacheBuilt = (PED_CACHE *) malloc(sizeof(PED_CACHE));
+	  if(pedCacheBuilt == NULL)
+	    return c;
+	  memcpy(pedCacheBuilt, c, sizeof(PED_CACHE));
+	  pedCacheStamp(pedName, &pedCacheBuilt->hdr.ped);
+	  pedCacheStamp(cmName, &pedCacheBuilt->hdr.cm);
+	  pedCacheWrite(pedCacheBuilt, cacheName);
+	  return pedCacheBuilt;
+	}
+
+      munmap(c, size);
+    }
+
+  pedCacheBuilt = pedCacheBuild(pedName, cmName, sspSlot);
+  if(pedCacheBuilt == NULL)
+    return NULL;
+
+  /* Nothing to cache */
+  if(!pedCacheBuilt->hdr.ped.exists && !pedCacheBuilt->hdr.cm.exists)
+    return pedCacheBuilt;
+
+  printf("%s: %s %s.  Rebuilt from %s, %s\n", __func__,
+	 cacheName, why, pedName, cmName);
+
+  if(pedCacheWrite(pedCacheBuilt, cacheName) != 0)
+    printf("%s: WARN: Unable to write %s.  Text files will be read again next time.\n",
+	   __func__, cacheName);
+
+  return pedCacheBuilt;
+}
+
+/*
+  Local Variables:
+  compile-command: "make -k"
+  End:
+*/
@@ -0,0 +1,228 @@
+#pragma once
+/*************************************************************************
+ *
+ *  poll_rol_include.c -
+ *
+ *   Readiness waits for the modules in the readout list.
+ *
+ *   A wait gives up after a time (timeout_us), not after a number of
+ *   checks, so its meaning does not change with CPU speed or VME load.
+ *   The readiness check is repeated back to back for the first
+ *   rolPollSpinUs, then with a pause in between that starts at
+ *   rolPollPauseUs and doubles up to rolPollPauseMaxUs.  The pauses
+ *   leave the bus to the DMA of the other modules.
+ *
+ *   Each module keeps a histogram of its wait times (log2 us bins),
+ *   printed with rolPollStatus().
+ *
+ *   Set the backoff with rolPollSetBackoff(spin_us, pause_us, pause_max_us);
+ */
+
+#include <time.h>
+#include <sched.h>
+
+#define ROL_POLL_NBINS 24     /* < 1us, < 2us, < 4us ... < 2^22 us, more */
+
+typedef struct
+{
+  const char  *name;
+  unsigned int timeout_us;
+
+  /* current wait */
+  unsigned long long t0;
+  unsigned int pause_us;
+  unsigned int nchecks;
+  unsigned long long wait_last;            /* ns */
+
+  /* per-run statistics */
+  unsigned int nwait;
+  unsigned int ntimeout;
+  unsigned long long checks;
+  unsigned long long wait_sum, wait_max;   /* ns */
+  unsigned int hist[ROL_POLL_NBINS];
+} ROL_POLL;
+
+unsigned int rolPollSpinUs     = 20;
+unsigned int rolPollPauseUs    = 2;
+unsigned int rolPollPauseMaxUs = 50;
+
+static inline unsigned long long
+rolPollNow()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void
+rolPollSetBackoff(unsigned int spin_us, unsigned int pause_us, unsigned int pause_max_us)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change.\n",
+	     __func__);
+      return;
+    }
+
+  rolPollSpinUs     = spin_us;
+  rolPollPauseUs    = pause_us;
+  rolPollPauseMaxUs = (pause_max_us > pause_us) ? pause_max_us : pause_us;
+
+  daLogMsg("INFO","Setting readiness backoff (spin %d us, pause %d..%d us)",
+	   rolPollSpinUs, rolPollPauseUs, rolPollPauseMaxUs);
+}
+
+void
+rolPollInit(ROL_POLL *p, const char *name, unsigned int timeout_us)
+{
+  memset(p, 0, sizeof(ROL_POLL));
+  p->name = name;
+  p->timeout_us = (timeout_us > 0) ? timeout_us : 1;
+}
+
+/* Clear the statistics.  Called at Go. */
+void
+rolPollClear(ROL_POLL *p)
+{
+  p->nwait = p->ntimeout = 0;
+  p->checks = 0;
+  p->wait_sum = p->wait_max = 0;
+  memset(p->hist, 0, sizeof(p->hist));
+}
+
+/* Start a wait that began at t0 (e.g. at the trigger) */
+static inline void
+rolPollStart(ROL_POLL *p, unsigned long long t0)
+{
+  p->t0 = t0;
+  p->pause_us = rolPollPauseUs;
+  p->nchecks = 0;
+}
+
+static inline int
+rolPollExpired(ROL_POLL *p, unsigned long long now)
+{
+  return ((now - p->t0) >= 1000ULL * p->timeout_us);
+}
+
+/* Between two checks: nothing while spinning, then pause with backoff */
+static inline void
+rolPollBackoff(ROL_POLL *p, unsigned long long now)
+{
+  struct timespec ts;
+
+  if((now - p->t0) < 1000ULL * rolPollSpinUs)
+    return;
+
+  if(p->pause_us == 0)
+    {
+      sched_yield();
+      return;
+    }
+
+  ts.tv_sec = 0;
+  ts.tv_nsec = 1000L * p->pause_us;
+  nanosleep(&ts, NULL);
+
+  p->pause_us <<= 1;
+  if(p->pause_us > rolPollPauseMaxUs)
+    p->pause_us = rolPollPauseMaxUs;
+}
+
+/* End of a wait: ready, or gave up */
+static inline void
+rolPollDone(ROL_POLL *p, int ready, unsigned long long now)
+{
+  unsigned long long dt = now - p->t0;
+  unsigned int us = dt / 1000, bin = 0;
+
+  while(us && (bin < ROL_POLL_NBINS - 1))
+    {
+      us >>= 1;
+      bin++;
+    }
+
+  p->wait_last = dt;
+  p->hist[bin]++;
+  p->nwait++;
+  if(!ready)
+    p->ntimeout++;
+  p->checks += p->nchecks;
+  p->wait_sum += dt;
+  if(dt > p->wait_max)
+    p->wait_max = dt;
+}
+
+/* One readiness check, counted */
+static inline int
+rolPollCheck(ROL_POLL *p, int (*ready)())
+{
+  p->nchecks++;
+  return ready();
+}
+
+/* Wait for ready() until the timeout.  Returns 1 if ready, 0 if not. */
+int
+rolPollWait(ROL_POLL *p, int (*ready)())
+{
+  unsigned long long now;
+  int rval;
+
+  rolPollStart(p, rolPollNow());
+
+  while(1)
+    {
+      rval = rolPollCheck(p, ready);
+      now = rolPollNow();
+
+      if(rval || rolPollExpired(p, now))
+	break;
+
+      rolPollBackoff(p, now);
+    }
+
+  rolPollDone(p, rval, now);
+
+  return (rval) ? 1 : 0;
+}
+
+void
+rolPollStatus(ROL_POLL *p)
+{
+  int ibin, lo = -1, hi = 0;
+
+  for(ibin = 0; ibin < ROL_POLL_NBINS; ibin++)
+    if(p->hist[ibin])
+      {
+	if(lo < 0)
+	  lo = ibin;
+	hi = ibin;
+      }
+
+  printf("  %-10s %8u waits, %u timeouts (%d us), %.1f checks/wait, avg %.1f us, max %.1f us\n",
+	 p->name, p->nwait, p->ntimeout, p->timeout_us,
+	 (p->nwait) ? (double) p->checks / p->nwait : 0.,
+	 (p->nwait) ? 1e-3 * p->wait_sum / p->nwait : 0., 1e-3 * p->wait_max);
+
+  if(lo < 0)
+    return;
+
+  printf("    < us ");
+  for(ibin = lo; ibin <= hi; ibin++)
+    {
+      if(ibin == ROL_POLL_NBINS - 1)
+	printf("    more");
+      else
+	printf(" %7u", 1u << ibin);
+    }
+  printf("\n         ");
+  for(ibin = lo; ibin <= hi; ibin++)
+    printf(" %7u", p->hist[ibin]);
+  printf("\n");
+}
+
+/*
+  Local Variables:
+  compile-command: "make -k"
+  End:
+*/
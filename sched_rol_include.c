@@ -0,0 +1,714 @@
+#pragma once
+/*************************************************************************
+ *
+ *  sched_rol_include.c -
+ *
+ *   Readout scheduler for the modules compiled into the readout list.
+ *
+ *   Modules are registered (in bank order) at Download with their
+ *   readiness wait (poll_rol_include.c), a non-blocking readiness check
+ *   and a readout routine that fills its bank at dma_dabufp.  In the
+ *   overlapped mode all modules are polled together and the first one
+ *   found ready is read out.  A module that is ready before those ahead
+ *   of it in bank order is read into a staging buffer and copied into
+ *   the event once its turn comes, so the banks always land in the order
+ *   of registration.
+ *
+ *   rolSchedMode:
+ *     0 : sequential - wait for, and readout, each module in turn
+ *     1 : overlapped - poll all modules, readout whichever is ready
+ *
+ *   Set with rolSchedSetMode(int mode);
+ *
+ *   rolSchedTable: modules read out for each TI event type, parsed at
+ *   Download.  Entries separated by spaces or ';'
+ *     <type>[-<type>]=<module>[+<module>...]   or   <type>[-<type>]=none
+ *   with the module names of the registration (FADC250, SSP-MPD, ...).
+ *   Event types not listed read out all modules, as do sync events.
+ *   e.g. "3=FADC250 4-5=FADC250+SSP-MAROC"
+ *
+ *   The block of a module not read out for a trigger is still in the
+ *   module.  It is dropped (read to a scratch buffer, with the module's
+ *   discard routine) once ready, at the latest before the next block
+ *   of that module is read out.
+ *
+ *   Set with rolSchedSetTable(char *table);
+ *
+ *   Each module reads into the space left in the event (or staging)
+ *   buffer.  A block that does not fit is truncated and marked, and its
+ *   rest dropped from the module (evbuf_rol_include.c).
+ */
+
+#include <string.h>
+#include <strings.h>
+#include "poll_rol_include.c"
+#include "stats_rol_include.c"
+#include "evbuf_rol_include.c"
+
+#define ROL_MAX_MODULES 8
+
+#ifndef ROL_SCHED_TABLE
+#define ROL_SCHED_TABLE ""
+#endif
+
+/* Blocks of a skipped module left in it before waiting for them */
+#define ROL_SCHED_MAX_PENDING 4
+
+typedef struct
+{
+  const char *name;
+  ROL_POLL *poll;             /* readiness wait: timeout and wait statistics */
+  int  (*ready)();            /* 1: data ready, 0: not yet (non-blocking) */
+  int  (*readout)(int arg, int ready); /* bank at dma_dabufp, returns nwords */
+  int  (*discard)();          /* block at dma_dabufp, not kept, returns nwords */
+  void (*syncCheck)();        /* leftover data check at sync events */
+  int  (*maxWords)();         /* largest bank for this run, at Go */
+
+  int  stat_wait, stat_read;  /* rolStats stages */
+
+  /* per-trigger state */
+  int  state;
+  DMANODE *stage;
+  int  stage_nwords;
+  int  pending;               /* blocks of skipped triggers still in the module */
+
+  /* per-run statistics (ns) */
+  unsigned int nread;
+  unsigned int nstaged;
+  unsigned int nskip;
+  unsigned int ntrunc;        /* banks truncated or dropped, no room in the event */
+  unsigned long long trunc_words;
+  unsigned long long read_sum, read_max;
+  unsigned long long words;
+} ROL_MODULE;
+
+enum rolModuleState
+  {
+    ROL_MOD_WAIT = 0,
+    ROL_MOD_STAGED,
+    ROL_MOD_DONE
+  };
+
+ROL_MODULE rolModule[ROL_MAX_MODULES];
+int nrolModule = 0;
+int rolSchedMode = 1;
+char rolSchedTable[256] = ROL_SCHED_TABLE;
+
+static DMA_MEM_ID rolStagePart = 0;
+static DMA_MEM_ID rolDiscardPart = 0;
+static int rolStageBytes = 0;       /* size of the staging / discard buffers */
+static unsigned int rolSchedTypeMask[256];  /* modules to read, by event type */
+static unsigned int rolSchedAll = 0;
+static unsigned int rolSchedNtrig = 0;
+static unsigned long long rolSchedTime_sum = 0, rolSchedTime_max = 0;
+
+void
+rolSchedSetMode(int mode)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, mode);
+      return;
+    }
+
+  rolSchedMode = (mode) ? 1 : 0;
+  daLogMsg("INFO","Setting readout scheduler mode (%s)",
+	   (rolSchedMode) ? "overlapped" : "sequential");
+}
+
+void
+rolSchedSetTable(char *table)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to \"%s\".\n",
+	     __func__, table);
+      return;
+    }
+
+  strncpy(rolSchedTable, (table) ? table : "", sizeof(rolSchedTable) - 1);
+  rolSchedTable[sizeof(rolSchedTable) - 1] = 0;
+  daLogMsg("INFO","Setting readout table (%s)",
+	   (rolSchedTable[0]) ? rolSchedTable : "all modules");
+}
+
+/* Forget all registered modules.  Called at the start of Download. */
+void
+rolSchedInit()
+{
+  memset(rolModule, 0, sizeof(rolModule));
+  nrolModule = 0;
+  rolStagePart = 0;
+  rolDiscardPart = 0;
+}
+
+/* Register a module.  Banks are written in order of registration.
+   discard may be NULL: the readout routine then reads the blocks to drop.
+   maxWords may be NULL: the bank is then assumed to fit MAX_EVENT_LENGTH. */
+int
+rolSchedRegister(ROL_POLL *poll, int (*ready)(),
+		 int (*readout)(int arg, int ready), int (*discard)(),
+		 void (*syncCheck)(), int (*maxWords)())
+{
+  ROL_MODULE *m;
+  char name[24];
+
+  if(nrolModule >= ROL_MAX_MODULES)
+    {
+      printf("%s: ERROR: Too many modules (max = %d).  Ignoring %s\n",
+	     __func__, ROL_MAX_MODULES, poll->name);
+      return ERROR;
+    }
+
+  m = &rolModule[nrolModule++];
+  memset(m, 0, sizeof(ROL_MODULE));
+  m->name      = poll->name;
+  m->poll      = poll;
+  m->ready     = ready;
+  m->readout   = readout;
+  m->discard   = discard;
+  m->syncCheck = syncCheck;
+  m->maxWords  = maxWords;
+
+  snprintf(name, sizeof(name), "%s wait", m->name);
+  m->stat_wait = rolStatsStage(name, "us");
+  snprintf(name, sizeof(name), "%s read", m->name);
+  m->stat_read = rolStatsStage(name, "us");
+
+  return OK;
+}
+
+/* Module mask from a '+' separated list of module names, or "none" */
+static int
+rolSchedParseModules(const char *list, int len, unsigned int *mask)
+{
+  const char *p = list, *end = list + len, *q;
+  int imod;
+
+  *mask = 0;
+  if((len == 4) && (strncasecmp(list, "none", 4) == 0))
+    return OK;
+
+  while(p < end)
+    {
+      for(q = p; (q < end) && (*q != '+'); q++)
+	;
+
+      for(imod = 0; imod < nrolModule; imod++)
+	if((strlen(rolModule[imod].name) == (size_t)(q - p)) &&
+	   (strncasecmp(rolModule[imod].name, p, q - p) == 0))
+	  break;
+
+      if(imod == nrolModule)
+	{
+	  printf("%s: ERROR: No module %.*s in this readout list\n",
+		 __func__, (int)(q - p), p);
+	  return ERROR;
+	}
+
+      *mask |= 1u << imod;
+      p = q + 1;
+    }
+
+  return OK;
+}
+
+/* Fill the modules to read out for each event type from rolSchedTable */
+static void
+rolSchedParseTable()
+{
+  char entry[sizeof(rolSchedTable)], *tok, *save = NULL, *eq, *dash;
+  int type, first, last, nskip = 0;
+  unsigned int mask;
+
+  rolSchedAll = (1u << nrolModule) - 1;
+  for(type = 0; type < 256; type++)
+    rolSchedTypeMask[type] = rolSchedAll;
+
+  strcpy(entry, rolSchedTable);
+  for(tok = strtok_r(entry, " \t;", &save); tok; tok = strtok_r(NULL, " \t;", &save))
+    {
+      eq = strchr(tok, '=');
+      if(eq == NULL)
+	{
+	  printf("%s: ERROR: Readout table entry \"%s\" is not <type>=<modules>\n",
+		 __func__, tok);
+	  continue;
+	}
+
+      first = last = strtol(tok, &dash, 0);
+      if(*dash == '-')
+	last = strtol(dash + 1, &dash, 0);
+      if((dash != eq) || (first < 0) || (last > 255) || (first > last))
+	{
+	  printf("%s: ERROR: Readout table entry \"%s\": bad event type\n",
+		 __func__, tok);
+	  continue;
+	}
+
+      if(rolSchedParseModules(eq + 1, strlen(eq + 1), &mask) != OK)
+	continue;
+
+      for(type = first; type <= last; type++)
+	rolSchedTypeMask[type] = mask;
+    }
+
+  for(type = 0; type < 256; type++)
+    if(rolSchedTypeMask[type] != rolSchedAll)
+      nskip++;
+
+  if((nskip > 0) && (rolDiscardPart == 0))
+    {
+      printf("%s: ERROR creating discard buffer.  Reading out all modules.\n",
+	     __func__);
+      for(type = 0; type < 256; type++)
+	rolSchedTypeMask[type] = rolSchedAll;
+    }
+}
+
+/* Staging buffers for modules read out ahead of their bank order.
+   The first module is never staged.  Call after all modules are registered.
+   Made at MAX_EVENT_LENGTH (the initial blocklevel), re-sized at Go. */
+void
+rolSchedDownload()
+{
+  int type, imod;
+
+  if(nrolModule > 1)
+    {
+      rolStagePart = dmaPCreate("rolStage", MAX_EVENT_LENGTH, nrolModule - 1, 0);
+      rolStageBytes = MAX_EVENT_LENGTH;
+      if(rolStagePart == 0)
+	{
+	  printf("%s: ERROR creating staging buffers.  Using sequential readout.\n",
+		 __func__);
+	}
+    }
+
+  /* Scratch buffer for the blocks not wanted, and the rest of truncated ones */
+  if(nrolModule > 0)
+    {
+      rolDiscardPart = dmaPCreate("rolDiscard", MAX_EVENT_LENGTH, 1, 0);
+      rolStageBytes = MAX_EVENT_LENGTH;
+      if(rolDiscardPart == 0)
+	printf("%s: ERROR creating discard buffer\n", __func__);
+    }
+
+  printf("%s: %d module(s) registered, %s readout\n", __func__,
+	 nrolModule, (rolSchedMode && rolStagePart) ? "overlapped" : "sequential");
+
+  rolSchedParseTable();
+  for(type = 0; type < 256; type++)
+    {
+      if(rolSchedTypeMask[type] == rolSchedAll)
+	continue;
+
+      printf("\tevent type %3d:", type);
+      for(imod = 0; imod < nrolModule; imod++)
+	if(rolSchedTypeMask[type] & (1u << imod))
+	  printf(" %s", rolModule[imod].name);
+      printf("%s\n", (rolSchedTypeMask[type]) ? "" : " none");
+    }
+}
+
+/* Largest bank of a module for this run, in words */
+static int
+rolSchedModuleWords(ROL_MODULE *m)
+{
+  return (m->maxWords) ? m->maxWords() : (MAX_EVENT_LENGTH >> 2);
+}
+
+/* Largest data from all modules for a block of this run, in words.
+   Call after the modules' Go. */
+int
+rolSchedMaxWords()
+{
+  int imod, nwords = 0;
+
+  for(imod = 0; imod < nrolModule; imod++)
+    nwords += rolSchedModuleWords(&rolModule[imod]);
+
+  return nwords;
+}
+
+/* Re-create a partition with buffers of another size */
+static DMA_MEM_ID
+rolSchedResize(DMA_MEM_ID part, char *name, int bytes, int count)
+{
+  if(part == 0)
+    return 0;
+
+  dmaPFree(part);
+  part = dmaPCreate(name, bytes, count, 0);
+  if(part == 0)
+    printf("%s: ERROR re-creating %s (%d x %d bytes)\n", __func__, name, count, bytes);
+
+  return part;
+}
+
+void
+rolSchedGo()
+{
+  int imod, type, bytes = 0;
+
+  /* Staging and discard buffers for the largest bank of this run */
+  for(imod = 0; imod < nrolModule; imod++)
+    if(4 * rolSchedModuleWords(&rolModule[imod]) > bytes)
+      bytes = 4 * rolSchedModuleWords(&rolModule[imod]);
+  if(bytes > 0)
+    bytes += 4 * ROL_BUF_MARGIN;
+
+  if((bytes > 0) && (bytes != rolStageBytes) && (rolStagePart || rolDiscardPart))
+    {
+      rolStagePart = rolSchedResize(rolStagePart, "rolStage", bytes, nrolModule - 1);
+      rolDiscardPart = rolSchedResize(rolDiscardPart, "rolDiscard", bytes, 1);
+      rolStageBytes = bytes;
+
+      if(rolDiscardPart == 0)
+	for(type = 0; type < 256; type++)
+	  rolSchedTypeMask[type] = rolSchedAll;
+    }
+
+  rolSchedNtrig = 0;
+  rolSchedTime_sum = rolSchedTime_max = 0;
+
+  for(imod = 0; imod < nrolModule; imod++)
+    {
+      ROL_MODULE *m = &rolModule[imod];
+      m->nread = m->nstaged = m->nskip = m->ntrunc = 0;
+      m->trunc_words = 0;
+      m->pending = 0;
+      m->read_sum = m->read_max = 0;
+      m->words = 0;
+    }
+}
+
+/* Marker bank after a module bank cut short, or dropped, for lack of room */
+static void
+rolSchedTruncMark(ROL_MODULE *m, int kept, int dropped)
+{
+  BANKOPEN(ROL_TRUNC_BANK, BT_UI4, (m - rolModule));
+  *dma_dabufp++ = kept;
+  *dma_dabufp++ = dropped;
+  BANKCLOSE;
+
+  m->ntrunc++;
+  m->trunc_words += dropped;
+}
+
+/* The module's block did not fit: drop the rest of it from the module,
+   and mark the bank */
+static void
+rolSchedTruncate(ROL_MODULE *m, int kept)
+{
+  unsigned int *buf_dabufp = dma_dabufp, *buf_end = rolBufEnd;
+  DMANODE *scratch;
+  int dropped = 0;
+
+  scratch = (rolDiscardPart) ? dmaPGetItem(rolDiscardPart) : NULL;
+  if(scratch)
+    {
+      dma_dabufp = (unsigned int *)&(scratch->data[0]);
+      rolBufSet(dma_dabufp, rolStageBytes);
+      dropped = (m->discard) ? m->discard() : m->readout(0, 1);
+      dmaPFreeItem(scratch);
+    }
+  dma_dabufp = buf_dabufp;
+  rolBufEnd = buf_end;
+  rolBufTrunc = 0;
+
+  rolSchedTruncMark(m, kept, (dropped > 0) ? dropped : 0);
+}
+
+/* Readout one module, either into the event or into its staging buffer.
+   Returns 0 if there was no staging buffer for it. */
+static int
+rolSchedReadModule(ROL_MODULE *m, int arg, int ready, int stage)
+{
+  unsigned int *event_dabufp = dma_dabufp, *event_end = rolBufEnd, *start;
+  unsigned long long tready, tdone, dt;
+  int nwords;
+
+  if(stage)
+    {
+      m->stage = dmaPGetItem(rolStagePart);
+      if(m->stage == NULL)
+	return 0; /* Wait for its turn */
+
+      dma_dabufp = (unsigned int *)&(m->stage->data[0]);
+      rolBufSet(dma_dabufp, rolStageBytes);
+    }
+
+  tready = rolStatsTick();
+  start = dma_dabufp;
+
+  m->readout(arg, ready);
+  if(rolBufTrunc)
+    rolSchedTruncate(m, dma_dabufp - start);
+
+  tdone = rolStatsTick();
+  nwords = dma_dabufp - start;
+
+  if(stage)
+    {
+      m->stage_nwords = nwords;
+      dma_dabufp = event_dabufp;
+      rolBufEnd = event_end;
+      m->state = ROL_MOD_STAGED;
+      m->nstaged++;
+    }
+  else
+    m->state = ROL_MOD_DONE;
+
+  dt = rolStatsNs(tdone - tready);
+  m->nread++;
+  m->words += nwords;
+  m->read_sum += dt;
+  if(dt > m->read_max)
+    m->read_max = dt;
+  rolStatsAdd(m->stat_read, dt);
+
+  return 1;
+}
+
+/* Copy staged banks into the event, in order, up to the first module
+   still waiting.  Returns the index of that module. */
+static int
+rolSchedFlush(int next)
+{
+  while((next < nrolModule) && (rolModule[next].state != ROL_MOD_WAIT))
+    {
+      ROL_MODULE *m = &rolModule[next];
+
+      if(m->state == ROL_MOD_STAGED)
+	{
+	  if(rolBufEnd && (dma_dabufp + m->stage_nwords > rolBufEnd))
+	    rolSchedTruncMark(m, 0, m->stage_nwords);
+	  else
+	    {
+	      memcpy((void *)dma_dabufp, (void *)&(m->stage->data[0]),
+		     m->stage_nwords << 2);
+	      dma_dabufp += m->stage_nwords;
+	    }
+	  dmaPFreeItem(m->stage);
+	  m->stage = NULL;
+	  m->state = ROL_MOD_DONE;
+	}
+      next++;
+    }
+
+  return next;
+}
+
+/* Modules to readout for the trigger block from tiReadTriggerBlock():
+   those wanted by any of its event types.  All of them at sync events,
+   or if the block has no events. */
+unsigned int
+rolSchedSelect(volatile unsigned int *tiblock, int nwords, int sync)
+{
+  unsigned int mask = 0, w;
+  int iev, nev, pos = 2;
+
+  if(sync || (nwords < 3))
+    return rolSchedAll;
+
+  nev = tiblock[1] & 0xff;
+  for(iev = 0; (iev < nev) && (pos < nwords); iev++)
+    {
+      w = tiblock[pos];
+      mask |= rolSchedTypeMask[w >> 24];
+      pos += (w & 0xffff) + 1;
+    }
+
+  return (iev) ? mask : rolSchedAll;
+}
+
+/* Drop the blocks left in a module by skipped triggers.  With wait = 0,
+   only those already there. */
+static void
+rolSchedDrain(ROL_MODULE *m, int wait)
+{
+  unsigned int *event_dabufp = dma_dabufp, *event_end = rolBufEnd;
+  DMANODE *scratch;
+
+  while(m->pending > 0)
+    {
+      if(wait)
+	rolPollWait(m->poll, m->ready);
+      else if(!m->ready())
+	return;
+
+      scratch = dmaPGetItem(rolDiscardPart);
+      if(scratch == NULL)
+	return;
+
+      dma_dabufp = (unsigned int *)&(scratch->data[0]);
+      rolBufSet(dma_dabufp, rolStageBytes);
+      if(m->discard)
+	m->discard();
+      else
+	m->readout(0, 1);
+      dma_dabufp = event_dabufp;
+      rolBufEnd = event_end;
+      rolBufTrunc = 0;
+
+      dmaPFreeItem(scratch);
+      m->pending--;
+    }
+}
+
+/* Readout the registered modules in mask (from rolSchedSelect) for the
+   current trigger */
+void
+rolSchedReadout(int arg, unsigned int mask)
+{
+  int imod, next = 0, ready, nread;
+  unsigned long long t0, now, dt;
+
+  if(nrolModule == 0)
+    return;
+
+  t0 = rolPollNow();
+
+  for(imod = 0; imod < nrolModule; imod++)
+    {
+      ROL_MODULE *m = &rolModule[imod];
+
+      if(mask & (1u << imod))
+	{
+	  m->state = ROL_MOD_WAIT;
+	  if(m->pending)
+	    rolSchedDrain(m, 1);
+	}
+      else
+	{
+	  m->state = ROL_MOD_DONE;
+	  m->nskip++;
+	  m->pending++;
+	  rolSchedDrain(m, (m->pending > ROL_SCHED_MAX_PENDING));
+	}
+    }
+
+  if((rolSchedMode == 0) || (rolStagePart == 0))
+    {
+      for(imod = 0; imod < nrolModule; imod++)
+	{
+	  ROL_MODULE *m = &rolModule[imod];
+
+	  if(m->state != ROL_MOD_WAIT)
+	    continue;
+
+	  ready = rolPollWait(m->poll, m->ready);
+	  rolStatsAdd(m->stat_wait, m->poll->wait_last);
+
+	  rolSchedReadModule(m, arg, ready, 0);
+	}
+    }
+  else
+    {
+      /* Every module has been waiting since the trigger */
+      for(imod = 0; imod < nrolModule; imod++)
+	if(rolModule[imod].state == ROL_MOD_WAIT)
+	  rolPollStart(rolModule[imod].poll, t0);
+
+      next = rolSchedFlush(0);
+
+      while(next < nrolModule)
+	{
+	  nread = 0;
+	  for(imod = next; imod < nrolModule; imod++)
+	    {
+	      ROL_MODULE *m = &rolModule[imod];
+
+	      if(m->state != ROL_MOD_WAIT)
+		continue;
+
+	      ready = rolPollCheck(m->poll, m->ready);
+	      now = rolPollNow();
+	      if(!ready && !rolPollExpired(m->poll, now))
+		continue;
+
+	      if(!rolSchedReadModule(m, arg, ready, (imod != next)))
+		continue;
+
+	      rolPollDone(m->poll, ready, now);
+	      rolStatsAdd(m->stat_wait, m->poll->wait_last);
+	      nread++;
+
+	      next = rolSchedFlush(next);
+	    }
+
+	  /* Nothing was ready this round */
+	  if((nread == 0) && (next < nrolModule))
+	    rolPollBackoff(rolModule[next].poll, rolPollNow());
+	}
+    }
+
+  dt = rolPollNow() - t0;
+  rolSchedNtrig++;
+  rolSchedTime_sum += dt;
+  if(dt > rolSchedTime_max)
+    rolSchedTime_max = dt;
+}
+
+/* Sync event checks, in bank order */
+void
+rolSchedSyncCheck()
+{
+  int imod;
+
+  for(imod = 0; imod < nrolModule; imod++)
+    {
+      if(rolModule[imod].syncCheck)
+	rolModule[imod].syncCheck();
+    }
+}
+
+void
+rolSchedStatus()
+{
+  int imod;
+  double n;
+
+  printf("\n%s: Readout scheduler (%s) - %d triggers\n", __func__,
+	 (rolSchedMode && rolStagePart) ? "overlapped" : "sequential",
+	 rolSchedNtrig);
+
+  if(rolSchedNtrig == 0)
+    return;
+
+  printf("  Module       Reads  Staged Skipped Timeout  Wait avg/max (us)  Read avg/max (us)  Words/read\n");
+  printf("----------------------------------------------------------------------------------------------\n");
+  for(imod = 0; imod < nrolModule; imod++)
+    {
+      ROL_MODULE *m = &rolModule[imod];
+
+      n = (m->nread) ? (double) m->nread : 1.;
+      printf("  %-10s %7u %7u %7u %7u  %8.1f %8.1f  %8.1f %8.1f  %10.1f\n",
+	     m->name, m->nread, m->nstaged, m->nskip, m->poll->ntimeout,
+	     1e-3 * m->poll->wait_sum / n, 1e-3 * m->poll->wait_max,
+	     1e-3 * m->read_sum / n, 1e-3 * m->read_max,
+	     (double) m->words / n);
+    }
+  printf("----------------------------------------------------------------------------------------------\n");
+  printf("  All modules                                %8.1f %8.1f (us per trigger)\n\n",
+	 1e-3 * rolSchedTime_sum / rolSchedNtrig, 1e-3 * rolSchedTime_max);
+
+  for(imod = 0; imod < nrolModule; imod++)
+    if(rolModule[imod].ntrunc)
+      printf("  %s: %u bank(s) truncated, no room in the event buffer (%llu words dropped)\n",
+	     rolModule[imod].name, rolModule[imod].ntrunc, rolModule[imod].trunc_words);
+
+  printf("  Readiness waits (backoff: spin %d us, pause %d..%d us)\n",
+	 rolPollSpinUs, rolPollPauseUs, rolPollPauseMaxUs);
+  for(imod = 0; imod < nrolModule; imod++)
+    rolPollStatus(rolModule[imod].poll);
+  printf("\n");
+}
+
+/*
+  Local Variables:
+  compile-command: "make -k"
+  End:
+*/
@@ -0,0 +1,34 @@
+#pragma once
+/*************************************************************************
+ *
+ *  dmaBankTools.h - (simulation)
+ *
+ *   CODA bank macros for building banks in DMA memory.
+ *
+ */
+
+#include "jvme.h"
+
+#define BT_UI4_ty  0x01
+#define BT_BANK_ty 0x0e
+
+extern DMANODE *the_event;
+extern unsigned int *dma_dabufp;
+
+#define BANKOPEN(bnum, btype, code) {					\
+    unsigned int *StartOfBank;						\
+    StartOfBank = (dma_dabufp);						\
+    *(++(dma_dabufp)) = (((bnum) << 16) | (btype##_ty) << 8) | (code);	\
+    ((dma_dabufp))++;
+
+#define BANKCLOSE							\
+    *StartOfBank = (unsigned long) (((char *) (dma_dabufp)) - ((char *) StartOfBank)); \
+    if ((*StartOfBank & 1) != 0) {					\
+      (dma_dabufp) = ((unsigned int *)((char *) (dma_dabufp))+1);	\
+      *StartOfBank += 1;						\
+    };									\
+    if ((*StartOfBank & 2) !=0) {					\
+      *StartOfBank = *StartOfBank + 2;					\
+      (dma_dabufp) = ((unsigned int *)((short *) (dma_dabufp))+1);	\
+    };									\
+    *StartOfBank = ( (*StartOfBank) >> 2) - 1;};
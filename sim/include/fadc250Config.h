@@ -0,0 +1,8 @@
+#pragma once
+/*************************************************************************
+ *
+ *  fadc250Config.h - (simulation)
+ *
+ */
+
+int fadc250Config(char *fname);
@@ -0,0 +1,46 @@
+#pragma once
+/*************************************************************************
+ *
+ *  fadcLib.h - (simulation)
+ *
+ *   Stand-in for the JLab FADC250 library.  Implemented in simFadc.c.
+ *
+ */
+
+#include "jvme.h"
+
+#define FA_MAX_BOARDS        20
+#define FA_MAX_ADC_CHANNELS  16
+
+#define FA_INIT_VXS_TRIG     0x20
+#define FA_INIT_VXS_CLKSRC   0x20000
+
+extern int nfadc;
+extern unsigned int fadcA32Base;
+
+int  faInit(unsigned int addr, unsigned int addr_inc, int nadc, int iFlag);
+int  faSlot(unsigned int i);
+unsigned int faScanMask();
+void faGStatus(int sflag);
+void faEnableBusError(int id);
+void faDisableMultiBlock();
+void faEnableMultiBlock(int tflag);
+int  faResetMGT(int id, int reset);
+int  faSetTrigOut(int id, int trigout);
+int  faSetTriggerBusyCondition(int id, int nbusy);
+void faSoftReset(int id, int cflag);
+void faResetToken(int id);
+void faResetTriggerCount(int id);
+void faEnableSyncReset(int id);
+void faGSetBlockLevel(int level);
+int  faGetProcMode(int id, int *pmode, unsigned int *PL, unsigned int *PTW,
+		   unsigned int *NSB, unsigned int *NSA, unsigned int *NP);
+unsigned int faGetChannelMask(int id);
+void faGEnable(int eflag, int bank);
+void faGDisable(int eflag);
+void faGReset(int reset);
+unsigned int faGBlockReady(unsigned int slotmask, int nloop);
+int  faBready(int id);
+unsigned int faGetA32(int id);
+int  faReadBlock(int id, volatile unsigned int *data, int nwrds, int rflag);
+int  faGetBlockError(int pflag);
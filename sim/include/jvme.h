@@ -0,0 +1,86 @@
+#pragma once
+/*************************************************************************
+ *
+ *  jvme.h - (simulation)
+ *
+ *   Stand-in for the JLab VME library: VME access, DMA configuration and
+ *   the DMA memory partition (dmaPList) routines used by the readout
+ *   lists.  Implemented in simVme.c.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef OK
+#define OK     0
+#endif
+#ifndef ERROR
+#define ERROR -1
+#endif
+
+typedef int STATUS;
+
+#define MAX_VME_SLOTS 21
+
+#define LSWAP(x)        ((((x) & 0x000000ff) << 24) |	\
+			 (((x) & 0x0000ff00) <<  8) |	\
+			 (((x) & 0x00ff0000) >>  8) |	\
+			 (((x) & 0xff000000) >> 24))
+
+#define SSWAP(x)        ((((x) & 0x00ff) << 8) |	\
+			 (((x) & 0xff00) >> 8))
+
+/* VME bus access */
+int      vmeOpenDefaultWindows();
+int      vmeCloseDefaultWindows();
+void     vmeSetQuietFlag(unsigned int pflag);
+int      vmeBusLock();
+int      vmeBusUnlock();
+unsigned int vmeRead32(volatile unsigned int *addr);
+void     vmeWrite32(volatile unsigned int *addr, unsigned int val);
+int      vmeDmaConfig(unsigned int addrType, unsigned int dataType,
+		      unsigned int sstMode);
+int      vmeDmaFlush(unsigned int addr);
+
+/* DMA memory partitions */
+typedef struct dmanode
+{
+  struct dmanode *n;            /* next node in list */
+  struct dmaPart *part;         /* partition owning the node */
+  int   length;                 /* event length in bytes */
+  int   type;
+  int   nevent;
+  int   reserved;
+  unsigned int data[1];         /* start of data */
+} DMANODE;
+
+typedef struct dmaPart
+{
+  char     name[40];
+  int      size;                /* bytes of data per node */
+  int      total;               /* nodes in partition */
+  int      nlist;               /* nodes on the list */
+  DMANODE *head, *tail;         /* list of available nodes */
+  DMANODE **nodes;
+  void    *mem;                 /* node memory, one mapping */
+  size_t   memsize;
+  struct dmaPart *next;
+} DMA_MEM_PART;
+
+typedef DMA_MEM_PART *DMA_MEM_ID;
+
+int        dmaPartInit();
+DMA_MEM_ID dmaPCreate(char *name, int size, int c, int incr);
+int        dmaPFree(DMA_MEM_ID pPart);
+void       dmaPFreeAll();
+void       dmaPReInit(DMA_MEM_ID pPart);
+void       dmaPReInitAll();
+DMANODE   *dmaPGetItem(DMA_MEM_ID pPart);
+void       dmaPPutItem(DMA_MEM_ID pPart, DMANODE *pItem);
+void       dmaPFreeItem(DMANODE *pItem);
+int        dmaPEmpty(DMA_MEM_ID pPart);
+int        dmaPNodeCount(DMA_MEM_ID pPart);
+void       dmaPStatsAll();
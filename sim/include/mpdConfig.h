@@ -0,0 +1,8 @@
+#pragma once
+/*************************************************************************
+ *
+ *  mpdConfig.h - (simulation)
+ *
+ */
+
+#include "mpdLib.h"
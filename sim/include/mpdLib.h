@@ -0,0 +1,74 @@
+#pragma once
+/*************************************************************************
+ *
+ *  mpdLib.h - (simulation)
+ *
+ *   Stand-in for the INFN MPD library (SSP fiber mode).  Implemented in
+ *   simSsp.c.  MPD "slots" are SSP fiber numbers.
+ *
+ */
+
+#include <stdint.h>
+#include "jvme.h"
+
+#define MPD_MAX_BOARDS  31
+#define MPD_MAX_APV     16
+
+#define MPD_INIT_SSP_MODE              (1<<8)
+#define MPD_INIT_NO_CONFIG_FILE_CHECK  (1<<9)
+
+struct output_buffer_struct
+{
+  uint32_t evb_fifo_word_count;
+  uint32_t block_count;
+  uint32_t event_count;
+  uint32_t trigger_count;
+  uint32_t missed_trigger;
+  uint32_t incoming_trigger;
+  uint32_t sdram_fifo_wr_addr;
+  uint32_t sdram_fifo_rd_addr;
+  uint32_t sdram_flag_wc;
+  uint32_t output_buffer_flag_wc;
+  uint32_t latched_full;
+};
+
+struct mpd_struct
+{
+  uint32_t ctrl[0x40];
+  uint32_t apv_status;
+  uint32_t reserved[0x3f];
+  struct output_buffer_struct ob_status;
+};
+
+extern volatile struct mpd_struct *MPDp[(MPD_MAX_BOARDS+1)];
+
+uint32_t mpdRead32(volatile uint32_t *reg);
+void     mpdWrite32(volatile uint32_t *reg, uint32_t value);
+
+int  mpdInit(uint32_t rotary_addr, uint32_t addr_inc, int nfind, int iFlag);
+int  mpdGetNumberMPD();
+int  mpdSlot(uint32_t i);
+uint32_t mpdGetSSPFiberMask(int ssp_slot);
+void mpdSetPrintDebug(int b);
+int  mpdHISTO_MemTest(int id);
+int  mpdI2C_Init(int id);
+int  I2C_SendStop(int id);
+int  mpdI2C_ApvReset(int id);
+int  mpdAPV_Scan(int id);
+int  mpdAPV_Config(int id, int apv_index);
+int  mpdAPV_Reset101(int id);
+int  mpdFIFO_IsSynced(int id, int channel);
+int  mpdGetNumberAPV(int id);
+uint16_t mpdGetApvEnableMask(int id);
+int  mpdDELAY25_Set(int id, int adc0_delay, int adc1_delay);
+int  mpdGetAdcClockPhase(int id, int adc);
+int  mpdADS5281_Config(int id);
+int  mpdGetUseSdram(int id);
+int  mpdGetFastReadout(int id);
+int  mpdSetAcqMode(int id, char *name);
+int  mpdPEDTHR_Write(int id);
+int  mpdDAQ_Enable(int id);
+int  mpdDAQ_Disable(int id);
+int  mpdTRIG_Enable(int id);
+int  mpdTRIG_Disable(int id);
+void mpdGStatus(int statusFlag);
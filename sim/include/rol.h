@@ -0,0 +1,34 @@
+#pragma once
+/*************************************************************************
+ *
+ *  rol.h - (simulation)
+ *
+ *   Readout list parameters passed from the CODA ROC to a readout list.
+ *
+ */
+
+#define DA_INIT_PROC      0
+#define DA_DOWNLOAD_PROC  1
+#define DA_PRESTART_PROC  2
+#define DA_END_PROC       3
+#define DA_PAUSE_PROC     4
+#define DA_GO_PROC        5
+#define DA_POLL_PROC      6
+#define DA_DONE_PROC      7
+#define DA_REPORT_PROC    8
+#define DA_FREE_PROC      9
+
+typedef struct rolParameters *rolParam;
+
+typedef struct rolParameters
+{
+  char *name;            /* name of the readout list */
+  char *usrString;       /* user string from the configuration */
+  int   runType;         /* config id */
+  int   runNumber;
+  int   daproc;          /* transition to execute */
+  int   pid;             /* ROC id */
+  int   poll;            /* set by POLL: events processed */
+} ROLPARAMS;
+
+int daLogMsg(char *severity, char *fmt, ...);
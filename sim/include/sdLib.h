@@ -0,0 +1,15 @@
+#pragma once
+/*************************************************************************
+ *
+ *  sdLib.h - (simulation)
+ *
+ *   Stand-in for the VXS Signal Distribution library.
+ *
+ */
+
+#define SD_INIT_IGNORE_VERSION (1<<0)
+
+int sdInit(int flag);
+int sdStatus(int pflag);
+int sdSetActiveVmeSlots(unsigned int vmemask);
+int sdSetBusyVmeSlots(unsigned int busymask, int reset);
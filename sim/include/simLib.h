@@ -0,0 +1,175 @@
+#pragma once
+/*************************************************************************
+ *
+ *  simLib.h -
+ *
+ *   Simulation backend standing in for the jvme, ti, sd, fadc, ssp and
+ *   mpd libraries, so the readout lists can be run and timed on a plain
+ *   Linux box (see rolbench.c).
+ *
+ *   Each module (TI, FADC250, SSP-MPD, SSP-MAROC) is modelled by a
+ *   queue of blocks.  A trigger pushes one block into each active
+ *   module, which becomes ready after the module's latency.  Reading a
+ *   block costs the DMA setup time plus its size over the DMA bandwidth
+ *   (plus a bus error when the transfer is terminated by one).  Single
+ *   cycle VME reads and writes cost vme_read_us and vme_write_us.  All
+ *   waits are busy-waits, so what the readout list sees is what the
+ *   crate would do.
+ *
+ *   Parameters are set by name with simSet("key", "value") or
+ *   simSetParam("key=value").  simPrintParams() lists them.
+ *
+ */
+
+#include <stdint.h>
+
+enum simModuleId
+  {
+    SIM_TI = 0,
+    SIM_FADC,
+    SIM_MPD,
+    SIM_MAROC,
+    SIM_NMOD
+  };
+
+/* Block flags set by failure injection */
+#define SIM_BLK_LATE     (1<<0)   /* data arrives timeout_ms late */
+#define SIM_BLK_ERROR    (1<<1)   /* block error, truncated data */
+#define SIM_BLK_MISSING  (1<<2)   /* block never arrives */
+#define SIM_BLK_SYNC     (1<<3)   /* TI: sync event block */
+
+#define SIM_RING 64
+
+typedef struct
+{
+  unsigned int evnum;           /* first event number in the block */
+  int          nevents;
+  unsigned long long ts;        /* timestamp of first event (4ns ticks) */
+  unsigned long long trig_ns;   /* when the trigger arrived */
+  unsigned long long ready_ns;  /* when the data is ready */
+  int          flags;
+  int          evtype[256];
+  int          nwords;          /* -1 until generated */
+  int          offset;          /* words already read */
+  unsigned int *data;
+  int          alloc;
+} SIM_BLOCK;
+
+typedef struct
+{
+  /* model (set with simSet) */
+  double latency_us;
+  double jitter_us;
+  double dma_setup_us;
+  double dma_mbps;
+  double p_late;
+  double timeout_ms;
+  double p_error;
+  double p_missing;
+  double p_slip;
+
+  /* state */
+  const char *name;
+  int        active;
+  SIM_BLOCK  ring[SIM_RING];
+  int        head, count;
+  unsigned int blocknum;
+  int        last_error;
+  unsigned long long ts_slip;   /* clock ticks lost, this run */
+
+  /* statistics */
+  unsigned long long nblocks, nwords, nread_calls, nbuserr;
+  unsigned int n_late, n_error, n_missing, n_slip;
+  float     *lat;               /* trigger -> block read (us) */
+  float     *dma;               /* time in read calls for the block (us) */
+  int        nlat, alat;
+  double     dma_acc;           /* dma time accumulated for the current block */
+} SIM_MODULE;
+
+typedef struct
+{
+  double rate_hz;               /* event rate, 0 = next trigger when idle */
+  double poisson;               /* 1: random arrival times */
+  double seed;
+  double vme_read_us;
+  double vme_write_us;
+  double mpd_read_us;
+  double buserr_us;
+  double init_scale;            /* scales the module init delays */
+
+  double ti_bufferlevel;
+  double evtype_2;              /* fraction of events with type 2 */
+  double evtype_3;              /* fraction of events with type 3 */
+  double evtype_pulser;         /* fraction of events from the TI pulser, while it runs */
+  double pulser_evtype;         /* their event type */
+
+  double fadc_n;
+  double fadc_ptw;
+  double fadc_nch;
+  double fadc_mode;             /* 1: window raw, 2: pulse raw */
+  double fadc_npulse;           /* pulse raw: pulses per channel (up to NP) */
+
+  double mpd_nfiber;
+  double mpd_napv;
+  double mpd_hit_prob;          /* probability a strip has a hit */
+  double mpd_noise;             /* pedestal rms (ADC) */
+  double mpd_cm_rms;            /* common mode rms per APV/sample (ADC) */
+  double mpd_settle_ms;         /* APV frame sync after the 101 reset */
+  double mpd_soft_rate;         /* soft errors/s on fiber 0 */
+  double mpd_soft_down;         /* fiber 0 soft errors at which its link goes down, 0 = never */
+  double mpd_hang;              /* probability a block hangs the MPD output */
+  double mpd_hang_level;        /* what clears a hang: 2 fiber reset, 3 MPD re-arm, 4 nothing */
+
+  double maroc_words;           /* hit words per event */
+  double ssp_eb_stale;          /* probability the SSP event builder word count is stale */
+  double eb_mbps;               /* event builder input rate (MB/s), 0 = immediate */
+} SIM_CONFIG;
+
+extern SIM_CONFIG simConfig;
+extern SIM_MODULE simModule[SIM_NMOD];
+
+/* Control, used by the driver */
+void   simReset();
+int    simSet(const char *key, const char *value);
+int    simSetParam(const char *keyval);
+void   simPrintParams();
+void   simEventStart();
+void   simSyncBusy(int on);
+void   simRunStart();
+void   simRunStop();
+int    simRunning();
+int    simRunDone();
+void   simSetBlockLimit(unsigned int limit);
+unsigned long long simNow();
+void   simEventOut(unsigned int *data, int nwords, int maxwords,
+		   unsigned long long t0, unsigned long long t1);
+struct dmaPart;
+void   simEbDrain(struct dmaPart *outQ);
+void   simEbFlush();
+void   simGetRunStats(unsigned long long *nblocks, unsigned long long *nevents,
+		      unsigned long long *nbytes, unsigned long long *nlost,
+		      unsigned long long *noverrun, float **trig_us, int *ntrig);
+
+/* Internal, shared between the library stand-ins */
+void   simSpin(double us);
+void   simSpinUntil(unsigned long long t_ns);
+void   simVmeRead();
+void   simVmeWrite();
+void   simSleep(double ms);
+double simRand();
+double simGauss();
+void   simAdvance();
+SIM_BLOCK *simReadyBlock(int mod);
+int    simReadyCount(int mod);
+void   simBlockRead(int mod, SIM_BLOCK *blk, volatile unsigned int *data,
+		    int nwrds, int *nread);
+void   simModuleActivate(int mod, int active);
+int    simBlockLevel();
+int    simPulserOn();
+void   simGenerate(int mod, SIM_BLOCK *blk);
+void   simGenTi(SIM_BLOCK *blk, int slot);
+void   simGenFadc(SIM_BLOCK *blk, int slot);
+void   simGenMpd(SIM_BLOCK *blk, int slot);
+int    simMpdHung();
+void   simGenMaroc(SIM_BLOCK *blk, int slot);
+void   simBlockAlloc(SIM_BLOCK *blk, int nwords);
@@ -0,0 +1,9 @@
+#pragma once
+/*************************************************************************
+ *
+ *  sspConfig.h - (simulation)
+ *
+ */
+
+void sspInitGlobals();
+int  sspConfig(char *fname);
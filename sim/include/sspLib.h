@@ -0,0 +1,45 @@
+#pragma once
+/*************************************************************************
+ *
+ *  sspLib.h - (simulation)
+ *
+ *   Stand-in for the JLab SSP library.  Implemented in simSsp.c.
+ *
+ */
+
+#include "jvme.h"
+
+#define SSP_MAX_FIBERS          32
+
+#define SSP_INIT_MODE_DISABLED  0x0000
+#define SSP_INIT_MODE_P2        0x0001
+#define SSP_INIT_MODE_FP        0x0002
+#define SSP_INIT_MODE_VXS       0x0003
+#define SSP_INIT_MODE_VXSLOCAL  0x0004
+#define SSP_INIT_USE_ADDRLIST   (1<<9)
+
+/* SSP register space */
+typedef struct
+{
+  volatile unsigned int Cfg[0x400];     /* 0x0000-0x0FFF */
+  volatile unsigned int EB[0x400];      /* 0x1000-0x1FFF */
+  volatile unsigned int Ser[SSP_MAX_FIBERS][0x40]; /* 0x2000-0x3FFF */
+} SSP_regs;
+
+extern int nSSP;
+extern unsigned int sspA32Base;
+
+int  sspInit(unsigned int addr, unsigned int addr_inc, int nfind, int iFlag);
+unsigned int sspSlotMask();
+int  sspSlot(unsigned int i);
+int  sspStatus(int id, int rflag);
+void sspGStatus(int rflag);
+int  sspSetBlockLevel(int id, int level);
+int  sspEnableBusError(int id);
+int  sspSoftReset(int id);
+int  sspMigReset(int id, int en);
+int  sspBReady(int id);
+int  sspGetEbStatus(int id, unsigned int *blockcnt, unsigned int *wordcnt,
+		    unsigned int *eventcnt);
+int  sspPrintEbStatus(int id);
+int  sspReadBlock(int id, volatile unsigned int *data, int nwrds, int rflag);
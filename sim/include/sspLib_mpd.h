@@ -0,0 +1,49 @@
+#pragma once
+/*************************************************************************
+ *
+ *  sspLib_mpd.h - (simulation)
+ *
+ *   MPD fiber interface of the SSP.  Implemented in simSsp.c.
+ *
+ */
+
+#include "sspLib.h"
+
+/* MPD fiber registers, overlaid on the SSP serial register space */
+typedef struct
+{
+  volatile unsigned int Ctrl;
+  volatile unsigned int Status;
+  volatile unsigned int SoftErrCnt;
+  volatile unsigned int Reserved0;
+  volatile unsigned int EBCtrl;
+  volatile unsigned int Reserved1[0x40 - 5];
+} MPD_regs;
+
+typedef struct
+{
+  volatile unsigned int Cfg[0x400];
+  volatile unsigned int EB[0x400];
+  MPD_regs MPD[SSP_MAX_FIBERS];
+} SSP_MPD_regs;
+
+#define MPD_STATUS_CHANNELUP   0x00001000
+#define MPD_STATUS_HARDERROR   0x00000001
+#define MPD_STATUS_FRAMEERROR  0x00000002
+#define MPD_STATUS_SOFTERRORS  0x00000F00
+
+#define MPD_EBCTRL_ENABLE      0x00000001
+
+int sspMpdFiberReset(int id);
+int sspMpdFiberLinkReset(int id, unsigned int fibermask);
+int sspMpdEnable(int id, unsigned int fibermask);
+int sspMpdDisable(int id, unsigned int fibermask);
+int sspMpdEbSetFlags(int id, int build_all_samples, int build_debug_headers,
+		     int enable_cm, int noprocessing_prescale);
+int sspMpdSetApvOffset(int id, int mpd, int apv, int ch, int val);
+int sspMpdGetApvOffset(int id, int mpd, int apv, int ch);
+int sspMpdSetApvThreshold(int id, int mpd, int apv, int ch, int val);
+int sspMpdGetApvThreshold(int id, int mpd, int apv, int ch);
+int sspMpdSetAvg(int id, int mpd, int apv, int avg_min, int avg_max);
+int sspMpdPrintStatus(int id);
+int sspMpdGetSoftErrorCount(int id, int fiber);
@@ -0,0 +1,9 @@
+#pragma once
+/*************************************************************************
+ *
+ *  sspMpdConfig.h - (simulation)
+ *
+ */
+
+int sspMpdConfigInit(char *fname);
+int sspMpdConfigLoad();
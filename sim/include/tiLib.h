@@ -0,0 +1,83 @@
+#pragma once
+/*************************************************************************
+ *
+ *  tiLib.h - (simulation)
+ *
+ *   Stand-in for the JLab Trigger Interface library.  Implemented in
+ *   simTi.c.  Triggers arrive at the rate configured with simSet().
+ *
+ */
+
+#include "jvme.h"
+
+/* tiInit readout modes */
+#define TI_READOUT_EXT_INT    0
+#define TI_READOUT_TS_INT     1
+#define TI_READOUT_EXT_POLL   2
+#define TI_READOUT_TS_POLL    3
+
+#define TI_INIT_NO_INIT        (1<<0)
+#define TI_INIT_SKIP_FIRMWARE_CHECK (1<<2)
+#define TI_INIT_SLAVE_FIBER_5  (1<<5)
+
+/* Trigger sources */
+#define TI_TRIGGER_P0        0
+#define TI_TRIGGER_HFBR1     1
+#define TI_TRIGGER_FPTRG     2
+#define TI_TRIGGER_TSINPUTS  3
+#define TI_TRIGGER_TSREV2    4
+#define TI_TRIGGER_PULSER    5
+#define TI_TRIGGER_PART_1    6
+
+#define TI_TRIGSRC_P0        (1<<0)
+#define TI_TRIGSRC_HFBR1     (1<<1)
+#define TI_TRIGSRC_LOOPBACK  (1<<2)
+#define TI_TRIGSRC_FPTRG     (1<<3)
+#define TI_TRIGSRC_VME       (1<<4)
+#define TI_TRIGSRC_TSINPUTS  (1<<5)
+#define TI_TRIGSRC_TSREV2    (1<<6)
+#define TI_TRIGSRC_PULSER    (1<<7)
+
+#define TI_TSINPUT_1   (1<<0)
+#define TI_TSINPUT_2   (1<<1)
+#define TI_TSINPUT_3   (1<<2)
+#define TI_TSINPUT_4   (1<<3)
+#define TI_TSINPUT_5   (1<<4)
+#define TI_TSINPUT_6   (1<<5)
+#define TI_TSINPUT_ALL 0x3f
+
+int  tiInit(unsigned int tAddr, unsigned int mode, int force);
+int  tiStatus(int pflag);
+int  tiSetTriggerSource(int trig);
+int  tiSetTriggerSourceMask(int trigmask);
+int  tiEnableTSInput(unsigned int inpMask);
+int  tiLoadTriggerTable(int mode);
+int  tiSetTriggerHoldoff(int rule, unsigned int value, int timestep);
+int  tiSetTriggerPulse(int trigger, int delay, int width, int delay_step);
+int  tiSetBlockLevel(int blockLevel);
+int  tiSetBlockBufferLevel(unsigned int level);
+int  tiGetBlockBufferLevel();
+int  tiGetCurrentBlockLevel();
+int  tiGetBroadcastBlockBufferLevel();
+int  tiUseBroadcastBufferLevel(int enable);
+int  tiSetBlockLimit(unsigned int limit);
+int  tiSetInputPrescale(int input, int prescale);
+int  tiGetInputPrescale(int input);
+unsigned int tiGetTSscaler(int input, int latch);
+int  tiSetEvTypeScalers(int enable);
+int  tiSetSyncEventInterval(int blk_interval);
+int  tiGetSyncEventInterval();
+int  tiGetSyncEventFlag();
+int  tiSetRandomTrigger(int trigger, int setting);
+int  tiDisableRandomTrigger();
+int  tiSoftTrig(int trigger, unsigned int nevents, unsigned int period_inc, int range);
+int  tiSetOutputPort(unsigned int set1, unsigned int set2, unsigned int set3,
+		     unsigned int set4);
+int  tiResetSlaveConfig();
+unsigned int tiGetIntCount();
+int  tiIntEnable(int iflag);
+int  tiIntDisable();
+int  tiIntAck();
+int  tiBReady();
+int  tiReadTriggerBlock(volatile unsigned int *data);
+unsigned int tiGetAdr32();
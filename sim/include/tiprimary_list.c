@@ -0,0 +1,190 @@
+/*************************************************************************
+ *
+ *  tiprimary_list.c - (simulation)
+ *
+ *   Readout list skeleton for the TI, as included by ti_list.c.  Calls
+ *   the user routines rocDownload(), rocPrestart(), rocGo(), rocEnd(),
+ *   rocTrigger() and rocCleanup() for the CODA transitions requested
+ *   through INIT_NAME(rolParam).
+ *
+ *   Each DA_POLL_PROC checks for a trigger block, builds one event in
+ *   vmeIN, and hands it to the simulation (simEventOut) as the CODA
+ *   output would.  The event builder (simEbDrain) returns the buffers
+ *   to vmeIN at eb_mbps; with none free, triggers wait in the TI.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "jvme.h"
+#include "rol.h"
+#include "tiLib.h"
+#include "dmaBankTools.h"
+#include "simLib.h"
+
+#ifndef MAX_EVENT_POOL
+#define MAX_EVENT_POOL   400
+#endif
+#ifndef MAX_EVENT_LENGTH
+#define MAX_EVENT_LENGTH 1024*10
+#endif
+
+#ifndef TI_READOUT
+#define TI_READOUT TI_READOUT_EXT_POLL
+#endif
+#ifndef TI_FLAG
+#define TI_FLAG 0
+#endif
+#ifndef TI_ADDR
+#define TI_ADDR 0
+#endif
+
+/* User routines */
+void rocDownload();
+void rocPrestart();
+void rocGo();
+void rocEnd();
+void rocTrigger(int arg);
+void rocLoad();
+void rocCleanup();
+
+static ROLPARAMS *rol;
+
+DMANODE *the_event;
+unsigned int *dma_dabufp;
+DMA_MEM_ID vmeIN, vmeOUT;
+
+int blockLevel = 1;
+int TIPRIMARYflag = 0;
+
+#define GETEVENT(inputQ, eventNumber)					\
+  {									\
+    the_event = dmaPGetItem(inputQ);					\
+    if(the_event == NULL)						\
+      {									\
+	printf("%s: ERROR: no event buffer available\n", __func__);	\
+	return;								\
+      }									\
+    dma_dabufp = (unsigned int *) &(the_event->data[0]);		\
+    the_event->nevent = eventNumber;					\
+  }
+
+#define PUTEVENT(outputQ)						\
+  {									\
+    the_event->length = ((char *)dma_dabufp -				\
+			 (char *)&(the_event->data[0]));		\
+    dmaPPutItem(outputQ, the_event);					\
+  }
+
+static void
+__download()
+{
+  dmaPartInit();
+  dmaPFreeAll();
+  vmeIN  = dmaPCreate("vmeIN", MAX_EVENT_LENGTH, MAX_EVENT_POOL, 0);
+  vmeOUT = dmaPCreate("vmeOUT", 0, 0, 0);
+  dmaPReInitAll();
+  dmaPStatsAll();
+
+  tiInit(TI_ADDR, TI_READOUT, TI_FLAG);
+
+  rocDownload();
+}
+
+static void
+__prestart()
+{
+  TIPRIMARYflag = 0;
+  dmaPReInitAll();
+
+  rocPrestart();
+}
+
+static void
+__go()
+{
+  rocGo();
+
+  TIPRIMARYflag = 1;
+  tiIntEnable(1);
+}
+
+static void
+__end()
+{
+  DMANODE *outEvent;
+
+  tiIntDisable();
+  TIPRIMARYflag = 0;
+
+  rocEnd();
+
+  /* Discard anything left over */
+  simEbFlush();
+  while((outEvent = dmaPGetItem(vmeOUT)) != NULL)
+    dmaPFreeItem(outEvent);
+
+  dmaPStatsAll();
+}
+
+static void
+__poll()
+{
+  unsigned long long t0, t1;
+
+  rol->poll = 0;
+
+  simEbDrain(vmeOUT);
+  if(dmaPEmpty(vmeIN))
+    return;
+
+  if(tiBReady() <= 0)
+    return;
+
+  t0 = simNow();
+  tiIntAck();
+
+  GETEVENT(vmeIN, tiGetIntCount());
+  rocTrigger(1);
+
+  t1 = simNow();
+
+  /* CODA output */
+  simEventOut(&(the_event->data[0]),
+	      ((char *)dma_dabufp - (char *)&(the_event->data[0])) >> 2,
+	      the_event->part->size >> 2, t0, t1);
+  PUTEVENT(vmeOUT);
+
+  rol->poll = 1;
+}
+
+void
+INIT_NAME(rolParam rolp)
+{
+  rol = rolp;
+
+  switch(rolp->daproc)
+    {
+    case DA_INIT_PROC:
+      rocLoad();
+      break;
+    case DA_DOWNLOAD_PROC:
+      __download();
+      break;
+    case DA_PRESTART_PROC:
+      __prestart();
+      break;
+    case DA_GO_PROC:
+      __go();
+      break;
+    case DA_END_PROC:
+      __end();
+      break;
+    case DA_POLL_PROC:
+      __poll();
+      break;
+    case DA_FREE_PROC:
+      rocCleanup();
+      break;
+    }
+}
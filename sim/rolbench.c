@@ -0,0 +1,302 @@
+/*************************************************************************
+ *
+ *  rolbench.c -
+ *
+ *   Offline benchmark driver for the readout lists, built against the
+ *   simulation backend (libsimvme).  For each readout list given, runs
+ *   the Download / Prestart / Go / Trigger... / End cycle and reports
+ *   the trigger rate, the data rate, and the per-module readout latency
+ *   percentiles.
+ *
+ *   Usage:
+ *     rolbench [options] list.so [list.so ...]
+ *       -n <blocks>     number of blocks to read out         (default 10000)
+ *       -t <seconds>    stop after this long                 (default 30)
+ *       -r <runs>       runs (Prestart ... End) per Download  (default 1)
+ *       -u <string>     rol->usrString                       (default "")
+ *       -s key=value    simulation parameter (repeatable)
+ *       -p              print the simulation parameters and exit
+ *       -v              show the readout list output
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <libgen.h>
+#include "rol.h"
+#include "simLib.h"
+
+#define MAX_PARAMS 64
+
+static int   nblocks_max = 10000;
+static double seconds_max = 30;
+static int   nruns = 1;
+static char *usrString = "";
+static char *params[MAX_PARAMS];
+static int   nparams = 0;
+static int   verbose = 0;
+static FILE *rep = NULL;
+
+static int
+cmpFloat(const void *a, const void *b)
+{
+  float fa = *(const float *)a, fb = *(const float *)b;
+  return (fa < fb) ? -1 : (fa > fb);
+}
+
+static void
+printPercentiles(const char *label, float *v, int n)
+{
+  float *s;
+
+  if(n <= 0)
+    return;
+
+  s = (float *)malloc(n * sizeof(float));
+  memcpy(s, v, n * sizeof(float));
+  qsort(s, n, sizeof(float), cmpFloat);
+
+  fprintf(rep, "    %-12s %8d %9.1f %9.1f %9.1f %9.1f\n", label, n,
+	  s[n / 2], s[(int)(0.9 * (n - 1))], s[(int)(0.99 * (n - 1))], s[n - 1]);
+
+  free(s);
+}
+
+static void
+transition(void (*init)(rolParam), ROLPARAMS *rolp, int daproc)
+{
+  rolp->daproc = daproc;
+  (*init)(rolp);
+}
+
+static int
+runList(const char *path)
+{
+  void *handle;
+  void (*init)(rolParam);
+  char sym[272], name[256], *p;
+  ROLPARAMS rolp;
+  int i, imod, irun, quiet_fd = -1, stdout_fd = -1;
+  unsigned long long t0, t1, nblocks, nevents, nbytes, nlost, noverrun;
+  unsigned long long tdownload, tprestart;
+  float *trig_us;
+  int ntrig;
+  double sec;
+
+  /* <name>.so -> <name>__init */
+  strncpy(name, path, sizeof(name) - 1);
+  name[sizeof(name) - 1] = 0;
+  p = basename(name);
+  memmove(name, p, strlen(p) + 1);
+  if((p = strstr(name, ".so")) != NULL)
+    *p = 0;
+  snprintf(sym, sizeof(sym), "%s__init", name);
+
+  simReset();
+  for(i = 0; i < nparams; i++)
+    if(simSetParam(params[i]) != 0)
+      return -1;
+
+  handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if(handle == NULL)
+    {
+      fprintf(stderr, "ERROR: %s\n", dlerror());
+      return -1;
+    }
+
+  init = (void (*)(rolParam)) dlsym(handle, sym);
+  if(init == NULL)
+    {
+      fprintf(stderr, "ERROR: %s not found in %s\n", sym, path);
+      dlclose(handle);
+      return -1;
+    }
+
+  memset(&rolp, 0, sizeof(rolp));
+  rolp.name      = name;
+  rolp.usrString = usrString;
+  rolp.runNumber = 1;
+  rolp.runType   = 0;
+
+  for(irun = 0; irun < nruns; irun++)
+    {
+      if(!verbose)
+	{
+	  fflush(stdout);
+	  stdout_fd = dup(1);
+	  quiet_fd = open("/dev/null", O_WRONLY);
+	  dup2(quiet_fd, 1);
+	}
+
+      t0 = simNow();
+      if(irun == 0)
+	{
+	  transition(init, &rolp, DA_INIT_PROC);
+	  transition(init, &rolp, DA_DOWNLOAD_PROC);
+	}
+      t1 = simNow();
+      tdownload = t1 - t0;
+      transition(init, &rolp, DA_PRESTART_PROC);
+      tprestart = simNow() - t1;
+      transition(init, &rolp, DA_GO_PROC);
+
+      t0 = simNow();
+      nblocks = 0;
+      while(nblocks < (unsigned long long) nblocks_max)
+	{
+	  transition(init, &rolp, DA_POLL_PROC);
+	  nblocks += rolp.poll;
+
+	  /* The TI stopped triggering (block limit) */
+	  if(!rolp.poll && simRunDone())
+	    break;
+
+	  if(((nblocks & 0xff) == 0 || !rolp.poll) &&
+	     (1e-9 * (simNow() - t0) > seconds_max))
+	    break;
+	}
+      t1 = simNow();
+
+      transition(init, &rolp, DA_END_PROC);
+      if(irun == nruns - 1)
+	transition(init, &rolp, DA_FREE_PROC);
+
+      if(!verbose)
+	{
+	  fflush(stdout);
+	  dup2(stdout_fd, 1);
+	  close(stdout_fd);
+	  close(quiet_fd);
+	}
+
+      fflush(stdout);
+      simGetRunStats(&nblocks, &nevents, &nbytes, &nlost, &noverrun, &trig_us, &ntrig);
+      sec = 1e-9 * (t1 - t0);
+
+      if(nruns > 1)
+	fprintf(rep, "\n=== %s (run %d) ===\n", name, rolp.runNumber);
+      else
+	fprintf(rep, "\n=== %s ===\n", name);
+      if(irun == 0)
+	fprintf(rep, "  Download : %.3f s\n", 1e-9 * tdownload);
+      fprintf(rep, "  Prestart : %.3f s\n", 1e-9 * tprestart);
+      fprintf(rep, "  Triggers : %llu blocks (%llu events) in %.3f s  ->  %.1f blocks/s,"
+	      " %.1f events/s\n", nblocks, nevents, sec, nblocks / sec, nevents / sec);
+      if(nlost)
+	fprintf(rep, "             %llu events lost to busy\n", nlost);
+      fprintf(rep, "  Data     : %.2f MB  ->  %.2f MB/s  (%.1f words/block)\n",
+	      1e-6 * nbytes, 1e-6 * nbytes / sec,
+	      (nblocks) ? (double) nbytes / 4. / nblocks : 0.);
+      if(noverrun)
+	fprintf(rep, "  ERROR    : %llu event buffer overruns\n", noverrun);
+
+      fprintf(rep, "  Latency (us)          n       p50       p90       p99       max\n");
+      printPercentiles("rocTrigger", trig_us, ntrig);
+      for(imod = 0; imod < SIM_NMOD; imod++)
+	{
+	  SIM_MODULE *m = &simModule[imod];
+	  char label[32];
+
+	  if(m->nlat == 0)
+	    continue;
+
+	  snprintf(label, sizeof(label), "%s done", m->name);
+	  printPercentiles(label, m->lat, m->nlat);
+	  snprintf(label, sizeof(label), "%s dma", m->name);
+	  printPercentiles(label, m->dma, m->nlat);
+	}
+
+      for(imod = 0; imod < SIM_NMOD; imod++)
+	{
+	  SIM_MODULE *m = &simModule[imod];
+
+	  if((m->nlat == 0) && (m->n_late + m->n_error + m->n_missing + m->n_slip == 0))
+	    continue;
+
+	  fprintf(rep, "  %-6s: %llu words in %llu read calls, %llu bus errors",
+		  m->name, m->nwords, m->nread_calls, m->nbuserr);
+	  if(m->n_late + m->n_error + m->n_missing + m->n_slip)
+	    fprintf(rep, "; injected: %u late, %u errors, %u missing, %u slips",
+		    m->n_late, m->n_error, m->n_missing, m->n_slip);
+	  fprintf(rep, "\n");
+	}
+      fflush(rep);
+
+      rolp.runNumber++;
+    }
+
+  dlclose(handle);
+
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int c, i, rval = 0;
+
+  rep = fdopen(dup(1), "w");
+
+  while((c = getopt(argc, argv, "n:t:r:u:s:pvh")) != -1)
+    {
+      switch(c)
+	{
+	case 'n':
+	  nblocks_max = atoi(optarg);
+	  break;
+	case 't':
+	  seconds_max = atof(optarg);
+	  break;
+	case 'r':
+	  nruns = (atoi(optarg) > 0) ? atoi(optarg) : 1;
+	  break;
+	case 'u':
+	  usrString = optarg;
+	  break;
+	case 's':
+	  if(nparams < MAX_PARAMS)
+	    params[nparams++] = optarg;
+	  break;
+	case 'p':
+	  simReset();
+	  for(i = 0; i < nparams; i++)
+	    simSetParam(params[i]);
+	  simPrintParams();
+	  return 0;
+	case 'v':
+	  verbose = 1;
+	  break;
+	default:
+	  fprintf(stderr,
+		  "Usage: %s [-n blocks] [-t seconds] [-r runs] [-u usrString] [-s key=value]... [-p] [-v]"
+		  " list.so [list.so ...]\n", argv[0]);
+	  return 1;
+	}
+    }
+
+  if(optind >= argc)
+    {
+      fprintf(stderr, "%s: no readout list given\n", argv[0]);
+      return 1;
+    }
+
+  for(i = optind; i < argc; i++)
+    {
+      char path[1024];
+
+      /* dlopen needs a path to look outside the library search path */
+      if(strchr(argv[i], '/') == NULL)
+	snprintf(path, sizeof(path), "./%s", argv[i]);
+      else
+	snprintf(path, sizeof(path), "%s", argv[i]);
+
+      if(runList(path) != 0)
+	rval = 1;
+    }
+
+  return rval;
+}
@@ -0,0 +1,220 @@
+/*************************************************************************
+ *
+ *  simFadc.c -
+ *
+ *   FADC250 stand-in.  All boards are read out together (token passing),
+ *   in raw window mode:
+ *     block header, then for each event: event header, 2 trigger time
+ *     words, and for each channel a window raw data header followed by
+ *     PTW/2 words of 2 samples.  A block trailer per board, and a filler
+ *     word to an even number of words.  Data are in VME (big endian)
+ *     byte order.
+ *
+ */
+
+#include <stdio.h>
+#include "jvme.h"
+#include "fadcLib.h"
+#include "simLib.h"
+
+int nfadc = 0;
+unsigned int fadcA32Base = 0x09000000;
+
+static int fadcSlot[FA_MAX_BOARDS];
+static unsigned int fadcMask = 0;
+static int fadcBlockLevel = 1;
+
+#define FA_WORD(x) LSWAP((unsigned int)(x))
+
+/* Pulse window and pulses, as given by faGetProcMode */
+#define FADC_SIM_NSB 2
+#define FADC_SIM_NSA 10
+#define FADC_SIM_NP  4
+
+int
+faInit(unsigned int addr, unsigned int addr_inc, int nadc, int iFlag)
+{
+  int i, n = (int) simConfig.fadc_n;
+
+  if(n > nadc) n = nadc;
+  if(n > FA_MAX_BOARDS) n = FA_MAX_BOARDS;
+
+  nfadc = n;
+  fadcMask = 0;
+  for(i = 0; i < nfadc; i++)
+    {
+      fadcSlot[i] = (addr >> 19) + i * (addr_inc >> 19);
+      fadcMask |= (1 << fadcSlot[i]);
+      simSleep(10);
+    }
+
+  printf("%s: %d simulated FADC250(s), slot mask 0x%08x\n", __func__, nfadc, fadcMask);
+  return OK;
+}
+
+int faSlot(unsigned int i) { return (i < (unsigned int)nfadc) ? fadcSlot[i] : ERROR; }
+unsigned int faScanMask() { return fadcMask; }
+void faGStatus(int sflag) { printf("FADC250 (sim): %d boards, blocklevel %d\n", nfadc, fadcBlockLevel); }
+void faEnableBusError(int id) { }
+void faDisableMultiBlock() { }
+void faEnableMultiBlock(int tflag) { }
+int  faResetMGT(int id, int reset) { return OK; }
+int  faSetTrigOut(int id, int trigout) { return OK; }
+int  faSetTriggerBusyCondition(int id, int nbusy) { return OK; }
+void faSoftReset(int id, int cflag) { simVmeWrite(); }
+void faResetToken(int id) { simVmeWrite(); }
+void faResetTriggerCount(int id) { simVmeWrite(); }
+void faEnableSyncReset(int id) { simVmeWrite(); }
+void faGSetBlockLevel(int level) { fadcBlockLevel = level; }
+void faGEnable(int eflag, int bank) { simModuleActivate(SIM_FADC, 1); }
+void faGDisable(int eflag) { simModuleActivate(SIM_FADC, 0); }
+void faGReset(int reset) { }
+unsigned int faGetA32(int id) { return fadcA32Base; }
+
+int
+faGetProcMode(int id, int *pmode, unsigned int *PL, unsigned int *PTW,
+	      unsigned int *NSB, unsigned int *NSA, unsigned int *NP)
+{
+  simVmeRead();
+  *pmode = (int) simConfig.fadc_mode;
+  *PL    = 100;
+  *PTW   = (unsigned int) simConfig.fadc_ptw;
+  *NSB   = FADC_SIM_NSB;
+  *NSA   = FADC_SIM_NSA;
+  *NP    = FADC_SIM_NP;
+  return OK;
+}
+
+unsigned int
+faGetChannelMask(int id)
+{
+  int nch = (int) simConfig.fadc_nch;
+
+  simVmeRead();
+  return (nch >= 16) ? 0xFFFF : ((1 << nch) - 1);
+}
+
+void
+simGenFadc(SIM_BLOCK *blk, int slot)
+{
+  int ifa, iev, ich, is, ip, ptw = (int) simConfig.fadc_ptw;
+  int nch = (int) simConfig.fadc_nch;
+  int mode = (int) simConfig.fadc_mode, npulse = (int) simConfig.fadc_npulse;
+  int nps = FADC_SIM_NSB + FADC_SIM_NSA;
+  int chw, maxw;
+  unsigned int *d, *start, bnum = blk->evnum;
+
+  if(npulse > FADC_SIM_NP) npulse = FADC_SIM_NP;
+  if(npulse < 0) npulse = 0;
+  chw = (mode == 2) ? npulse * (1 + (nps + 1) / 2) : 1 + (ptw + 1) / 2;
+  maxw = nfadc * (2 + blk->nevents * (3 + nch * chw)) + 2;
+
+  simBlockAlloc(blk, maxw);
+  d = blk->data;
+
+  for(ifa = 0; ifa < nfadc; ifa++)
+    {
+      start = d;
+      slot = fadcSlot[ifa];
+      *d++ = FA_WORD((1u<<31) | (0 << 27) | (slot << 22) | ((bnum & 0x3FF) << 8) |
+		     (blk->nevents & 0xFF));
+      for(iev = 0; iev < blk->nevents; iev++)
+	{
+	  unsigned long long ts = blk->ts + iev;
+	  *d++ = FA_WORD((1u<<31) | (2 << 27) | (slot << 22) | ((blk->evnum + iev) & 0x3FFFFF));
+	  *d++ = FA_WORD((1u<<31) | (3 << 27) | (ts & 0xFFFFFF));
+	  *d++ = FA_WORD((ts >> 24) & 0xFFFFFF);
+	  for(ich = 0; ich < nch; ich++)
+	    {
+	      int base = 100 + 10 * ich;
+
+	      if(mode == 2)
+		{
+		  /* pulse raw: header (channel, pulse, first sample), samples */
+		  for(ip = 0; ip < npulse; ip++)
+		    {
+		      *d++ = FA_WORD((1u<<31) | (6 << 27) | (ich << 23) | (ip << 21) |
+				     (10 + 8 * ip));
+		      for(is = 0; is < nps; is += 2)
+			{
+			  unsigned int s0 = base + 50 + (int)(2. * simGauss());
+			  unsigned int s1 = base + 50 + (int)(2. * simGauss());
+			  *d++ = FA_WORD(((s0 & 0x1FFF) << 16) | (s1 & 0x1FFF));
+			}
+		    }
+		  continue;
+		}
+
+	      *d++ = FA_WORD((1u<<31) | (4 << 27) | (ich << 23) | ptw);
+	      for(is = 0; is < ptw; is += 2)
+		{
+		  unsigned int s0 = base + (int)(2. * simGauss());
+		  unsigned int s1 = base + (int)(2. * simGauss());
+		  *d++ = FA_WORD(((s0 & 0x1FFF) << 16) | (s1 & 0x1FFF));
+		}
+	    }
+	}
+      *d = FA_WORD((1u<<31) | (1 << 27) | (slot << 22) | ((d - start + 1) & 0x3FFFFF));
+      d++;
+    }
+
+  if((d - blk->data) & 1)
+    *d++ = FA_WORD(0xF8000000);
+
+  blk->nwords = d - blk->data;
+
+  if(blk->flags & SIM_BLK_ERROR)
+    blk->nwords /= 2;
+}
+
+unsigned int
+faGBlockReady(unsigned int slotmask, int nloop)
+{
+  int iloop;
+
+  for(iloop = 0; iloop < nloop; iloop++)
+    {
+      simVmeRead();
+      if(simReadyBlock(SIM_FADC))
+	return slotmask & fadcMask;
+    }
+
+  return 0;
+}
+
+int
+faBready(int id)
+{
+  simVmeRead();
+  return simReadyCount(SIM_FADC);
+}
+
+int
+faReadBlock(int id, volatile unsigned int *data, int nwrds, int rflag)
+{
+  SIM_MODULE *m = &simModule[SIM_FADC];
+  SIM_BLOCK *blk;
+  int nread;
+
+  blk = simReadyBlock(SIM_FADC);
+  m->last_error = (blk && (blk->flags & SIM_BLK_ERROR)) ? 1 : 0;
+
+  simBlockRead(SIM_FADC, blk, data, nwrds, &nread);
+
+  return nread;
+}
+
+int
+faGetBlockError(int pflag)
+{
+  int err = simModule[SIM_FADC].last_error;
+
+  simModule[SIM_FADC].last_error = 0;
+  return err;
+}
+
+int
+fadc250Config(char *fname)
+{
+  return OK;
+}
@@ -0,0 +1,712 @@
+/*************************************************************************
+ *
+ *  simSsp.c -
+ *
+ *   SSP, SSP-MPD fiber and MPD library stand-ins.
+ *
+ *   An SSP slot is an MPD SSP once any sspMpd* routine is called for it.
+ *   The other SSP produces MAROC data once its configuration is loaded
+ *   (sspConfig).
+ *
+ *   SSP-MPD block format (VME byte order):
+ *     block header, then for each event: event header, 2 trigger time
+ *     words, and for each MPD a frame header (tag 5, fiber and rotary)
+ *     followed by 3 words per APV channel (6 13-bit samples, channel
+ *     and APV number in bits 30-26).  Block trailer, filler word to an
+ *     even number of words.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "jvme.h"
+#include "sspLib.h"
+#include "sspLib_mpd.h"
+#include "sspConfig.h"
+#include "sspMpdConfig.h"
+#include "mpdLib.h"
+#include "simLib.h"
+
+int nSSP = 0;
+unsigned int sspA32Base = 0x08800000;
+unsigned int sspAddrList[MAX_VME_SLOTS+1];
+volatile SSP_regs *pSSP[MAX_VME_SLOTS+1];
+volatile SSP_MPD_regs *pMPD[MAX_VME_SLOTS+1];
+int sspSL[MAX_VME_SLOTS+1];
+
+volatile struct mpd_struct *MPDp[(MPD_MAX_BOARDS+1)];
+
+static int sspMpdSlotId = -1;
+static int sspMarocConfigured = 0;
+static unsigned int sspFiberEnabled = 0;
+
+/* Event builder settings */
+static int ebBuildAllSamples = 1, ebEnableCm = 0;
+static short apvOffset[SSP_MAX_FIBERS][MPD_MAX_APV][128];
+static short apvThreshold[SSP_MAX_FIBERS][MPD_MAX_APV][128];
+
+static int nmpd = 0;
+static int mpdTrigEnabled = 0;
+static unsigned int mpdSoftErr[SSP_MAX_FIBERS];
+static unsigned long long mpdSoftTime = 0;
+static double mpdSoftAcc = 0;
+static int mpdHang = 0;         /* output hung (mpd_hang_level), 0: no */
+
+#define SSP_WORD(x) LSWAP((unsigned int)(x))
+
+/* Fast noise for data generation */
+static float simNoise[8192];
+static int simNoiseInit = 0;
+static uint32_t simNoiseState = 0x12345678;
+
+static inline float
+simNoiseNext()
+{
+  simNoiseState ^= simNoiseState << 13;
+  simNoiseState ^= simNoiseState >> 17;
+  simNoiseState ^= simNoiseState << 5;
+  return simNoise[simNoiseState & 8191];
+}
+
+static int
+sspModule(int id)
+{
+  return (id == sspMpdSlotId) ? SIM_MPD : SIM_MAROC;
+}
+
+static void
+sspMarkMpd(int id)
+{
+  if(id == 0)
+    id = sspSL[0];
+  sspMpdSlotId = id;
+}
+
+/****************************************
+ *  SSP
+ ****************************************/
+
+int
+sspInit(unsigned int addr, unsigned int addr_inc, int nfind, int iFlag)
+{
+  int i, slot;
+
+  nSSP = 0;
+  for(i = 0; i < nfind; i++)
+    {
+      if(iFlag & SSP_INIT_USE_ADDRLIST)
+	slot = sspAddrList[i] >> 19;
+      else
+	slot = (addr >> 19) + i * (addr_inc >> 19);
+
+      if((slot <= 0) || (slot > MAX_VME_SLOTS))
+	continue;
+
+      if(pSSP[slot] == NULL)
+	pSSP[slot] = (volatile SSP_regs *)calloc(1, sizeof(SSP_MPD_regs));
+      sspSL[nSSP++] = slot;
+      simSleep(20);
+    }
+
+  return nSSP;
+}
+
+unsigned int
+sspSlotMask()
+{
+  unsigned int i, mask = 0;
+
+  for(i = 0; i < (unsigned int)nSSP; i++)
+    mask |= (1 << sspSL[i]);
+
+  return mask;
+}
+
+int sspSlot(unsigned int i) { return (i < (unsigned int)nSSP) ? sspSL[i] : ERROR; }
+void sspInitGlobals() { }
+int sspSetBlockLevel(int id, int level) { simVmeWrite(); return OK; }
+int sspEnableBusError(int id) { sspMarkMpd(id); return OK; }
+int sspSoftReset(int id) { simSleep(1); return OK; }
+int sspMigReset(int id, int en) { simSleep(1); return OK; }
+
+int
+sspConfig(char *fname)
+{
+  sspMarocConfigured = 1;
+  simModuleActivate(SIM_MAROC, 1);
+  return OK;
+}
+
+int
+sspStatus(int id, int rflag)
+{
+  printf("SSP (sim) slot %d: %s\n", id,
+	 (sspModule(id) == SIM_MPD) ? "MPD" : "MAROC");
+  return OK;
+}
+
+void
+sspGStatus(int rflag)
+{
+  int i;
+  for(i = 0; i < nSSP; i++)
+    sspStatus(sspSL[i], rflag);
+}
+
+int
+sspBReady(int id)
+{
+  simVmeRead();
+  return simReadyCount(sspModule(id));
+}
+
+int
+sspGetEbStatus(int id, unsigned int *blockcnt, unsigned int *wordcnt,
+	       unsigned int *eventcnt)
+{
+  int mod = sspModule(id), i, n;
+  SIM_MODULE *m = &simModule[mod];
+
+  simVmeRead();
+  simVmeRead();
+  simVmeRead();
+
+  n = simReadyCount(mod);
+  *blockcnt = n;
+  *wordcnt = 0;
+  *eventcnt = 0;
+  for(i = 0; i < n; i++)
+    {
+      SIM_BLOCK *blk = &m->ring[(m->head + i) % SIM_RING];
+      if(blk->nwords < 0)
+	simGenerate(mod, blk);
+      *wordcnt  += blk->nwords - blk->offset;
+      *eventcnt += blk->nevents;
+    }
+
+  /* Counter read while the last block is still being written */
+  if((n > 0) && (simRand() < simConfig.ssp_eb_stale))
+    *wordcnt = (unsigned int)(*wordcnt * simRand()) & ~1;
+
+  return OK;
+}
+
+int
+sspPrintEbStatus(int id)
+{
+  unsigned int bc, wc, ec;
+
+  sspGetEbStatus(id, &bc, &wc, &ec);
+  printf("SSP %2d : Block Count = %d, Word Count = %d, Event Count = %d\n",
+	 id, bc, wc, ec);
+  return OK;
+}
+
+int
+sspReadBlock(int id, volatile unsigned int *data, int nwrds, int rflag)
+{
+  int mod = sspModule(id), nread;
+
+  simBlockRead(mod, simReadyBlock(mod), data, nwrds, &nread);
+
+  return nread;
+}
+
+/****************************************
+ *  SSP MPD FIBERS
+ ****************************************/
+
+int
+sspMpdConfigInit(char *fname)
+{
+  return OK;
+}
+
+int
+sspMpdConfigLoad()
+{
+  return OK;
+}
+
+/* Links of the fibers up again, soft errors cleared, and a hang that a
+   fiber reset clears */
+static void
+sspMpdLinkUp(int id, unsigned int fibermask)
+{
+  int ifiber;
+
+  for(ifiber = 0; ifiber < SSP_MAX_FIBERS; ifiber++)
+    {
+      if(((fibermask & sspFiberEnabled) & (1 << ifiber)) && pSSP[id])
+	{
+	  pMPD[id] = (volatile SSP_MPD_regs *)pSSP[id];
+	  pMPD[id]->MPD[ifiber].Status = MPD_STATUS_CHANNELUP;
+	  mpdSoftErr[ifiber] = 0;
+	}
+    }
+  if(mpdHang <= 2)
+    mpdHang = 0;
+}
+
+int
+sspMpdFiberReset(int id)
+{
+  sspMarkMpd(id);
+  simSleep(1);
+  sspMpdLinkUp(sspMpdSlotId, 0xFFFFFFFF);
+  return OK;
+}
+
+int
+sspMpdFiberLinkReset(int id, unsigned int fibermask)
+{
+  sspMarkMpd(id);
+  simSleep(1);
+  sspMpdLinkUp(sspMpdSlotId, fibermask);
+  return OK;
+}
+
+int
+sspMpdEnable(int id, unsigned int fibermask)
+{
+  int ifiber;
+
+  sspMarkMpd(id);
+  sspFiberEnabled |= fibermask;
+  for(ifiber = 0; ifiber < SSP_MAX_FIBERS; ifiber++)
+    {
+      if(fibermask & (1 << ifiber))
+	{
+	  pMPD[id] = (volatile SSP_MPD_regs *)pSSP[id];
+	  pMPD[id]->MPD[ifiber].Status = MPD_STATUS_CHANNELUP;
+	  pMPD[id]->MPD[ifiber].EBCtrl = MPD_EBCTRL_ENABLE;
+	  mpdSoftErr[ifiber] = 0;
+	}
+    }
+  mpdSoftTime = 0;
+  mpdSoftAcc = 0;
+  simVmeWrite();
+  return OK;
+}
+
+int
+sspMpdDisable(int id, unsigned int fibermask)
+{
+  int ifiber;
+
+  sspMarkMpd(id);
+  sspFiberEnabled &= ~fibermask;
+  for(ifiber = 0; ifiber < SSP_MAX_FIBERS; ifiber++)
+    {
+      if((fibermask & (1 << ifiber)) && pSSP[id])
+	{
+	  pMPD[id] = (volatile SSP_MPD_regs *)pSSP[id];
+	  pMPD[id]->MPD[ifiber].EBCtrl = 0;
+	}
+    }
+  simVmeWrite();
+  return OK;
+}
+
+int
+sspMpdEbSetFlags(int id, int build_all_samples, int build_debug_headers,
+		 int enable_cm, int noprocessing_prescale)
+{
+  sspMarkMpd(id);
+  ebBuildAllSamples = build_all_samples;
+  ebEnableCm = enable_cm;
+  simVmeWrite();
+  return OK;
+}
+
+int
+sspMpdSetApvOffset(int id, int mpd, int apv, int ch, int val)
+{
+  if((mpd < 0) || (mpd >= SSP_MAX_FIBERS) || (apv < 0) || (apv >= MPD_MAX_APV) ||
+     (ch < 0) || (ch >= 128))
+    return ERROR;
+
+  simVmeWrite();
+  apvOffset[mpd][apv][ch] = val;
+  return OK;
+}
+
+int
+sspMpdGetApvOffset(int id, int mpd, int apv, int ch)
+{
+  if((mpd < 0) || (mpd >= SSP_MAX_FIBERS) || (apv < 0) || (apv >= MPD_MAX_APV) ||
+     (ch < 0) || (ch >= 128))
+    return ERROR;
+
+  simVmeRead();
+  return apvOffset[mpd][apv][ch];
+}
+
+int
+sspMpdSetApvThreshold(int id, int mpd, int apv, int ch, int val)
+{
+  if((mpd < 0) || (mpd >= SSP_MAX_FIBERS) || (apv < 0) || (apv >= MPD_MAX_APV) ||
+     (ch < 0) || (ch >= 128))
+    return ERROR;
+
+  simVmeWrite();
+  apvThreshold[mpd][apv][ch] = val;
+  return OK;
+}
+
+int
+sspMpdGetApvThreshold(int id, int mpd, int apv, int ch)
+{
+  if((mpd < 0) || (mpd >= SSP_MAX_FIBERS) || (apv < 0) || (apv >= MPD_MAX_APV) ||
+     (ch < 0) || (ch >= 128))
+    return ERROR;
+
+  simVmeRead();
+  return apvThreshold[mpd][apv][ch];
+}
+
+int
+sspMpdSetAvg(int id, int mpd, int apv, int avg_min, int avg_max)
+{
+  simVmeWrite();
+  simVmeWrite();
+  return OK;
+}
+
+int
+sspMpdPrintStatus(int id)
+{
+  int ifiber;
+
+  printf("SSP-MPD (sim) slot %d: fibers enabled 0x%08x\n", id, sspFiberEnabled);
+  for(ifiber = 0; ifiber < nmpd; ifiber++)
+    printf("  fiber %2d: %s  soft errors %d\n", ifiber,
+	   (sspFiberEnabled & (1 << ifiber)) ? "UP" : "--", mpdSoftErr[ifiber]);
+  return OK;
+}
+
+/* Soft errors on fiber 0 at mpd_soft_rate, its link down after mpd_soft_down */
+static void
+mpdSoftUpdate(int id)
+{
+  unsigned long long now = simNow();
+  int n;
+
+  if(mpdSoftTime && (simConfig.mpd_soft_rate > 0) && pSSP[id])
+    {
+      mpdSoftAcc += simConfig.mpd_soft_rate * 1e-9 * (now - mpdSoftTime);
+      n = (int) mpdSoftAcc;
+      mpdSoftAcc -= n;
+      mpdSoftErr[0] += n;
+
+      pMPD[id] = (volatile SSP_MPD_regs *)pSSP[id];
+      pMPD[id]->MPD[0].Status = (pMPD[id]->MPD[0].Status & ~MPD_STATUS_SOFTERRORS) |
+	(((mpdSoftErr[0] > 15) ? 15 : mpdSoftErr[0]) << 8);
+      if((simConfig.mpd_soft_down > 0) && (mpdSoftErr[0] >= simConfig.mpd_soft_down))
+	pMPD[id]->MPD[0].Status &= ~MPD_STATUS_CHANNELUP;
+    }
+  mpdSoftTime = now;
+}
+
+int
+sspMpdGetSoftErrorCount(int id, int fiber)
+{
+  simVmeRead();
+  if((fiber < 0) || (fiber >= SSP_MAX_FIBERS))
+    return ERROR;
+  mpdSoftUpdate(id);
+  return mpdSoftErr[fiber];
+}
+
+/* No more MPD blocks: the output is hung (mpd_hang, until cleared as
+   mpd_hang_level says), or the link of fiber 0 is down */
+int
+simMpdHung()
+{
+  int id = sspMpdSlotId;
+
+  if(!mpdHang && (simConfig.mpd_hang > 0) && (simRand() < simConfig.mpd_hang))
+    mpdHang = (simConfig.mpd_hang_level < 2) ? 2 : (int) simConfig.mpd_hang_level;
+
+  if(mpdHang)
+    return 1;
+
+  return ((simConfig.mpd_soft_down > 0) && (id > 0) && pSSP[id] &&
+	  !(((volatile SSP_MPD_regs *)pSSP[id])->MPD[0].Status & MPD_STATUS_CHANNELUP));
+}
+
+static int
+simMpdPedestal(int fiber, int apv, int ch)
+{
+  return 500 + ((fiber * 131 + apv * 17 + ch * 7) % 300);
+}
+
+void
+simGenMpd(SIM_BLOCK *blk, int slot)
+{
+  static const float shape[6] = {0.1, 0.5, 0.9, 1.0, 0.8, 0.5};
+  int iev, ifiber, iapv, ich, is, napv = (int) simConfig.mpd_napv;
+  int maxw;
+  unsigned int *d;
+  int s[6], keep;
+  float cm[6], noise = simConfig.mpd_noise;
+  double hit = simConfig.mpd_hit_prob;
+
+  if(!simNoiseInit)
+    {
+      for(is = 0; is < 8192; is++)
+	simNoise[is] = simGauss();
+      simNoiseInit = 1;
+    }
+
+  if(napv > MPD_MAX_APV) napv = MPD_MAX_APV;
+  maxw = 4 + blk->nevents * (3 + nmpd * (1 + napv * 128 * 3));
+  simBlockAlloc(blk, maxw);
+  d = blk->data;
+  slot = sspMpdSlotId;
+
+  *d++ = SSP_WORD((1u<<31) | (0 << 27) | (slot << 22) | ((blk->evnum & 0x3FF) << 8) |
+		  (blk->nevents & 0xFF));
+  for(iev = 0; iev < blk->nevents; iev++)
+    {
+      unsigned long long ts = blk->ts + iev;
+      *d++ = SSP_WORD((1u<<31) | (2 << 27) | ((blk->evnum + iev) & 0x3FFFFF));
+      *d++ = SSP_WORD((1u<<31) | (3 << 27) | (ts & 0xFFFFFF));
+      *d++ = SSP_WORD((ts >> 24) & 0xFFFFFF);
+
+      for(ifiber = 0; ifiber < nmpd; ifiber++)
+	{
+	  if((sspFiberEnabled & (1 << ifiber)) == 0)
+	    continue;
+
+	  *d++ = SSP_WORD((1u<<31) | (5 << 27) | (ifiber << 16) | ifiber);
+
+	  for(iapv = 0; iapv < napv; iapv++)
+	    {
+	      for(is = 0; is < 6; is++)
+		cm[is] = simConfig.mpd_cm_rms * simNoiseNext();
+
+	      for(ich = 0; ich < 128; ich++)
+		{
+		  int ped = simMpdPedestal(ifiber, iapv, ich);
+		  float amp = 0, avg = 0;
+
+		  if(simRand() < hit)
+		    amp = 200. + 1000. * simRand();
+
+		  for(is = 0; is < 6; is++)
+		    {
+		      float v = ped + cm[is] + noise * simNoiseNext() + amp * shape[is];
+		      v -= apvOffset[ifiber][iapv][ich];
+		      if(ebEnableCm)
+			v -= cm[is];
+		      s[is] = (int) v;
+		      avg += v;
+		    }
+
+		  keep = ebBuildAllSamples ||
+		    ((avg / 6.) > apvThreshold[ifiber][iapv][ich]);
+		  if(!keep)
+		    continue;
+
+		  *d++ = SSP_WORD(((ich & 0x1F) << 26) | ((s[1] & 0x1FFF) << 13) |
+				  (s[0] & 0x1FFF));
+		  *d++ = SSP_WORD((((ich >> 5) & 0x3) << 26) | ((s[3] & 0x1FFF) << 13) |
+				  (s[2] & 0x1FFF));
+		  *d++ = SSP_WORD(((iapv & 0x1F) << 26) | ((s[5] & 0x1FFF) << 13) |
+				  (s[4] & 0x1FFF));
+		}
+	    }
+	}
+    }
+
+  *d = SSP_WORD((1u<<31) | (1 << 27) | (slot << 22) | ((d - blk->data + 1) & 0x3FFFFF));
+  d++;
+  if((d - blk->data) & 1)
+    *d++ = SSP_WORD(0xF8000000);
+
+  blk->nwords = d - blk->data;
+  if(blk->flags & SIM_BLK_ERROR)
+    blk->nwords /= 2;
+}
+
+void
+simGenMaroc(SIM_BLOCK *blk, int slot)
+{
+  int iev, iw, nw = (int) simConfig.maroc_words;
+  unsigned int *d;
+
+  simBlockAlloc(blk, 4 + blk->nevents * (3 + nw));
+  d = blk->data;
+
+  *d++ = SSP_WORD((1u<<31) | (0 << 27) | (slot << 22) | ((blk->evnum & 0x3FF) << 8) |
+		  (blk->nevents & 0xFF));
+  for(iev = 0; iev < blk->nevents; iev++)
+    {
+      unsigned long long ts = blk->ts + iev;
+      *d++ = SSP_WORD((1u<<31) | (2 << 27) | ((blk->evnum + iev) & 0x3FFFFF));
+      *d++ = SSP_WORD((1u<<31) | (3 << 27) | (ts & 0xFFFFFF));
+      *d++ = SSP_WORD((ts >> 24) & 0xFFFFFF);
+      for(iw = 0; iw < nw; iw++)
+	*d++ = SSP_WORD((1u<<31) | (8 << 27) | ((unsigned int)(simRand() * 0x7FFFFFF)));
+    }
+  *d = SSP_WORD((1u<<31) | (1 << 27) | (slot << 22) | ((d - blk->data + 1) & 0x3FFFFF));
+  d++;
+  if((d - blk->data) & 1)
+    *d++ = SSP_WORD(0xF8000000);
+
+  blk->nwords = d - blk->data;
+}
+
+/****************************************
+ *  MPD
+ ****************************************/
+
+static void
+mpdRefresh(int id)
+{
+  SIM_MODULE *m = &simModule[SIM_MPD];
+  volatile struct output_buffer_struct *ob = &MPDp[id]->ob_status;
+
+  ob->block_count      = m->count;
+  ob->event_count      = m->blocknum;
+  ob->trigger_count    = m->blocknum;
+  ob->incoming_trigger = m->blocknum;
+  ob->missed_trigger   = m->n_missing;
+}
+
+uint32_t
+mpdRead32(volatile uint32_t *reg)
+{
+  int id;
+
+  simSpin(simConfig.mpd_read_us);
+
+  for(id = 0; id < nmpd; id++)
+    {
+      if(((char *)reg >= (char *)MPDp[id]) &&
+	 ((char *)reg < (char *)MPDp[id] + sizeof(struct mpd_struct)))
+	{
+	  mpdRefresh(id);
+	  break;
+	}
+    }
+
+  return *reg;
+}
+
+void
+mpdWrite32(volatile uint32_t *reg, uint32_t value)
+{
+  simSpin(simConfig.mpd_read_us);
+  *reg = value;
+}
+
+int
+mpdInit(uint32_t rotary_addr, uint32_t addr_inc, int nfind, int iFlag)
+{
+  int i;
+
+  nmpd = (int) simConfig.mpd_nfiber;
+  if(nmpd > MPD_MAX_BOARDS) nmpd = MPD_MAX_BOARDS;
+
+  for(i = 0; i < nmpd; i++)
+    {
+      if(MPDp[i] == NULL)
+	MPDp[i] = (volatile struct mpd_struct *)calloc(1, sizeof(struct mpd_struct));
+    }
+
+  printf("%s: %d simulated MPD(s)\n", __func__, nmpd);
+  return OK;
+}
+
+int mpdGetNumberMPD() { return nmpd; }
+int mpdSlot(uint32_t i) { return (i < (uint32_t)nmpd) ? (int)i : ERROR; }
+void mpdSetPrintDebug(int b) { }
+
+uint32_t
+mpdGetSSPFiberMask(int ssp_slot)
+{
+  int n = (int) simConfig.mpd_nfiber;
+  return (n >= 32) ? 0xFFFFFFFF : ((1u << n) - 1);
+}
+
+int mpdHISTO_MemTest(int id) { simSleep(250); return OK; }
+int mpdI2C_Init(int id) { simSleep(20); return OK; }
+int I2C_SendStop(int id) { simSleep(0.1); return OK; }
+int mpdI2C_ApvReset(int id) { simSleep(10); return OK; }
+int mpdAPV_Scan(int id) { simSleep(40); return (int) simConfig.mpd_napv; }
+int mpdAPV_Config(int id, int apv_index) { simSleep(8); return OK; }
+static unsigned long long mpdReset101[MPD_MAX_BOARDS+1];
+
+int
+mpdAPV_Reset101(int id)
+{
+  simSleep(2);
+  if((id >= 0) && (id <= MPD_MAX_BOARDS))
+    mpdReset101[id] = simNow();
+  if(mpdHang <= 3)
+    mpdHang = 0;
+  return OK;
+}
+
+/* APV frames in sync, some time after the 101 reset (init delay, scaled) */
+int
+mpdFIFO_IsSynced(int id, int channel)
+{
+  simVmeRead();
+  if((id < 0) || (id > MPD_MAX_BOARDS))
+    return 0;
+  return ((simNow() - mpdReset101[id]) >=
+	  1e6 * simConfig.mpd_settle_ms * simConfig.init_scale);
+}
+int mpdGetNumberAPV(int id) { return (int) simConfig.mpd_napv; }
+
+uint16_t
+mpdGetApvEnableMask(int id)
+{
+  int n = (int) simConfig.mpd_napv;
+  return (n >= 16) ? 0xFFFF : ((1 << n) - 1);
+}
+
+int mpdDELAY25_Set(int id, int adc0_delay, int adc1_delay) { simSleep(2); return OK; }
+int mpdGetAdcClockPhase(int id, int adc) { return 10; }
+int mpdADS5281_Config(int id) { simSleep(10); return OK; }
+int mpdGetUseSdram(int id) { return 1; }
+int mpdGetFastReadout(int id) { return 1; }
+int mpdSetAcqMode(int id, char *name) { simSpin(10 * simConfig.mpd_read_us); return OK; }
+int mpdPEDTHR_Write(int id) { simSleep(5); return OK; }
+int mpdDAQ_Enable(int id) { simSpin(simConfig.mpd_read_us); return OK; }
+int mpdDAQ_Disable(int id) { simSpin(simConfig.mpd_read_us); return OK; }
+
+int
+mpdTRIG_Enable(int id)
+{
+  simSpin(simConfig.mpd_read_us);
+  mpdTrigEnabled |= (1 << id);
+  mpdHang = 0;
+  simModuleActivate(SIM_MPD, 1);
+  return OK;
+}
+
+int
+mpdTRIG_Disable(int id)
+{
+  simSpin(simConfig.mpd_read_us);
+  mpdTrigEnabled &= ~(1 << id);
+  if(mpdTrigEnabled == 0)
+    simModuleActivate(SIM_MPD, 0);
+  return OK;
+}
+
+void
+mpdGStatus(int statusFlag)
+{
+  int i;
+
+  for(i = 0; i < nmpd; i++)
+    printf("MPD (sim) %2d: APV mask 0x%04x  trigger %s\n", i,
+	   mpdGetApvEnableMask(i), (mpdTrigEnabled & (1 << i)) ? "enabled" : "disabled");
+}
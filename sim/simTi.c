@@ -0,0 +1,253 @@
+/*************************************************************************
+ *
+ *  simTi.c -
+ *
+ *   Trigger Interface and Signal Distribution stand-ins.
+ *
+ *   The trigger block (tiReadTriggerBlock) is a bank, already in host
+ *   byte order:
+ *     0: bank length
+ *     1: 0xFF11 | 0x20 (segments) | blocklevel
+ *     then for each event
+ *        (event type << 24) | (0x01 << 16) | 3
+ *        event number
+ *        timestamp bits 31-0
+ *        timestamp bits 47-32
+ *
+ */
+
+#include <stdio.h>
+#include "jvme.h"
+#include "tiLib.h"
+#include "sdLib.h"
+#include "simLib.h"
+
+static int tiBlockLevel = 1;
+static int tiBufferLevel = 1;
+static int tiSyncInterval = 0;
+static int tiSyncFlag = 0;
+static unsigned int tiIntCount = 0;
+static int tiTriggerSource = TI_TRIGGER_TSINPUTS;
+static int tiPulserOn = 0;
+static unsigned int tiTSInputMask = 0;
+static int tiPrescale[7];
+
+int
+simBlockLevel()
+{
+  return tiBlockLevel;
+}
+
+int
+simPulserOn()
+{
+  return tiPulserOn;
+}
+
+void
+simGenTi(SIM_BLOCK *blk, int slot)
+{
+  int iev, nw = 2 + 4 * blk->nevents;
+  unsigned int *d;
+  unsigned long long ts;
+
+  simBlockAlloc(blk, nw);
+  d = blk->data;
+
+  *d++ = nw - 1;
+  *d++ = (0xFF11 << 16) | (0x20 << 8) | (blk->nevents & 0xff);
+  for(iev = 0; iev < blk->nevents; iev++)
+    {
+      ts = blk->ts + iev;
+      *d++ = (blk->evtype[iev] << 24) | (0x01 << 16) | 3;
+      *d++ = blk->evnum + iev;
+      *d++ = (unsigned int)(ts & 0xFFFFFFFF);
+      *d++ = (unsigned int)((ts >> 32) & 0xFFFF);
+    }
+
+  blk->nwords = nw;
+}
+
+int
+tiInit(unsigned int tAddr, unsigned int mode, int force)
+{
+  printf("%s: Simulated TI (mode %d)\n", __func__, mode);
+  return OK;
+}
+
+int
+tiStatus(int pflag)
+{
+  printf("TI (sim): blocklevel %d  bufferlevel %d  sync interval %d  "
+	 "blocks read %d\n",
+	 tiBlockLevel, tiBufferLevel, tiSyncInterval, tiIntCount);
+  return OK;
+}
+
+int tiSetTriggerSource(int trig) { tiTriggerSource = trig; return OK; }
+int tiSetTriggerSourceMask(int trigmask) { return OK; }
+int tiEnableTSInput(unsigned int inpMask) { tiTSInputMask |= inpMask; return OK; }
+int tiLoadTriggerTable(int mode) { return OK; }
+int tiSetTriggerHoldoff(int rule, unsigned int value, int timestep) { return OK; }
+int tiSetTriggerPulse(int trigger, int delay, int width, int delay_step) { return OK; }
+
+int
+tiSetInputPrescale(int input, int prescale)
+{
+  if((input < 1) || (input > 6) || (prescale < 0) || (prescale > 15))
+    return ERROR;
+  tiPrescale[input] = prescale;
+  return OK;
+}
+
+int
+tiGetInputPrescale(int input)
+{
+  return ((input < 1) || (input > 6)) ? ERROR : tiPrescale[input];
+}
+
+/* TS input n counts the triggers of event type n at rate_hz, before
+   its prescale (2^prescale) */
+unsigned int
+tiGetTSscaler(int input, int latch)
+{
+  double frac;
+
+  simVmeRead();
+  if((input < 1) || (input > 6) || !(tiTSInputMask & (1 << (input - 1))))
+    return 0;
+
+  switch(input)
+    {
+    case 1:  frac = 1. - simConfig.evtype_2 - simConfig.evtype_3; break;
+    case 2:  frac = simConfig.evtype_2; break;
+    case 3:  frac = simConfig.evtype_3; break;
+    default: frac = 0;
+    }
+
+  /* 32 bit scaler, wraps */
+  return (unsigned int)(unsigned long long)(1e-9 * simNow() * simConfig.rate_hz * frac *
+					    (1 << tiPrescale[input]));
+}
+
+int tiSetEvTypeScalers(int enable) { return OK; }
+int tiSetBlockLimit(unsigned int limit) { simSetBlockLimit(limit); return OK; }
+int tiResetSlaveConfig() { return OK; }
+int tiUseBroadcastBufferLevel(int enable) { return OK; }
+
+int
+tiSetBlockLevel(int blockLevel)
+{
+  if((blockLevel < 1) || (blockLevel > 255))
+    return ERROR;
+  tiBlockLevel = blockLevel;
+  return OK;
+}
+
+int
+tiSetBlockBufferLevel(unsigned int level)
+{
+  tiBufferLevel = (level > 0) ? level : 1;
+  simConfig.ti_bufferlevel = tiBufferLevel;
+  return OK;
+}
+
+int tiGetBlockBufferLevel() { return tiBufferLevel; }
+int tiGetBroadcastBlockBufferLevel() { return tiBufferLevel; }
+int tiGetCurrentBlockLevel() { return tiBlockLevel; }
+
+int
+tiSetSyncEventInterval(int blk_interval)
+{
+  tiSyncInterval = blk_interval;
+  return OK;
+}
+
+int tiGetSyncEventInterval() { return tiSyncInterval; }
+int tiGetSyncEventFlag() { return tiSyncFlag; }
+
+int tiSetRandomTrigger(int trigger, int setting) { tiPulserOn = 1; return OK; }
+int tiDisableRandomTrigger() { tiPulserOn = 0; return OK; }
+
+int
+tiSoftTrig(int trigger, unsigned int nevents, unsigned int period_inc, int range)
+{
+  tiPulserOn = (nevents != 0);
+  return OK;
+}
+
+int
+tiSetOutputPort(unsigned int set1, unsigned int set2, unsigned int set3,
+		unsigned int set4)
+{
+  simVmeWrite();
+  return OK;
+}
+
+unsigned int tiGetIntCount() { return tiIntCount; }
+unsigned int tiGetAdr32() { return 0x08000000; }
+
+/* Acknowledge a block, as the library's polling thread does before
+   calling the readout routine */
+int
+tiIntAck()
+{
+  tiIntCount++;
+  simEventStart();
+  return OK;
+}
+
+int
+tiBReady()
+{
+  simVmeRead();
+  return simReadyCount(SIM_TI);
+}
+
+int
+tiReadTriggerBlock(volatile unsigned int *data)
+{
+  SIM_BLOCK *blk;
+  int nread;
+
+  simVmeRead();
+  blk = simReadyBlock(SIM_TI);
+  if(blk == NULL)
+    return ERROR;
+
+  tiSyncFlag = (blk->flags & SIM_BLK_SYNC) ? 1 : 0;
+  if(tiSyncFlag)
+    simSyncBusy(1);
+
+  if(blk->nwords < 0)
+    simGenerate(SIM_TI, blk);
+  simBlockRead(SIM_TI, blk, data, blk->nwords, &nread);
+
+  return nread;
+}
+
+/* Run start/stop: triggers flow while "interrupts" are enabled */
+int
+tiIntEnable(int iflag)
+{
+  tiIntCount = 0;
+  tiSyncFlag = 0;
+  simRunStart();
+  return OK;
+}
+
+int
+tiIntDisable()
+{
+  simRunStop();
+  return OK;
+}
+
+/****************************************
+ *  SD
+ ****************************************/
+
+int sdInit(int flag) { return OK; }
+int sdStatus(int pflag) { return OK; }
+int sdSetActiveVmeSlots(unsigned int vmemask) { return OK; }
+int sdSetBusyVmeSlots(unsigned int busymask, int reset) { return OK; }
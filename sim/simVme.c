@@ -0,0 +1,1095 @@
+/*************************************************************************
+ *
+ *  simVme.c -
+ *
+ *   Simulation core: clock and busy-waits, parameters, trigger and block
+ *   queues, run statistics.  Also the jvme stand-ins (VME access, DMA
+ *   partitions) and daLogMsg.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "jvme.h"
+#include "tiLib.h"
+#include "fadcLib.h"
+#include "sspLib.h"
+#include "simLib.h"
+
+SIM_CONFIG simConfig;
+SIM_MODULE simModule[SIM_NMOD];
+
+static const char *simModuleName[SIM_NMOD] = { "ti", "fadc", "mpd", "maroc" };
+
+static int simRun = 0;
+static int simSyncHold = 0;
+static int simInEvent = 0;
+static unsigned long long simNextTrig = 0;
+static unsigned int simEvnum = 0;
+static unsigned long long simNblocks = 0, simNevents = 0, simNbytes = 0;
+static unsigned long long simLost = 0, simOverrun = 0;
+static float *simTrigTime = NULL;
+static int simNtrig = 0, simAtrig = 0;
+static unsigned long long simRng = 1;
+
+static pthread_mutex_t simBusMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t simDmaMutex = PTHREAD_MUTEX_INITIALIZER;
+/* Block queues: the readout list may reach a module from a thread other
+   than the trigger's (recovery) */
+static pthread_mutex_t simQueueMutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int simBlockLimit = 0, simRunBlocks = 0;
+
+/****************************************
+ *  CLOCK, WAITS, RANDOM NUMBERS
+ ****************************************/
+
+/* Time spent generating block data, which the hardware would not spend */
+static unsigned long long simStolen = 0;
+
+static unsigned long long
+simRealNow()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+unsigned long long
+simNow()
+{
+  return simRealNow() - simStolen;
+}
+
+void
+simSpinUntil(unsigned long long t_ns)
+{
+  while(simNow() < t_ns)
+    ;
+}
+
+void
+simSpin(double us)
+{
+  if(us > 0)
+    simSpinUntil(simNow() + (unsigned long long)(us * 1000.));
+}
+
+void
+simVmeRead()
+{
+  simSpin(simConfig.vme_read_us);
+}
+
+void
+simVmeWrite()
+{
+  simSpin(simConfig.vme_write_us);
+}
+
+/* Module initialization delays (these sleep, the bus is free) */
+void
+simSleep(double ms)
+{
+  double us = ms * 1000. * simConfig.init_scale;
+  if(us >= 1)
+    usleep((useconds_t) us);
+}
+
+/* xorshift64* */
+double
+simRand()
+{
+  simRng ^= simRng >> 12;
+  simRng ^= simRng << 25;
+  simRng ^= simRng >> 27;
+  return (double)((simRng * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double
+simGauss()
+{
+  static int have = 0;
+  static double save;
+  double u, v, s;
+
+  if(have)
+    {
+      have = 0;
+      return save;
+    }
+
+  do
+    {
+      u = 2. * simRand() - 1.;
+      v = 2. * simRand() - 1.;
+      s = u * u + v * v;
+    }
+  while((s >= 1.) || (s == 0.));
+
+  s = sqrt(-2. * log(s) / s);
+  save = v * s;
+  have = 1;
+  return u * s;
+}
+
+/****************************************
+ *  PARAMETERS
+ ****************************************/
+
+typedef struct
+{
+  const char *key;
+  size_t      offset;
+  const char *help;
+} SIM_PARAM;
+
+#define CPAR(x) offsetof(SIM_CONFIG, x)
+static SIM_PARAM simConfigParams[] =
+  {
+    {"rate_hz",      CPAR(rate_hz),      "event rate (Hz), 0 = next trigger when idle"},
+    {"poisson",      CPAR(poisson),      "1: random (poisson) trigger arrival"},
+    {"seed",         CPAR(seed),         "random number seed"},
+    {"vme_read_us",  CPAR(vme_read_us),  "single cycle VME read"},
+    {"vme_write_us", CPAR(vme_write_us), "single cycle VME write"},
+    {"mpd_read_us",  CPAR(mpd_read_us),  "MPD register read through the SSP fiber"},
+    {"buserr_us",    CPAR(buserr_us),    "cost of a DMA terminated by bus error"},
+    {"init_scale",   CPAR(init_scale),   "scale factor for module init delays"},
+    {"evtype_2",     CPAR(evtype_2),     "fraction of events with event type 2"},
+    {"evtype_3",     CPAR(evtype_3),     "fraction of events with event type 3"},
+    {"evtype_pulser",CPAR(evtype_pulser),"fraction of events from the TI pulser, while it runs"},
+    {"pulser_evtype",CPAR(pulser_evtype),"event type of the TI pulser events"},
+    {"fadc_n",       CPAR(fadc_n),       "number of FADC250s"},
+    {"fadc_ptw",     CPAR(fadc_ptw),     "FADC250 window (samples)"},
+    {"fadc_nch",     CPAR(fadc_nch),     "FADC250 channels with data"},
+    {"fadc_mode",    CPAR(fadc_mode),    "FADC250 mode (1: window raw, 2: pulse raw)"},
+    {"fadc_npulse",  CPAR(fadc_npulse),  "FADC250 pulses per channel, pulse raw mode"},
+    {"mpd_nfiber",   CPAR(mpd_nfiber),   "number of MPDs (SSP fibers)"},
+    {"mpd_napv",     CPAR(mpd_napv),     "APVs per MPD"},
+    {"mpd_hit_prob", CPAR(mpd_hit_prob), "probability a strip has a hit"},
+    {"mpd_noise",    CPAR(mpd_noise),    "APV strip noise (ADC rms)"},
+    {"mpd_cm_rms",   CPAR(mpd_cm_rms),   "APV common mode (ADC rms)"},
+    {"mpd_settle_ms",CPAR(mpd_settle_ms),"APV frame sync after the 101 reset (ms)"},
+    {"mpd_soft_rate",CPAR(mpd_soft_rate),"soft errors/s on fiber 0"},
+    {"mpd_soft_down",CPAR(mpd_soft_down),"fiber 0 soft errors for its link to go down, 0 = never"},
+    {"mpd_hang",     CPAR(mpd_hang),     "probability a block hangs the MPD output"},
+    {"mpd_hang_level",CPAR(mpd_hang_level),"hang cleared by 2: fiber reset, 3: MPD re-arm, 4: nothing"},
+    {"maroc_words",  CPAR(maroc_words),  "MAROC hit words per event"},
+    {"ssp_eb_stale", CPAR(ssp_eb_stale), "probability the SSP word count is stale"},
+    {"eb_mbps",      CPAR(eb_mbps),      "event builder rate (MB/s), 0 = immediate"},
+    {NULL, 0, NULL}
+  };
+
+#define MPAR(x) offsetof(SIM_MODULE, x)
+static SIM_PARAM simModuleParams[] =
+  {
+    {"latency_us",   MPAR(latency_us),   "trigger to data ready"},
+    {"jitter_us",    MPAR(jitter_us),    "uniform jitter on the latency (+/-)"},
+    {"dma_setup_us", MPAR(dma_setup_us), "DMA setup time"},
+    {"dma_mbps",     MPAR(dma_mbps),     "DMA bandwidth (MB/s)"},
+    {"p_late",       MPAR(p_late),       "probability a block is timeout_ms late"},
+    {"timeout_ms",   MPAR(timeout_ms),   "delay of a late block"},
+    {"p_error",      MPAR(p_error),      "probability of a block error"},
+    {"p_missing",    MPAR(p_missing),    "probability a block never arrives"},
+    {"p_slip",       MPAR(p_slip),       "probability the clock slips 1-4 ticks (time stamps)"},
+    {NULL, 0, NULL}
+  };
+
+static double *
+simParamFind(const char *key)
+{
+  int i, imod;
+  const char *dot;
+
+  for(i = 0; simConfigParams[i].key; i++)
+    if(strcmp(key, simConfigParams[i].key) == 0)
+      return (double *)((char *)&simConfig + simConfigParams[i].offset);
+
+  dot = strchr(key, '.');
+  if(dot == NULL)
+    return NULL;
+
+  for(imod = 0; imod < SIM_NMOD; imod++)
+    {
+      if((strlen(simModuleName[imod]) != (size_t)(dot - key)) ||
+	 strncmp(key, simModuleName[imod], dot - key))
+	continue;
+
+      for(i = 0; simModuleParams[i].key; i++)
+	if(strcmp(dot + 1, simModuleParams[i].key) == 0)
+	  return (double *)((char *)&simModule[imod] + simModuleParams[i].offset);
+    }
+
+  return NULL;
+}
+
+int
+simSet(const char *key, const char *value)
+{
+  double *p = simParamFind(key);
+
+  if(p == NULL)
+    {
+      fprintf(stderr, "%s: ERROR: Unknown parameter %s\n", __func__, key);
+      return ERROR;
+    }
+
+  *p = atof(value);
+
+  if(strcmp(key, "seed") == 0)
+    simRng = (unsigned long long) *p * 0x9E3779B97F4A7C15ULL + 1;
+
+  return OK;
+}
+
+int
+simSetParam(const char *keyval)
+{
+  char key[128];
+  const char *eq = strchr(keyval, '=');
+
+  if((eq == NULL) || ((size_t)(eq - keyval) >= sizeof(key)))
+    {
+      fprintf(stderr, "%s: ERROR: expected key=value, got %s\n", __func__, keyval);
+      return ERROR;
+    }
+
+  strncpy(key, keyval, eq - keyval);
+  key[eq - keyval] = 0;
+
+  return simSet(key, eq + 1);
+}
+
+void
+simPrintParams()
+{
+  int i, imod;
+
+  printf("Simulation parameters:\n");
+  for(i = 0; simConfigParams[i].key; i++)
+    printf("  %-20s %10g   %s\n", simConfigParams[i].key,
+	   *(double *)((char *)&simConfig + simConfigParams[i].offset),
+	   simConfigParams[i].help);
+
+  for(imod = 0; imod < SIM_NMOD; imod++)
+    {
+      for(i = 0; simModuleParams[i].key; i++)
+	{
+	  char key[64];
+	  snprintf(key, sizeof(key), "%s.%s", simModuleName[imod],
+		   simModuleParams[i].key);
+	  printf("  %-20s %10g   %s\n", key,
+		 *(double *)((char *)&simModule[imod] + simModuleParams[i].offset),
+		 simModuleParams[i].help);
+	}
+    }
+}
+
+static void
+simModuleDefaults(SIM_MODULE *m, double latency, double jitter,
+		  double setup, double mbps)
+{
+  m->latency_us   = latency;
+  m->jitter_us    = jitter;
+  m->dma_setup_us = setup;
+  m->dma_mbps     = mbps;
+  m->p_late       = 0;
+  m->timeout_ms   = 50;
+  m->p_error      = 0;
+  m->p_missing    = 0;
+  m->p_slip       = 0;
+}
+
+/* Defaults, and clear all state and statistics */
+void
+simReset()
+{
+  int imod, i;
+
+  for(imod = 0; imod < SIM_NMOD; imod++)
+    {
+      SIM_MODULE *m = &simModule[imod];
+      for(i = 0; i < SIM_RING; i++)
+	if(m->ring[i].data)
+	  free(m->ring[i].data);
+      if(m->lat) free(m->lat);
+      if(m->dma) free(m->dma);
+      memset(m, 0, sizeof(SIM_MODULE));
+      m->name = simModuleName[imod];
+    }
+
+  simModuleDefaults(&simModule[SIM_TI],     1.,  0., 3., 100.);
+  simModuleDefaults(&simModule[SIM_FADC],   8.,  2., 5., 180.);
+  simModuleDefaults(&simModule[SIM_MPD],   40.,  5., 5., 180.);
+  simModuleDefaults(&simModule[SIM_MAROC],  5.,  1., 5., 150.);
+
+  memset(&simConfig, 0, sizeof(simConfig));
+  simConfig.rate_hz      = 0;
+  simConfig.poisson      = 0;
+  simConfig.seed         = 1;
+  simConfig.vme_read_us  = 1.0;
+  simConfig.vme_write_us = 0.5;
+  simConfig.mpd_read_us  = 4.0;
+  simConfig.buserr_us    = 4.0;
+  simConfig.init_scale   = 1.0;
+  simConfig.ti_bufferlevel = 5;
+  simConfig.evtype_2     = 0.10;
+  simConfig.evtype_3     = 0.05;
+  simConfig.evtype_pulser = 0.5;
+  simConfig.pulser_evtype = 253;
+  simConfig.fadc_n       = 2;
+  simConfig.fadc_ptw     = 48;
+  simConfig.fadc_nch     = 16;
+  simConfig.fadc_mode    = 1;
+  simConfig.fadc_npulse  = 4;
+  simConfig.mpd_nfiber   = 2;
+  simConfig.mpd_napv     = 8;
+  simConfig.mpd_hit_prob = 0.02;
+  simConfig.mpd_noise    = 15;
+  simConfig.mpd_cm_rms   = 20;
+  simConfig.mpd_settle_ms = 120;
+  simConfig.mpd_soft_rate = 0;
+  simConfig.mpd_soft_down = 0;
+  simConfig.mpd_hang     = 0;
+  simConfig.mpd_hang_level = 2;
+  simConfig.maroc_words  = 64;
+  simConfig.eb_mbps      = 0;
+
+  simRng = 0x9E3779B97F4A7C15ULL + 1;
+  simRun = 0;
+  simEvnum = 0;
+  simBlockLimit = 0;
+  simNblocks = simNevents = simNbytes = simLost = simOverrun = 0;
+  if(simTrigTime) free(simTrigTime);
+  simTrigTime = NULL;
+  simNtrig = simAtrig = 0;
+}
+
+/****************************************
+ *  TRIGGERS AND BLOCK QUEUES
+ ****************************************/
+
+void
+simModuleActivate(int mod, int active)
+{
+  simModule[mod].active = active;
+}
+
+void
+simBlockAlloc(SIM_BLOCK *blk, int nwords)
+{
+  if(nwords > blk->alloc)
+    {
+      blk->alloc = nwords + 1024;
+      blk->data = (unsigned int *)realloc(blk->data, blk->alloc * sizeof(unsigned int));
+    }
+}
+
+static void
+simTrigger(unsigned long long t)
+{
+  int imod, iev, bl = simBlockLevel();
+  int evtype[256], sync = 0, interval;
+  double u;
+
+  if(bl > 255) bl = 255;
+
+  for(iev = 0; iev < bl; iev++)
+    {
+      u = simRand();
+      evtype[iev] = (u < simConfig.evtype_3) ? 3 :
+	(u < simConfig.evtype_3 + simConfig.evtype_2) ? 2 : 1;
+      if(simPulserOn() && (simRand() < simConfig.evtype_pulser))
+	evtype[iev] = (int) simConfig.pulser_evtype;
+    }
+
+  interval = tiGetSyncEventInterval();
+  if((interval > 0) && (((simModule[SIM_TI].blocknum + 1) % interval) == 0))
+    sync = 1;
+
+  for(imod = 0; imod < SIM_NMOD; imod++)
+    {
+      SIM_MODULE *m = &simModule[imod];
+      SIM_BLOCK *blk;
+      int flags = 0;
+
+      if(!m->active)
+	continue;
+
+      m->blocknum++;
+
+      if(((imod == SIM_MPD) && simMpdHung()) || (simRand() < m->p_missing))
+	{
+	  m->n_missing++;
+	  continue;
+	}
+      if(simRand() < m->p_late)
+	{
+	  flags |= SIM_BLK_LATE;
+	  m->n_late++;
+	}
+      if(simRand() < m->p_error)
+	{
+	  flags |= SIM_BLK_ERROR;
+	  m->n_error++;
+	}
+      if((imod == SIM_TI) && sync)
+	flags |= SIM_BLK_SYNC;
+
+      if(m->count == SIM_RING)
+	{
+	  /* Nobody is reading this module.  Lose the oldest block. */
+	  m->head = (m->head + 1) % SIM_RING;
+	  m->count--;
+	}
+
+      blk = &m->ring[(m->head + m->count) % SIM_RING];
+      blk->evnum    = simEvnum + 1;
+      blk->nevents  = bl;
+      blk->trig_ns  = t;
+      if(simRand() < m->p_slip)
+	{
+	  m->ts_slip += 1 + (int)(4. * simRand());
+	  m->n_slip++;
+	}
+      blk->ts       = t / 4 + m->ts_slip;
+      blk->ready_ns = t + (unsigned long long)(1000. *
+					       (m->latency_us +
+						m->jitter_us * (2. * simRand() - 1.)));
+      if(flags & SIM_BLK_LATE)
+	blk->ready_ns += (unsigned long long)(1e6 * m->timeout_ms);
+      blk->flags    = flags;
+      blk->nwords   = -1;
+      blk->offset   = 0;
+      memcpy(blk->evtype, evtype, bl * sizeof(int));
+
+      m->count++;
+
+      /* Now, so the real time it takes is not spent in the readout list
+	 (when triggers come while idle) */
+      simGenerate(imod, blk);
+    }
+
+  simEvnum += bl;
+  simRunBlocks++;
+}
+
+/* TI block limit (tiSetBlockLimit), 0: none */
+void
+simSetBlockLimit(unsigned int limit)
+{
+  simBlockLimit = limit;
+}
+
+static int
+simLimitReached()
+{
+  return (simBlockLimit > 0) && (simRunBlocks >= simBlockLimit);
+}
+
+/* Generate the triggers due by now.  simQueueMutex held. */
+static void
+simAdvanceLocked()
+{
+  unsigned long long now;
+  double interval;
+  int bl;
+
+  if(!simRun || simLimitReached())
+    return;
+
+  now = simNow();
+
+  if(simConfig.rate_hz <= 0)
+    {
+      /* Next trigger once the previous event has left the readout list.
+	 Module blocks still in flight (late) are not waited for. */
+      if(!simInEvent && !simSyncHold && (simModule[SIM_TI].count == 0))
+	simTrigger(now);
+      return;
+    }
+
+  bl = simBlockLevel();
+  while(simNextTrig <= now)
+    {
+      if(simLimitReached())
+	break;
+      else if(!simSyncHold &&
+	 (simModule[SIM_TI].count < (int)simConfig.ti_bufferlevel))
+	simTrigger(simNextTrig);
+      else
+	simLost += bl;  /* busy */
+
+      interval = 1e9 * bl / simConfig.rate_hz;
+      if(simConfig.poisson)
+	interval *= -log(1. - simRand());
+      simNextTrig += (unsigned long long) interval + 1;
+    }
+}
+
+void
+simAdvance()
+{
+  pthread_mutex_lock(&simQueueMutex);
+  simAdvanceLocked();
+  pthread_mutex_unlock(&simQueueMutex);
+}
+
+/* Readout list is building an event (tiIntAck .. simEventOut) */
+void
+simEventStart()
+{
+  simInEvent = 1;
+}
+
+/* The TI holds off triggers from the readout of a sync event until
+   that event has left the readout list */
+void
+simSyncBusy(int on)
+{
+  simSyncHold = on;
+}
+
+/* Front block, if its data is ready */
+SIM_BLOCK *
+simReadyBlock(int mod)
+{
+  SIM_MODULE *m = &simModule[mod];
+  SIM_BLOCK *blk = NULL;
+
+  pthread_mutex_lock(&simQueueMutex);
+  simAdvanceLocked();
+
+  if((m->count > 0) && (m->ring[m->head].ready_ns <= simNow()))
+    blk = &m->ring[m->head];
+  pthread_mutex_unlock(&simQueueMutex);
+
+  return blk;
+}
+
+int
+simReadyCount(int mod)
+{
+  SIM_MODULE *m = &simModule[mod];
+  unsigned long long now;
+  int i, n = 0;
+
+  pthread_mutex_lock(&simQueueMutex);
+  simAdvanceLocked();
+  now = simNow();
+
+  for(i = 0; i < m->count; i++)
+    {
+      if(m->ring[(m->head + i) % SIM_RING].ready_ns > now)
+	break;
+      n++;
+    }
+  pthread_mutex_unlock(&simQueueMutex);
+
+  return n;
+}
+
+/* Fill in the block data.  Not charged to the simulated clock. */
+void
+simGenerate(int mod, SIM_BLOCK *blk)
+{
+  unsigned long long t0 = simRealNow();
+
+  switch(mod)
+    {
+    case SIM_TI:    simGenTi(blk, 0); break;
+    case SIM_FADC:  simGenFadc(blk, 0); break;
+    case SIM_MPD:   simGenMpd(blk, 0); break;
+    case SIM_MAROC: simGenMaroc(blk, 0); break;
+    }
+
+  simStolen += simRealNow() - t0;
+}
+
+static void
+simStat(SIM_MODULE *m, float lat, float dma)
+{
+  if(m->nlat == m->alat)
+    {
+      m->alat = (m->alat) ? 2 * m->alat : 4096;
+      m->lat = (float *)realloc(m->lat, m->alat * sizeof(float));
+      m->dma = (float *)realloc(m->dma, m->alat * sizeof(float));
+    }
+  m->lat[m->nlat] = lat;
+  m->dma[m->nlat] = dma;
+  m->nlat++;
+}
+
+/*
+ * DMA (up to nwrds) from the block.  Costs setup + size/bandwidth,
+ * and a bus error if the request was more than what was left.
+ * The block is removed once all of it has been read.
+ */
+void
+simBlockRead(int mod, SIM_BLOCK *blk, volatile unsigned int *data, int nwrds,
+	     int *nread)
+{
+  SIM_MODULE *m = &simModule[mod];
+  unsigned long long t0 = simNow();
+  int left, n = 0;
+  double us;
+
+  pthread_mutex_lock(&simQueueMutex);
+  m->nread_calls++;
+
+  if(blk)
+    {
+      if(blk->nwords < 0)
+	simGenerate(mod, blk);
+
+      left = blk->nwords - blk->offset;
+      n = (nwrds < left) ? nwrds : left;
+      if(n < 0) n = 0;
+
+      memcpy((void *)data, &blk->data[blk->offset], n * sizeof(unsigned int));
+      blk->offset += n;
+      m->nwords += n;
+    }
+  else
+    left = 0;
+
+  us = m->dma_setup_us + (n * 4.) / m->dma_mbps;
+  if(nwrds > left)
+    {
+      us += simConfig.buserr_us;
+      m->nbuserr++;
+    }
+  simSpinUntil(t0 + (unsigned long long)(1000. * us));
+
+  m->dma_acc += 1e-3 * (simNow() - t0);
+
+  if(blk && (blk->offset >= blk->nwords))
+    {
+      simStat(m, 1e-3 * (simNow() - blk->trig_ns), m->dma_acc);
+      m->dma_acc = 0;
+      m->nblocks++;
+      m->head = (m->head + 1) % SIM_RING;
+      m->count--;
+    }
+  pthread_mutex_unlock(&simQueueMutex);
+
+  *nread = n;
+}
+
+/****************************************
+ *  RUN CONTROL AND STATISTICS
+ ****************************************/
+
+void
+simRunStart()
+{
+  int imod;
+
+  for(imod = 0; imod < SIM_NMOD; imod++)
+    {
+      SIM_MODULE *m = &simModule[imod];
+      m->head = m->count = 0;
+      m->nblocks = m->nwords = m->nread_calls = m->nbuserr = 0;
+      m->n_late = m->n_error = m->n_missing = m->n_slip = 0;
+      m->ts_slip = 0;
+      m->nlat = 0;
+      m->dma_acc = 0;
+    }
+  simModule[SIM_TI].active = 1;
+
+  simNblocks = simNevents = simNbytes = simLost = simOverrun = 0;
+  simNtrig = 0;
+  simNextTrig = simNow();
+  simSyncHold = 0;
+  simInEvent = 0;
+  simRunBlocks = 0;
+  simEvnum = 0;           /* event numbers start over at each run */
+  simRun = 1;
+}
+
+void
+simRunStop()
+{
+  simRun = 0;
+}
+
+int
+simRunning()
+{
+  return simRun;
+}
+
+/* The TI reached its block limit, and its blocks have all been read */
+int
+simRunDone()
+{
+  return simRun && simLimitReached() && (simModule[SIM_TI].count == 0);
+}
+
+/* An event leaving the readout list */
+void
+simEventOut(unsigned int *data, int nwords, int maxwords,
+	    unsigned long long t0, unsigned long long t1)
+{
+  if(nwords > maxwords)
+    {
+      simOverrun++;
+      fprintf(stderr, "%s: ERROR: event buffer overrun (%d > %d words)\n",
+	      __func__, nwords, maxwords);
+    }
+
+  simSyncHold = 0;
+  simInEvent = 0;
+
+  simNblocks++;
+  simNevents += simBlockLevel();
+  simNbytes += nwords * 4;
+
+  if(simNtrig == simAtrig)
+    {
+      simAtrig = (simAtrig) ? 2 * simAtrig : 4096;
+      simTrigTime = (float *)realloc(simTrigTime, simAtrig * sizeof(float));
+    }
+  simTrigTime[simNtrig++] = 1e-3 * (t1 - t0);
+}
+
+/* Event builder: takes the events from the output queue of the list at
+   eb_mbps, returning each buffer to its partition once it is sent */
+static DMANODE *simEbNode = NULL;
+static unsigned long long simEbDone = 0;
+
+void
+simEbDrain(DMA_MEM_ID outQ)
+{
+  unsigned long long now = simNow();
+
+  while(1)
+    {
+      if(simEbNode)
+	{
+	  if(simEbDone > now)
+	    return;
+	  dmaPFreeItem(simEbNode);
+	  simEbNode = NULL;
+	}
+
+      simEbNode = dmaPGetItem(outQ);
+      if(simEbNode == NULL)
+	return;
+
+      if(simConfig.eb_mbps > 0)
+	simEbDone = ((simEbDone > now) ? simEbDone : now) +
+	  (unsigned long long)(1e3 * simEbNode->length / simConfig.eb_mbps);
+      else
+	simEbDone = now;
+    }
+}
+
+void
+simEbFlush()
+{
+  if(simEbNode)
+    dmaPFreeItem(simEbNode);
+  simEbNode = NULL;
+  simEbDone = 0;
+}
+
+void
+simGetRunStats(unsigned long long *nblocks, unsigned long long *nevents,
+	       unsigned long long *nbytes, unsigned long long *nlost,
+	       unsigned long long *noverrun, float **trig_us, int *ntrig)
+{
+  *nblocks  = simNblocks;
+  *nevents  = simNevents;
+  *nbytes   = simNbytes;
+  *nlost    = simLost;
+  *noverrun = simOverrun;
+  *trig_us  = simTrigTime;
+  *ntrig    = simNtrig;
+}
+
+/****************************************
+ *  VME
+ ****************************************/
+
+static int vmeQuietFlag = 0;
+
+int
+vmeOpenDefaultWindows()
+{
+  return OK;
+}
+
+int
+vmeCloseDefaultWindows()
+{
+  return OK;
+}
+
+void
+vmeSetQuietFlag(unsigned int pflag)
+{
+  vmeQuietFlag = pflag;
+}
+
+int
+vmeBusLock()
+{
+  return pthread_mutex_lock(&simBusMutex);
+}
+
+int
+vmeBusUnlock()
+{
+  return pthread_mutex_unlock(&simBusMutex);
+}
+
+unsigned int
+vmeRead32(volatile unsigned int *addr)
+{
+  simVmeRead();
+  return *addr;
+}
+
+void
+vmeWrite32(volatile unsigned int *addr, unsigned int val)
+{
+  simVmeWrite();
+  *addr = val;
+}
+
+int
+vmeDmaConfig(unsigned int addrType, unsigned int dataType, unsigned int sstMode)
+{
+  return OK;
+}
+
+int
+vmeDmaFlush(unsigned int addr)
+{
+  int imod = -1;
+
+  /* Module from its A32 window (see simTi.c, simFadc.c, simSsp.c) */
+  if((addr & 0xff800000) == tiGetAdr32())
+    imod = SIM_TI;
+  else if((addr & 0xff800000) == fadcA32Base)
+    imod = SIM_FADC;
+  else if((addr & 0xff800000) == sspA32Base)
+    imod = simModule[SIM_MPD].active ? SIM_MPD : SIM_MAROC;
+
+  /* DMA until bus error: the front block is gone */
+  if((imod >= 0) && simReadyBlock(imod))
+    {
+      SIM_MODULE *m = &simModule[imod];
+      m->head = (m->head + 1) % SIM_RING;
+      m->count--;
+    }
+
+  simSpin(simConfig.buserr_us);
+  return OK;
+}
+
+/****************************************
+ *  DMA PARTITIONS
+ ****************************************/
+
+static DMA_MEM_ID dmaPartList = NULL;
+
+int
+dmaPartInit()
+{
+  return OK;
+}
+
+/* The nodes of a partition are one mapping, on hugepages if the system
+   has them reserved (else transparent hugepages, if enabled) */
+#define SIM_HUGEPAGE (2 << 20)
+
+DMA_MEM_ID
+dmaPCreate(char *name, int size, int c, int incr)
+{
+  DMA_MEM_ID p;
+  size_t stride;
+  int i;
+
+  p = (DMA_MEM_ID)calloc(1, sizeof(DMA_MEM_PART));
+  strncpy(p->name, name, sizeof(p->name) - 1);
+  p->size  = size;
+  p->total = c;
+
+  if(c > 0)
+    {
+      /* Twice the requested size, so an overrun is reported rather than
+	 corrupting the next buffer */
+      stride = (sizeof(DMANODE) + 2 * (size_t)size + 63) & ~(size_t)63;
+      p->memsize = (stride * c + SIM_HUGEPAGE - 1) & ~(size_t)(SIM_HUGEPAGE - 1);
+      p->mem = mmap(NULL, p->memsize, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if(p->mem == MAP_FAILED)
+	{
+	  p->mem = mmap(NULL, p->memsize, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	  if(p->mem == MAP_FAILED)
+	    {
+	      printf("%s: ERROR: unable to map %zu bytes for %s\n",
+		     __func__, p->memsize, name);
+	      free(p);
+	      return NULL;
+	    }
+	  madvise(p->mem, p->memsize, MADV_HUGEPAGE);
+	}
+
+      p->nodes = (DMANODE **)calloc(c, sizeof(DMANODE *));
+      for(i = 0; i < c; i++)
+	{
+	  p->nodes[i] = (DMANODE *)((char *)p->mem + i * stride);
+	  p->nodes[i]->part = p;
+	}
+    }
+
+  p->next = dmaPartList;
+  dmaPartList = p;
+
+  dmaPReInit(p);
+
+  return p;
+}
+
+int
+dmaPFree(DMA_MEM_ID pPart)
+{
+  DMA_MEM_ID *pp;
+
+  for(pp = &dmaPartList; *pp; pp = &(*pp)->next)
+    {
+      if(*pp == pPart)
+	{
+	  *pp = pPart->next;
+	  if(pPart->mem)
+	    munmap(pPart->mem, pPart->memsize);
+	  free(pPart->nodes);
+	  free(pPart);
+	  return OK;
+	}
+    }
+
+  return ERROR;
+}
+
+void
+dmaPFreeAll()
+{
+  while(dmaPartList)
+    dmaPFree(dmaPartList);
+}
+
+void
+dmaPReInit(DMA_MEM_ID pPart)
+{
+  int i;
+
+  pthread_mutex_lock(&simDmaMutex);
+  pPart->head = pPart->tail = NULL;
+  pPart->nlist = 0;
+  pthread_mutex_unlock(&simDmaMutex);
+
+  for(i = 0; i < pPart->total; i++)
+    dmaPFreeItem(pPart->nodes[i]);
+}
+
+void
+dmaPReInitAll()
+{
+  DMA_MEM_ID p;
+
+  for(p = dmaPartList; p; p = p->next)
+    dmaPReInit(p);
+}
+
+DMANODE *
+dmaPGetItem(DMA_MEM_ID pPart)
+{
+  DMANODE *n;
+
+  pthread_mutex_lock(&simDmaMutex);
+  n = pPart->head;
+  if(n)
+    {
+      pPart->head = n->n;
+      if(pPart->head == NULL)
+	pPart->tail = NULL;
+      pPart->nlist--;
+      n->n = NULL;
+    }
+  pthread_mutex_unlock(&simDmaMutex);
+
+  return n;
+}
+
+void
+dmaPPutItem(DMA_MEM_ID pPart, DMANODE *pItem)
+{
+  pthread_mutex_lock(&simDmaMutex);
+  pItem->n = NULL;
+  if(pPart->tail)
+    pPart->tail->n = pItem;
+  else
+    pPart->head = pItem;
+  pPart->tail = pItem;
+  pPart->nlist++;
+  pthread_mutex_unlock(&simDmaMutex);
+}
+
+void
+dmaPFreeItem(DMANODE *pItem)
+{
+  dmaPPutItem(pItem->part, pItem);
+}
+
+int
+dmaPEmpty(DMA_MEM_ID pPart)
+{
+  return (pPart->nlist == 0);
+}
+
+int
+dmaPNodeCount(DMA_MEM_ID pPart)
+{
+  return pPart->nlist;
+}
+
+void
+dmaPStatsAll()
+{
+  DMA_MEM_ID p;
+
+  printf("%s: DMA partitions\n", __func__);
+  for(p = dmaPartList; p; p = p->next)
+    printf("  %-12s size %8d  nodes %3d  available %3d\n",
+	   p->name, p->size, p->total, p->nlist);
+}
+
+/****************************************
+ *  CODA
+ ****************************************/
+
+int
+daLogMsg(char *severity, char *fmt, ...)
+{
+  va_list ap;
+
+  printf("daLogMsg (%s): ", severity);
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+  printf("\n");
+
+  return OK;
+}
@@ -0,0 +1,301 @@
+#pragma once
+/*************************************************************************
+ *
+ *  sizemon_rol_include.c -
+ *
+ *   Words per block monitor: catches the blocks of a module that are
+ *   not the size they have been, the first sign of a module out of step.
+ *
+ *   A module registers at Download (rolSizeRegister) and gives the
+ *   words of each block it reads, as read from the module (before any
+ *   packing or suppression), with rolSizeAdd().  Truncated blocks are
+ *   left out.  For each module, exponentially weighted averages are
+ *   kept of
+ *     - the words, and their variance (1/2^ROL_SIZE_FAST_SHIFT)
+ *     - the words, slowly (1/2^ROL_SIZE_SLOW_SHIFT)
+ *   learned from the first ROL_SIZE_WARMUP blocks of the run.  After
+ *   that it flags
+ *     - outliers: more than rolSizeNsigma sigma from the average
+ *       (sigma at least ROL_SIZE_MIN_SIGMA words + 1% of the average)
+ *     - empty blocks: 0 words, with the block ready
+ *     - drift: the slow average moved by more than rolSizeDriftPct %
+ *       since the last reference (then the new reference)
+ *   Outliers are clipped before they go in the averages, so a single
+ *   bad block does not move them but a lasting change is learned.
+ *
+ *   Only the readout thread updates a module, with no locks.  Flags are
+ *   written with rolLog (no formatting, no blocking in the readout), at
+ *   most one per module every ROL_SIZE_REPORT_MS, with the count of
+ *   those not written since.  All are counted, and printed at End.
+ *
+ *   Set with rolSizeSetThreshold(int nsigma, int driftPct);  nsigma = 0:
+ *   no monitoring
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "poll_rol_include.c"
+#include "log_rol_include.c"
+
+#define ROL_SIZE_MAX         8
+#define ROL_SIZE_WARMUP      64          /* blocks */
+#define ROL_SIZE_FAST_SHIFT  5
+#define ROL_SIZE_SLOW_SHIFT  10
+#define ROL_SIZE_MIN_SIGMA   2.          /* words */
+#define ROL_SIZE_REPORT_MS   1000
+#ifndef ROL_SIZE_NSIGMA
+#define ROL_SIZE_NSIGMA      6
+#endif
+#ifndef ROL_SIZE_DRIFT_PCT
+#define ROL_SIZE_DRIFT_PCT   20
+#endif
+
+typedef struct
+{
+  char name[24];
+  char fmt_outlier[96];               /* rolLog formats, with the name */
+  char fmt_empty[96];
+  char fmt_drift[96];
+
+  /* averages */
+  double mean, var;
+  double slow, ref;
+
+  /* per-run statistics */
+  unsigned int nblocks;               /* in the averages */
+  unsigned int noutlier, nempty, ndrift, ntimeout;
+  unsigned int min, max;
+  unsigned long long words;
+
+  /* reports */
+  unsigned long long report_ns;
+  unsigned int nquiet;                /* flags not written since */
+} ROL_SIZE;
+
+static ROL_SIZE rolSize[ROL_SIZE_MAX];
+static int nrolSize = 0;
+
+int rolSizeNsigma   = ROL_SIZE_NSIGMA;
+int rolSizeDriftPct = ROL_SIZE_DRIFT_PCT;
+
+void
+rolSizeSetThreshold(int nsigma, int driftPct)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, nsigma);
+      return;
+    }
+
+  rolSizeNsigma = (nsigma > 0) ? nsigma : 0;
+  rolSizeDriftPct = (driftPct > 0) ? driftPct : 0;
+  if(rolSizeNsigma)
+    daLogMsg("INFO","Setting words per block monitor (%d sigma, drift %d %%)",
+	     rolSizeNsigma, rolSizeDriftPct);
+  else
+    daLogMsg("INFO","Disabling words per block monitor");
+}
+
+/* Register a module (at Download).  Returns its id for rolSizeAdd(),
+   -1 if there is no room. */
+int
+rolSizeRegister(const char *name)
+{
+  ROL_SIZE *s;
+  int id;
+
+  for(id = 0; id < nrolSize; id++)
+    if(strncmp(rolSize[id].name, name, sizeof(rolSize[id].name) - 1) == 0)
+      return id;
+
+  if(nrolSize >= ROL_SIZE_MAX)
+    {
+      printf("%s: ERROR: Too many modules (max = %d).  Ignoring %s\n",
+	     __func__, ROL_SIZE_MAX, name);
+      return -1;
+    }
+
+  s = &rolSize[nrolSize];
+  memset(s, 0, sizeof(ROL_SIZE));
+  strncpy(s->name, name, sizeof(s->name) - 1);
+  snprintf(s->fmt_outlier, sizeof(s->fmt_outlier),
+	   "%s: %%ld words in a block, expected %%ld +- %%ld (%%ld more not shown)\n",
+	   name);
+  snprintf(s->fmt_empty, sizeof(s->fmt_empty),
+	   "%s: empty block, expected %%ld words (%%ld more not shown)\n", name);
+  snprintf(s->fmt_drift, sizeof(s->fmt_drift),
+	   "%s: words per block drifted from %%ld to %%ld\n", name);
+
+  return nrolSize++;
+}
+
+/* Forget the averages.  Called at Go. */
+void
+rolSizeGo()
+{
+  int id;
+
+  for(id = 0; id < nrolSize; id++)
+    {
+      ROL_SIZE *s = &rolSize[id];
+
+      s->mean = s->var = s->slow = s->ref = 0;
+      s->nblocks = s->noutlier = s->nempty = s->ndrift = s->ntimeout = 0;
+      s->min = ~0u;
+      s->max = 0;
+      s->words = 0;
+      s->report_ns = 0;
+      s->nquiet = 0;
+    }
+}
+
+static inline double
+rolSizeSigma(ROL_SIZE *s)
+{
+  return sqrt(s->var) + ROL_SIZE_MIN_SIGMA + 0.01 * s->mean;
+}
+
+/* Time for another report from this module? */
+static int
+rolSizeReport(ROL_SIZE *s)
+{
+  unsigned long long now = rolPollNow();
+
+  if(s->report_ns && (now - s->report_ns < 1000000ULL * ROL_SIZE_REPORT_MS))
+    {
+      s->nquiet++;
+      return 0;
+    }
+
+  s->report_ns = now;
+  return 1;
+}
+
+/* Warm up: running mean and variance of the first blocks */
+static void
+rolSizeLearn(ROL_SIZE *s, double x)
+{
+  double d = x - s->mean;
+
+  s->mean += d / s->nblocks;
+  s->var += (d * (x - s->mean) - s->var) / s->nblocks;
+
+  if(s->nblocks == ROL_SIZE_WARMUP)
+    s->slow = s->ref = s->mean;
+}
+
+/* The words of a block read from a module.  ready = 0 if the block was
+   never ready (timeout). */
+static inline void
+rolSizeAdd(int id, int nwords, int ready)
+{
+  ROL_SIZE *s;
+  double x, d, lim, a;
+
+  if((id < 0) || (rolSizeNsigma == 0))
+    return;
+
+  s = &rolSize[id];
+
+  if(!ready)
+    {
+      s->ntimeout++;
+      return;
+    }
+
+  if(nwords < 0)
+    nwords = 0;
+  s->words += nwords;
+  if((unsigned int)nwords < s->min)
+    s->min = nwords;
+  if((unsigned int)nwords > s->max)
+    s->max = nwords;
+
+  if(nwords == 0)
+    {
+      /* Not in the averages */
+      s->nempty++;
+      if((s->nblocks >= ROL_SIZE_WARMUP) && rolSizeReport(s))
+	{
+	  rolLog(ROL_LOG_WARN, s->fmt_empty, (long) s->mean, (long) s->nquiet);
+	  s->nquiet = 0;
+	}
+      return;
+    }
+
+  x = nwords;
+  s->nblocks++;
+  if(s->nblocks <= ROL_SIZE_WARMUP)
+    {
+      rolSizeLearn(s, x);
+      return;
+    }
+
+  /* Outlier */
+  lim = rolSizeNsigma * rolSizeSigma(s);
+  d = x - s->mean;
+  if(fabs(d) > lim)
+    {
+      s->noutlier++;
+      if(rolSizeReport(s))
+	{
+	  rolLog(ROL_LOG_WARN, s->fmt_outlier, (long) nwords, (long) s->mean,
+		 (long) lim, (long) s->nquiet);
+	  s->nquiet = 0;
+	}
+      d = (d > 0) ? lim : -lim;
+    }
+
+  x = s->mean + d;
+  a = 1. / (1 << ROL_SIZE_FAST_SHIFT);
+  s->mean += a * d;
+  s->var = (1. - a) * (s->var + a * d * d);
+
+  /* Drift */
+  s->slow += (x - s->slow) / (1 << ROL_SIZE_SLOW_SHIFT);
+  if(rolSizeDriftPct &&
+     (fabs(s->slow - s->ref) > 0.01 * rolSizeDriftPct * s->ref))
+    {
+      s->ndrift++;
+      rolLog(ROL_LOG_WARN, s->fmt_drift, (long) s->ref, (long) s->slow);
+      s->ref = s->slow;
+    }
+}
+
+void
+rolSizeStatus()
+{
+  int id;
+
+  if((nrolSize == 0) || (rolSizeNsigma == 0))
+    return;
+
+  printf("\n%s: Words per block (%d sigma, drift %d %%)\n", __func__,
+	 rolSizeNsigma, rolSizeDriftPct);
+  printf("  Module       Blocks    Avg    Average  Sigma     Min     Max  Outlier   Empty  Drift Timeout\n");
+  printf("----------------------------------------------------------------------------------------------\n");
+  for(id = 0; id < nrolSize; id++)
+    {
+      ROL_SIZE *s = &rolSize[id];
+      unsigned int n = s->nblocks + s->nempty;
+
+      if(n == 0)
+	{
+	  printf("  %-10s %8u %*s %7u\n", s->name, 0, 68, "", s->ntimeout);
+	  continue;
+	}
+
+      printf("  %-10s %8u %8.1f %8.1f %6.1f %7u %7u %8u %7u %6u %7u\n",
+	     s->name, n, (double) s->words / n, s->mean, sqrt(s->var),
+	     s->min, s->max, s->noutlier, s->nempty, s->ndrift, s->ntimeout);
+    }
+  printf("----------------------------------------------------------------------------------------------\n");
+}
+
+/*
+  Local Variables:
+  compile-command: "make -k"
+  End:
+*/
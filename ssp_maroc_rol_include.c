@@ -8,6 +8,11 @@
  */
 #include "sspLib.h"
 #include "sspConfig.h"
+#include "poll_rol_include.c"
+#include "log_rol_include.c"
+#include "evbuf_rol_include.c"
+#include "sizemon_rol_include.c"
+#include "evcheck_rol_include.c"
 
 #ifndef SSP_MAROC_SLOT
 #define SSP_MAROC_SLOT 13
@@ -16,15 +21,26 @@
 #define SSP_MPD_SLOT 20
 #endif
 #define SSP_MAROC_BANK 18
+#define SSP_MAROC_EVENT_WORDS 0x10000   /* largest event read */
+
+/* Give up waiting for block ready after (us) */
+#ifndef SSP_MAROC_READY_TIMEOUT
+#define SSP_MAROC_READY_TIMEOUT 100000
+#endif
+ROL_POLL sspMaroc_Poll;
+static int sspMaroc_Size = -1;
+static int sspMaroc_Check = -1;
+static int sspMaroc_BlockWords = SSP_MAROC_EVENT_WORDS;   /* largest block read, set at Go */
 
 extern int nSSP;
 extern unsigned int sspA32Base;
 
-static int ssp_not_ready_errors[21];
+static int ssp_not_ready_errors[21], ssp_not_ready_logged[21];
 
 const char *rol_usrConfig = "/home/solid/sbsvme22/bryan/ssp/test/sbsvme22.cnf";
 
-#define DEBUG
+/* Per block printout (from the log worker) */
+//#define DEBUG
 
 #define SSP_READ_CONF_FILE  {			\
     sspInitGlobals();				\
@@ -36,6 +52,10 @@ const char *rol_usrConfig = "/home/solid/sbsvme22/bryan/ssp/test/sbsvme22.cnf";
 void
 sspMaroc_Download()
 {
+  rolPollInit(&sspMaroc_Poll, "SSP-MAROC", SSP_MAROC_READY_TIMEOUT);
+  sspMaroc_Size = rolSizeRegister("SSP-MAROC");
+  sspMaroc_Check = rolCheckRegister("SSP-MAROC");
+
   printf("%s: Download Executed\n",
 	 __func__);
 }
@@ -97,10 +117,13 @@ sspMaroc_Go()
 {
   int id, slot;
 
+  rolPollClear(&sspMaroc_Poll);
+
   /* Set the blocklevel in the SSP */
-  uint32_t BLOCKLEVEL = tiGetCurrentBlockLevel();
+  uint32_t blocklevel = tiGetCurrentBlockLevel();
 
-  sspSetBlockLevel(SSP_MAROC_SLOT, BLOCKLEVEL);
+  sspSetBlockLevel(SSP_MAROC_SLOT, blocklevel);
+  sspMaroc_BlockWords = SSP_MAROC_EVENT_WORDS * blocklevel;     // update SSP readout size
   sspStatus(SSP_MAROC_SLOT, 1);
 
 
@@ -109,11 +132,26 @@ sspMaroc_Go()
 /****************************************
  *  TRIGGER
  ****************************************/
-void
-sspMaroc_Trigger(int arg)
+/* Non-blocking check for a block ready in the SSP */
+int
+sspMaroc_Ready()
 {
-  int ii, slot, itime, gbready;
-  int dCnt, len=0;
+  int slot = SSP_MAROC_SLOT, gbready;
+
+  gbready = sspBReady(slot);
+
+  return gbready;
+}
+
+/* Readout the SSP MAROC bank.  ready = 0 if the block was never ready. */
+int
+sspMaroc_Readout(int arg, int ready)
+{
+  int ii, slot;
+  int dCnt, len=0, maxwords;
+#ifdef DEBUG
+  unsigned int bc, wc, ec;
+#endif
 
   BANKOPEN(SSP_MAROC_BANK, BT_UI4, blockLevel);
   ///////////////////////////////////////
@@ -123,35 +161,27 @@ sspMaroc_Trigger(int arg)
 
   slot = SSP_MAROC_SLOT;
 
-#ifdef DEBUG
-  printf("Calling sspBReady(%d) ...\n", slot); fflush(stdout);
-#endif
-  for(itime=0; itime<100000; itime++)
+  if(!ready)
     {
-      gbready = sspBReady(slot);
-
-      if(gbready)
-	break;
-#ifdef DEBUG
-      else
-	printf("SSP NOT READY (slot=%d)\n",slot);
-#endif
-    }
-
-  if(!gbready)
-    {
-      printf("SSP NOT READY (slot=%d)\n",slot);
+      rolLog(ROL_LOG_PRINT, "SSP NOT READY (slot=%ld)\n", slot);
 
       ssp_not_ready_errors[slot]++;
     }
 #ifdef DEBUG
   else
-    printf("SSP IS READY (slot=%d)\n",slot);
+    rolLog(ROL_LOG_PRINT, "SSP IS READY (slot=%ld)\n", slot);
 
-  sspPrintEbStatus(slot);
-  printf(" ");
+  sspGetEbStatus(slot, &bc, &wc, &ec);
+  rolLog(ROL_LOG_PRINT, "  before: %ld blocks, %ld words, %ld events\n", bc, wc, ec);
 #endif
-  len = sspReadBlock(slot,dma_dabufp,0x10000,1);
+  maxwords = rolBufLimit(sspMaroc_BlockWords);
+  len = sspReadBlock(slot,dma_dabufp,maxwords,1);
+  if(rolBufShort(dma_dabufp, len, maxwords, sspMaroc_BlockWords))
+    rolLog(ROL_LOG_ERROR, "SSP block truncated at %ld words (slot=%ld)\n", len, slot);
+  else
+    rolSizeAdd(sspMaroc_Size, len, ready);
+  if(ready)
+    rolCheckBlock(sspMaroc_Check, dma_dabufp, len);
 
 #ifdef DEBUG
   // need to redefine tdcbuff to the_event->data[]
@@ -159,9 +189,9 @@ sspMaroc_Trigger(int arg)
   /* for(jj=0;jj<(len>40?40:len);jj++) */
   /*   printf(" 0x%08x",tdcbuf[jj]); */
 
-  printf(" ");
-  sspPrintEbStatus(slot);
-  printf("\n");
+  sspGetEbStatus(slot, &bc, &wc, &ec);
+  rolLog(ROL_LOG_PRINT, "  after:  %ld blocks, %ld words, %ld events (read %ld)\n",
+	 bc, wc, ec, len);
 #endif
 
   dma_dabufp += len;
@@ -170,15 +200,46 @@ sspMaroc_Trigger(int arg)
   if(dCnt>0)
     {
       slot = SSP_MAROC_SLOT;
-      if( ssp_not_ready_errors[slot] )
+      if( ssp_not_ready_errors[slot] != ssp_not_ready_logged[slot] )
 	{
-	  printf("%s: SSP Read Errors: %4d\n",
-		 __func__, ssp_not_ready_errors[slot]);
+	  rolLog(ROL_LOG_PRINT, "sspMaroc_Readout: SSP Read Errors: %4ld\n",
+		 ssp_not_ready_errors[slot]);
+	  ssp_not_ready_logged[slot] = ssp_not_ready_errors[slot];
 	}
     }
 
   BANKCLOSE;
 
+  return dCnt;
+}
+
+/* Largest SSP MAROC bank, in words */
+int
+sspMaroc_MaxWords()
+{
+  return sspMaroc_BlockWords + 2;
+}
+
+/* Read out a block not wanted for this trigger, or the rest of a
+   truncated block, to dma_dabufp (not kept) */
+int
+sspMaroc_Discard()
+{
+  return sspReadBlock(SSP_MAROC_SLOT, dma_dabufp, sspMaroc_BlockWords, 1);
+}
+
+/* Standalone readout, for lists that do not use the readout scheduler */
+void
+sspMaroc_Trigger(int arg)
+{
+  int gbready;
+
+#ifdef DEBUG
+  rolLog(ROL_LOG_PRINT, "Calling sspBReady(%ld) ...\n", SSP_MAROC_SLOT);
+#endif
+  gbready = rolPollWait(&sspMaroc_Poll, sspMaroc_Ready);
+
+  sspMaroc_Readout(arg, gbready);
 }
 
 /****************************************
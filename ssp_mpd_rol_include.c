@@ -12,6 +12,18 @@
 #include "sspMpdConfig.h"
 #include "sspLib.h"
 #include "sspLib_mpd.h"
+#include <pthread.h>
+#include <errno.h>
+#include <math.h>
+#include "poll_rol_include.c"
+#include "log_rol_include.c"
+#include "pedcache_rol_include.c"
+#include "mpddecode_rol_include.c"
+#include "pack_rol_include.c"
+#include "evbuf_rol_include.c"
+#include "health_rol_include.c"
+#include "sizemon_rol_include.c"
+#include "evcheck_rol_include.c"
 
 #ifndef SSP_MAROC_SLOT
 #define SSP_MAROC_SLOT 13
@@ -20,11 +32,23 @@
 #define SSP_MPD_SLOT 20
 #endif
 #define SSP_MPD_BANK 10
+#define SSP_MPD_PACKED_BANK (0x100 | SSP_MPD_BANK)
+
+/* Give up waiting for block ready after (us) */
+#ifndef SSP_MPD_READY_TIMEOUT
+#define SSP_MPD_READY_TIMEOUT 10000
+#endif
+ROL_POLL sspMpd_Poll;
+ROL_PACK sspMpd_Pack;
+int sspMpd_MaxWords(); // routine prototype
+static int sspMpd_TimeoutDiag = -1;
+static int sspMpd_Size = -1;
+static int sspMpd_Check = -1;
 
 extern int nSSP;
 extern unsigned int sspA32Base;
 
-int last_soft_err_cnt[32];
+int last_soft_err_cnt[32];   /* at the last health sample, -1: none yet */
 
 /* ssp defs */
 int SSP_READOUT=1;
@@ -67,6 +91,57 @@ sspSetPedSubtractionMode(int enable)
     }
 }
 
+/*
+  Routine to configure the size of the SSP block DMA
+  0 : SSP_MAX_EVENT_LENGTH, terminated by bus error
+  1 : Word count from the SSP event builder (or a prediction from
+      previous blocks when that is not usable)
+*/
+int sspMpdDmaMode = 1;
+static int sspMpdDmaPredict = 0;
+static unsigned int sspMpdDmaExact = 0, sspMpdDmaPredicted = 0,
+  sspMpdDmaShort = 0, sspMpdDmaFull = 0;
+void
+sspMpdSetDmaMode(int mode)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, mode);
+    }
+  else
+    {
+      sspMpdDmaMode = (mode) ? 1 : 0;
+
+      daLogMsg("INFO","Setting SSP DMA Mode (%d)", sspMpdDmaMode);
+    }
+}
+
+/*
+  Routine to configure the number of MPDs set up at the same time in
+  ssp_mpd_setup() (each MPD is on its own SSP fiber)
+  1 : one after the other
+*/
+#ifndef SSP_MPD_SETUP_THREADS
+#define SSP_MPD_SETUP_THREADS 8
+#endif
+int sspMpdSetupThreads = SSP_MPD_SETUP_THREADS;
+void
+sspMpdSetSetupThreads(int nthreads)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, nthreads);
+    }
+  else
+    {
+      sspMpdSetupThreads = (nthreads > 1) ? nthreads : 1;
+
+      daLogMsg("INFO","Setting MPD setup threads (%d)", sspMpdSetupThreads);
+    }
+}
+
 
 /* Buffer to store daLogMsg's */
 int dalma_rval, dalma_tot;
@@ -89,115 +164,242 @@ static char *apvbuffer = NULL;
 static char *errorbuffer = NULL;
 static char *bufp = NULL;
 
+/****************************************
+ *  REGISTER SNAPSHOT
+ ****************************************/
+/*
+  One pass over the status registers of the SSP (event builder), its MPD
+  fibers (link control and status, soft error count), the output
+  buffers and APV status of the active MPDs, into a preallocated, timestamped
+  SSP_MPD_SNAPSHOT.  The registers are read back to back, each once,
+  with nothing formatted in between; the print routines below work from
+  the snapshot alone.
+
+  what (sspMpdSnapFlag) picks the register sets, so a frequent caller
+  (the health monitor) reads only what it uses.  Returns ERROR, quietly,
+  if the SSP is not there.  The caller holds the
+  VME bus lock, if needed, around the capture.
+*/
+enum sspMpdSnapFlag
+  {
+    SSP_MPD_SNAP_EB       = (1<<0),  /* SSP event builder counts */
+    SSP_MPD_SNAP_LINK     = (1<<1),  /* fiber Status, soft error count */
+    SSP_MPD_SNAP_CTRL     = (1<<2),  /* fiber Ctrl, EBCtrl */
+    SSP_MPD_SNAP_OB_FLAGS = (1<<3),  /* MPD evb_fifo_word_count, missed_trigger */
+    SSP_MPD_SNAP_OB       = (1<<4),  /* MPD output buffer, all of it */
+    SSP_MPD_SNAP_APV      = (1<<5),  /* MPD APV status, APVs enabled */
+    SSP_MPD_SNAP_ALL      = 0x3F
+  };
+
+typedef struct
+{
+  unsigned int ctrl, status, ebctrl;
+  int soft;                       /* soft error count, ERROR if not read */
+} SSP_MPD_SNAP_FIBER;
+
+typedef struct
+{
+  unsigned long long time;        /* rolPollNow() at the start, ns */
+  unsigned int duration;          /* of the capture, ns */
+  int id;                         /* SSP slot */
+  unsigned int what;              /* sspMpdSnapFlag */
+  unsigned int fmask;             /* fibers captured */
+  unsigned int eb_block, eb_word, eb_event;
+  SSP_MPD_SNAP_FIBER fiber[SSP_MAX_FIBERS];
+  int nmpd;
+  int mpd_slot[MPD_MAX_BOARDS+1];
+  struct output_buffer_struct ob[MPD_MAX_BOARDS+1];
+  unsigned int apv_status[MPD_MAX_BOARDS+1];
+  unsigned short apv_mask[MPD_MAX_BOARDS+1];
+} SSP_MPD_SNAPSHOT;
+
+/* One for the status printouts, one for the health monitor: they run
+   in different threads */
+static SSP_MPD_SNAPSHOT sspMpdSnap, sspMpdHealthSnap;
+
+/* Capture the register sets in what, of the fibers in fmask (and their
+   MPDs) of the SSP in slot id (0: the first one).  Returns OK or ERROR. */
 int
-sspMpdDalogStatus(int id, unsigned int fmask)
+sspMpdSnapshot(SSP_MPD_SNAPSHOT *s, int id, unsigned int fmask, unsigned int what)
 {
-  MPD_regs *mr;
-  int ifiber=0;
   extern volatile SSP_regs *pSSP[MAX_VME_SLOTS+1];
   extern volatile SSP_MPD_regs *pMPD[MAX_VME_SLOTS+1];
   extern int sspSL[MAX_VME_SLOTS+1];
+  volatile struct output_buffer_struct *ob;
+  struct output_buffer_struct *r;
+  int fiber, k;
+
+  if(id == 0)
+    id = sspSL[0];
+  if((id <= 0) || (id > 21) || (pSSP[id] == NULL))
+    return ERROR;
+  pMPD[id] = (SSP_MPD_regs *)((unsigned long)pSSP[id]);
+
+  s->time = rolPollNow();
+  s->id = id;
+  s->what = what;
+  s->fmask = fmask;
+  s->nmpd = 0;
+
+  if(what & SSP_MPD_SNAP_EB)
+    sspGetEbStatus(id, &s->eb_block, &s->eb_word, &s->eb_event);
+
+  for(fiber = 0; fiber < SSP_MAX_FIBERS; fiber++)
+    {
+      if((fmask & (1 << fiber)) == 0)
+	continue;
 
+      if(what & SSP_MPD_SNAP_CTRL)
+	{
+	  s->fiber[fiber].ctrl   = vmeRead32(&pMPD[id]->MPD[fiber].Ctrl);
+	  s->fiber[fiber].ebctrl = vmeRead32(&pMPD[id]->MPD[fiber].EBCtrl);
+	}
+      if(what & SSP_MPD_SNAP_LINK)
+	{
+	  s->fiber[fiber].status = vmeRead32(&pMPD[id]->MPD[fiber].Status);
+	  s->fiber[fiber].soft   = sspMpdGetSoftErrorCount(id, fiber);
+	}
+    }
 
+  if(what & (SSP_MPD_SNAP_OB | SSP_MPD_SNAP_OB_FLAGS | SSP_MPD_SNAP_APV))
+    {
+      for(k = 0; k < fnMPD; k++) // only active mpd set
+	{
+	  fiber = mpdSlot(k);
+	  if((fiber < 0) || (fiber >= SSP_MAX_FIBERS) || ((fmask & (1 << fiber)) == 0))
+	    continue;
 
-  mr = (MPD_regs *)malloc(32*sizeof(MPD_regs));
-  printf("fmask = 0x%08x\n", fmask);
+	  ob = &MPDp[fiber]->ob_status;
+	  r = &s->ob[s->nmpd];
 
+	  if(what & SSP_MPD_SNAP_APV)
+	    {
+	      s->apv_status[s->nmpd] = mpdRead32(&MPDp[fiber]->apv_status);
+	      s->apv_mask[s->nmpd]   = mpdGetApvEnableMask(fiber);
+	    }
+	  s->mpd_slot[s->nmpd++] = fiber;
+	  if((what & (SSP_MPD_SNAP_OB | SSP_MPD_SNAP_OB_FLAGS)) == 0)
+	    continue;
+
+	  r->evb_fifo_word_count = mpdRead32(&ob->evb_fifo_word_count);
+	  r->missed_trigger      = mpdRead32(&ob->missed_trigger);
+	  if((what & SSP_MPD_SNAP_OB) == 0)
+	    continue;
+
+	  r->block_count           = mpdRead32(&ob->block_count);
+	  r->event_count           = mpdRead32(&ob->event_count);
+	  r->trigger_count         = mpdRead32(&ob->trigger_count);
+	  r->incoming_trigger      = mpdRead32(&ob->incoming_trigger);
+	  r->sdram_fifo_wr_addr    = mpdRead32(&ob->sdram_fifo_wr_addr);
+	  r->sdram_fifo_rd_addr    = mpdRead32(&ob->sdram_fifo_rd_addr);
+	  r->sdram_flag_wc         = mpdRead32(&ob->sdram_flag_wc);
+	  r->output_buffer_flag_wc = mpdRead32(&ob->output_buffer_flag_wc);
+	  r->latched_full          = mpdRead32(&ob->latched_full);
+	}
+    }
+
+  s->duration = rolPollNow() - s->time;
+
+  return OK;
+}
 
-  if(id==0) id=sspSL[0];
-  if((id<=0) || (id>21) || (pSSP[id]==NULL))
+/* Capture for the status printouts, with the VME bus lock held */
+static SSP_MPD_SNAPSHOT *
+sspMpdSnapshotLocked(int id, unsigned int fmask, unsigned int what)
+{
+  int rval;
+
+  vmeBusLock();
+  rval = sspMpdSnapshot(&sspMpdSnap, id, fmask, what);
+  vmeBusUnlock();
+
+  if(rval != OK)
     {
-      printf("%s: ERROR: SSP in slot %d not initialized\n",__FUNCTION__,id);
-      return ERROR;
+      printf("%s: ERROR: SSP in slot %d not initialized\n", __func__, id);
+      return NULL;
     }
 
-  for(ifiber=0; ifiber<32; ifiber++)
+  return &sspMpdSnap;
+}
+
+/* Out with what is in apvbuffer: a daLogMsg, or printed without the
+   newline DALMA_INIT starts it with */
+static void
+sspMpdSnapshotOut(int dalogFlag)
+{
+  if(dalogFlag)
     {
-      pMPD[id] = (SSP_MPD_regs *)((unsigned long)pSSP[id]);
-      mr[ifiber].Ctrl   = vmeRead32(&pMPD[id]->MPD[ifiber].Ctrl);
-      mr[ifiber].Status = vmeRead32(&pMPD[id]->MPD[ifiber].Status);
-      mr[ifiber].EBCtrl = vmeRead32(&pMPD[id]->MPD[ifiber].EBCtrl);
+      DALMA_LOG;
     }
+  else
+    printf("%s", apvbuffer + 1);
+}
+
+/* MPD link status, as the SSP sees it */
+void
+sspMpdSnapshotPrintFibers(const SSP_MPD_SNAPSHOT *s, int dalogFlag)
+{
+  int ifiber, nrow = 0;
+
+  if((s->what & (SSP_MPD_SNAP_LINK | SSP_MPD_SNAP_CTRL)) !=
+     (SSP_MPD_SNAP_LINK | SSP_MPD_SNAP_CTRL))
+    return;
 
   DALMA_INIT;
 
-  DALMA_MSG("                               SSP - Slot %2d\n",id);
+  DALMA_MSG("                               SSP - Slot %2d\n",s->id);
   DALMA_MSG("                           MPD Settings and Status\n\n");
   DALMA_MSG("     Channel   -------ERRORS------     Event\n");
   DALMA_MSG("MPD    Up      HARD   FRAME   SOFT    Builder\n");
   DALMA_MSG("--------------------------------------------------------------------------------\n");
-  DALMA_LOG;
+  sspMpdSnapshotOut(dalogFlag);
 
-  for(ifiber=0; ifiber<32; ifiber++)
+  DALMA_INIT;
+  for(ifiber=0; ifiber<SSP_MAX_FIBERS; ifiber++)
     {
-      if( (ifiber % 16) == 0 )
-	{
-	  DALMA_INIT;
-	}
-
-      if( ((1 << ifiber) & fmask) == 0)
-	{
-	  if( (ifiber % 16) == 15 )
-	    {
-	      DALMA_LOG;
-	    }
+      const SSP_MPD_SNAP_FIBER *f = &s->fiber[ifiber];
 
-	  continue;
-	}
+      if( ((1 << ifiber) & s->fmask) == 0)
+	continue;
 
       DALMA_MSG("%2d    ",ifiber);
 
-      DALMA_MSG("%s      ",(mr[ifiber].Status & MPD_STATUS_CHANNELUP)?" UP ":"DOWN");
+      DALMA_MSG("%s      ",(f->status & MPD_STATUS_CHANNELUP)?" UP ":"DOWN");
 
-      DALMA_MSG("%s    ",(mr[ifiber].Status & MPD_STATUS_HARDERROR)?"ERR":"---");
+      DALMA_MSG("%s    ",(f->status & MPD_STATUS_HARDERROR)?"ERR":"---");
 
-      DALMA_MSG("%s     ",(mr[ifiber].Status & MPD_STATUS_FRAMEERROR)?"ERR":"---");
+      DALMA_MSG("%s     ",(f->status & MPD_STATUS_FRAMEERROR)?"ERR":"---");
 
-      if(mr[ifiber].Status & MPD_STATUS_SOFTERRORS)
+      if(f->status & MPD_STATUS_SOFTERRORS)
 	{
-	  DALMA_MSG("%3d    ",(mr[ifiber].Status & MPD_STATUS_SOFTERRORS)>>8);
+	  DALMA_MSG("%3d    ",(f->status & MPD_STATUS_SOFTERRORS)>>8);
 	}
       else
 	DALMA_MSG("---    ");
 
       DALMA_MSG("%s\n",
-		(mr[ifiber].EBCtrl & MPD_EBCTRL_ENABLE)?"ENABLED ":"DISABLED");
-
+		(f->ebctrl & MPD_EBCTRL_ENABLE)?"ENABLED ":"DISABLED");
 
-      if( (ifiber % 16) == 15 )
+      /* apvbuffer holds 16 rows */
+      if( (++nrow % 16) == 0 )
 	{
-	  DALMA_LOG;
+	  sspMpdSnapshotOut(dalogFlag);
+	  DALMA_INIT;
 	}
     }
 
-  DALMA_LOG;
-
-  if(mr)
-    free(mr);
-
-  return OK;
+  sspMpdSnapshotOut(dalogFlag);
 }
 
-int
-sspDalogEbStatus(int id)
+/* MPD output buffers */
+void
+sspMpdSnapshotPrintOB(const SSP_MPD_SNAPSHOT *s, int dalogFlag)
 {
-  unsigned int blockcnt, wordcnt, eventcnt;
-  int i;
-  int result;
-
-  sspGetEbStatus(id, &blockcnt, &wordcnt, &eventcnt);
-
-  daLogMsg("INFO","\n SSP %2d : Block Count = %d, Word Count = %d, Event Count = %d\n",
-	   id, blockcnt, wordcnt, eventcnt);
-
-  return(0);
-}
-
-
-void sspPrintMPD_OB_STATUS(int dalogFlag){
-  struct output_buffer_struct r;
+  const struct output_buffer_struct *r;
   int k;
-  int rval = 0;
+
+  if((s->what & SSP_MPD_SNAP_OB) == 0)
+    return;
 
   DALMA_INIT;
 
@@ -206,59 +408,54 @@ void sspPrintMPD_OB_STATUS(int dalogFlag){
   DALMA_MSG("         OutFIFO   Full Flags       \n");
   DALMA_MSG("Slot   nWrds  F E    O E C T   Blks    Events     Trigs    Missed  Incoming\n");
   DALMA_MSG("--------------------------------------------------------------------------------\n");
+  sspMpdSnapshotOut(dalogFlag);
 
-  for (k=0;k<fnMPD;k++) { // only active mpd set
-    r.evb_fifo_word_count = mpdRead32(&MPDp[mpdSlot(k)]->ob_status.evb_fifo_word_count);
-    r.block_count = mpdRead32(&MPDp[mpdSlot(k)]->ob_status.block_count);
-    r.event_count = mpdRead32(&MPDp[mpdSlot(k)]->ob_status.event_count);
-    r.trigger_count = mpdRead32(&MPDp[mpdSlot(k)]->ob_status.trigger_count);
-    r.missed_trigger = mpdRead32(&MPDp[mpdSlot(k)]->ob_status.missed_trigger);
-    r.incoming_trigger = mpdRead32(&MPDp[mpdSlot(k)]->ob_status.incoming_trigger);
+  DALMA_INIT;
+  for (k=0;k<s->nmpd;k++) {
+    r = &s->ob[k];
 
-    DALMA_MSG(" %2d     ", mpdSlot(k));
+    DALMA_MSG(" %2d     ", s->mpd_slot[k]);
 
     DALMA_MSG("%4d  ",
-	      r.evb_fifo_word_count & 0xFFFF);
+	      r->evb_fifo_word_count & 0xFFFF);
 
     DALMA_MSG("%d %d    ",
-	      (r.evb_fifo_word_count & (1<<17) ? 1 : 0),
-	      (r.evb_fifo_word_count & (1<<16) ? 1 : 0));
+	      (r->evb_fifo_word_count & (1<<17) ? 1 : 0),
+	      (r->evb_fifo_word_count & (1<<16) ? 1 : 0));
 
     DALMA_MSG("%d %d %d %d    ",
-	      (r.evb_fifo_word_count & (1<<27) ? 1 : 0),
-	      (r.evb_fifo_word_count & (1<<26) ? 1 : 0),
-	      (r.evb_fifo_word_count & (1<<25) ? 1 : 0),
-	      (r.evb_fifo_word_count & (1<<24) ? 1 : 0));
+	      (r->evb_fifo_word_count & (1<<27) ? 1 : 0),
+	      (r->evb_fifo_word_count & (1<<26) ? 1 : 0),
+	      (r->evb_fifo_word_count & (1<<25) ? 1 : 0),
+	      (r->evb_fifo_word_count & (1<<24) ? 1 : 0));
 
     DALMA_MSG("%3d  ",
-	      r.block_count & 0xFF);
+	      r->block_count & 0xFF);
 
     DALMA_MSG("%8d  ",
-	      r.event_count & 0xFFFFFF);
+	      r->event_count & 0xFFFFFF);
 
     DALMA_MSG("%8d  ",
-	      r.trigger_count);
+	      r->trigger_count);
 
     DALMA_MSG("%8d  ",
-	      r.missed_trigger);
+	      r->missed_trigger);
 
     DALMA_MSG("%8d",
-	      r.incoming_trigger);
+	      r->incoming_trigger);
 
     DALMA_MSG("\n");
 
+    /* apvbuffer holds 8 rows */
+    if( (k % 8) == 7 )
+      {
+	sspMpdSnapshotOut(dalogFlag);
+	DALMA_INIT;
+      }
   }
-
-  if(dalogFlag)
-    {
-      DALMA_LOG;
-    }
-  else
-    {
-      printf("%s",apvbuffer);
-      printf("\n");
-    }
-
+  sspMpdSnapshotOut(dalogFlag);
+  if(!dalogFlag)
+    printf("\n");
 
   DALMA_INIT;
 
@@ -266,54 +463,141 @@ void sspPrintMPD_OB_STATUS(int dalogFlag){
   DALMA_MSG("                  FIFO Addr                        Word         Word   APV  PROC\n");
   DALMA_MSG("Slot          WR OK         RD OK     Overrun      Count   F E Count  Full  Full\n");
   DALMA_MSG("--------------------------------------------------------------------------------\n");
+  sspMpdSnapshotOut(dalogFlag);
 
-  for (k=0;k<fnMPD;k++) { // only active mpd set
-
-    r.sdram_flag_wc = mpdRead32(&MPDp[mpdSlot(k)]->ob_status.sdram_flag_wc);
-    r.output_buffer_flag_wc = mpdRead32(&MPDp[mpdSlot(k)]->ob_status.output_buffer_flag_wc);
+  DALMA_INIT;
+  for (k=0;k<s->nmpd;k++) {
+    r = &s->ob[k];
 
-    DALMA_MSG(" %2d    ", mpdSlot(k));
+    DALMA_MSG(" %2d    ", s->mpd_slot[k]);
 
     DALMA_MSG("0x%7x  %d  ",
-	      r.sdram_fifo_wr_addr & 0x1FFFFFF,
-	      (r.sdram_fifo_wr_addr & (1<<31)) ? 1 : 0
+	      r->sdram_fifo_wr_addr & 0x1FFFFFF,
+	      (r->sdram_fifo_wr_addr & (1<<31)) ? 1 : 0
 	      );
 
     DALMA_MSG("0x%7x  %d         ",
-	      r.sdram_fifo_rd_addr & 0x1FFFFFF,
-	      (r.sdram_fifo_rd_addr & (1<<31)) ? 1 : 0
+	      r->sdram_fifo_rd_addr & 0x1FFFFFF,
+	      (r->sdram_fifo_rd_addr & (1<<31)) ? 1 : 0
 	      );
 
     DALMA_MSG("%s  ",
-	      (r.sdram_flag_wc & (1<<31)) ? "YES" : " no"
+	      (r->sdram_flag_wc & (1<<31)) ? "YES" : " no"
 	      );
 
     DALMA_MSG("0x%7x   ",
-	      r.sdram_flag_wc & 0x1FFFFFF
+	      r->sdram_flag_wc & 0x1FFFFFF
 	      );
 
     DALMA_MSG("%d %d  %4d  ",
-	      (r.output_buffer_flag_wc & (1<<31) ) ? 1 : 0,
-	      (r.output_buffer_flag_wc & (1<<30) ) ? 1 : 0,
-	      r.output_buffer_flag_wc & 0x1FFF
+	      (r->output_buffer_flag_wc & (1<<31) ) ? 1 : 0,
+	      (r->output_buffer_flag_wc & (1<<30) ) ? 1 : 0,
+	      r->output_buffer_flag_wc & 0x1FFF
 	      );
 
     DALMA_MSG("0x%8x",
-	      r.latched_full
+	      r->latched_full
 	      );
 
     DALMA_MSG("\n");
+
+    if( (k % 8) == 7 )
+      {
+	sspMpdSnapshotOut(dalogFlag);
+	DALMA_INIT;
+      }
   }
+  sspMpdSnapshotOut(dalogFlag);
+  if(!dalogFlag)
+    printf("\n");
+}
 
-  if(dalogFlag)
-    {
-      DALMA_LOG;
-    }
-  else
-    {
-      printf("%s",apvbuffer);
-      printf("\n");
-    }
+/* APVs of the MPDs: enabled (configuration) and status (register) */
+void
+sspMpdSnapshotPrintApv(const SSP_MPD_SNAPSHOT *s, int dalogFlag)
+{
+  int k;
+
+  if((s->what & SSP_MPD_SNAP_APV) == 0)
+    return;
+
+  DALMA_INIT;
+
+  DALMA_MSG("                                 APV Status\n");
+  DALMA_MSG("Slot   APVs   Enabled     Status\n");
+  DALMA_MSG("--------------------------------------------------------------------------------\n");
+  sspMpdSnapshotOut(dalogFlag);
+
+  DALMA_INIT;
+  for (k=0;k<s->nmpd;k++) {
+    DALMA_MSG(" %2d     %2d    0x%04x  0x%08x\n", s->mpd_slot[k],
+	      __builtin_popcount(s->apv_mask[k]), s->apv_mask[k], s->apv_status[k]);
+
+    /* apvbuffer holds 16 rows */
+    if( (k % 16) == 15 )
+      {
+	sspMpdSnapshotOut(dalogFlag);
+	DALMA_INIT;
+      }
+  }
+  sspMpdSnapshotOut(dalogFlag);
+  if(!dalogFlag)
+    printf("\n");
+}
+
+/* All of it, with the time it was taken */
+void
+sspMpdSnapshotPrint(const SSP_MPD_SNAPSHOT *s, int dalogFlag)
+{
+  printf("%s: SSP %d registers at %.6f s (captured in %.1f us)\n", __func__,
+	 s->id, 1e-9 * s->time, 1e-3 * s->duration);
+  if(s->what & SSP_MPD_SNAP_EB)
+    printf(" SSP %2d : Block Count = %d, Word Count = %d, Event Count = %d\n",
+	   s->id, s->eb_block, s->eb_word, s->eb_event);
+
+  sspMpdSnapshotPrintOB(s, dalogFlag);
+  sspMpdSnapshotPrintApv(s, dalogFlag);
+  sspMpdSnapshotPrintFibers(s, dalogFlag);
+}
+
+int
+sspMpdDalogStatus(int id, unsigned int fmask)
+{
+  SSP_MPD_SNAPSHOT *s;
+
+  printf("fmask = 0x%08x\n", fmask);
+
+  s = sspMpdSnapshotLocked(id, fmask, SSP_MPD_SNAP_LINK | SSP_MPD_SNAP_CTRL);
+  if(s == NULL)
+    return ERROR;
+
+  sspMpdSnapshotPrintFibers(s, 1);
+
+  return OK;
+}
+
+int
+sspDalogEbStatus(int id)
+{
+  unsigned int blockcnt, wordcnt, eventcnt;
+  int i;
+  int result;
+
+  sspGetEbStatus(id, &blockcnt, &wordcnt, &eventcnt);
+
+  daLogMsg("INFO","\n SSP %2d : Block Count = %d, Word Count = %d, Event Count = %d\n",
+	   id, blockcnt, wordcnt, eventcnt);
+
+  return(0);
+}
+
+
+void sspPrintMPD_OB_STATUS(int dalogFlag){
+  SSP_MPD_SNAPSHOT *s;
+
+  s = sspMpdSnapshotLocked(SSP_MPD_SLOT, 0xFFFFFFFF, SSP_MPD_SNAP_OB);
+  if(s)
+    sspMpdSnapshotPrintOB(s, dalogFlag);
 }
 
 
@@ -365,417 +649,2012 @@ void sspPrintBlock(unsigned int *pBuf, int dCnt){
     }
 }
 
-void ssp_mpd_setup()
+/* Setup of one MPD, run by the threads of ssp_mpd_setup() */
+typedef struct
 {
-  static int just_once = 0;
-  if( (just_once++) > 0)
-    return;
+  int id;           /* MPD (SSP fiber) */
+  int status;       /* OK / ERROR: APV reset or configuration failed */
+  int slotError;    /* goes in the error slot mask of the summary */
+  unsigned long long settle_ns;  /* 101 reset to APVs in sync */
+} SSP_MPD_SETUP;
+
+/* Give up waiting for the APVs to settle after the 101 reset (us) */
+#ifndef SSP_MPD_SETTLE_TIMEOUT
+#define SSP_MPD_SETTLE_TIMEOUT 1000000
+#endif
+/* Pause between two checks of the APV sync (us) */
+#define SSP_MPD_SETTLE_PAUSE   1000
+
+static pthread_mutex_t sspMpdSetupPrintLock = PTHREAD_MUTEX_INITIALIZER;
+static SSP_MPD_SETUP *sspMpdSetupList = NULL;
+static int sspMpdSetupNext = 0, sspMpdSetupN = 0;
+
+/* Whole lines only, so the MPDs set up at the same time can be told apart */
+#define MPD_SETUP_MSG(id, fmt, args...) {				\
+    pthread_mutex_lock(&sspMpdSetupPrintLock);				\
+    printf("MPD %2d: " fmt, id, ## args);				\
+    fflush(stdout);							\
+    pthread_mutex_unlock(&sspMpdSetupPrintLock);}
+
+/* Wait until the enabled APVs of an MPD are in frame sync after the
+   101 reset, or SSP_MPD_SETTLE_TIMEOUT.  Returns the time waited (ns),
+   and the APVs still out of sync in *notSynced. */
+static unsigned long long
+sspMpdSettle(int id, unsigned int *notSynced)
+{
+  struct timespec pause = {0, 1000L * SSP_MPD_SETTLE_PAUSE};
+  unsigned long long t0 = rolPollNow(), now;
+  unsigned int pending = mpdGetApvEnableMask(id);
+  int iapv;
 
-  /*****************
-   *   SSP SETUP
-   *****************/
-  sspA32Base = 0x08800000;
-  int iFlag = 0, issp=0;
-  int sspFiberBit = 0;
-  uint32_t sspFiberMaskToInit;
+  while(1)
+    {
+      for(iapv = 0; iapv < 16; iapv++)
+	{
+	  if((pending & (1 << iapv)) && mpdFIFO_IsSynced(id, iapv))
+	    pending &= ~(1 << iapv);
+	}
 
+      now = rolPollNow();
+      if((pending == 0) || ((now - t0) >= 1000ULL * SSP_MPD_SETTLE_TIMEOUT))
+	break;
 
-  if(sspMpdConfigInit("/home/solid/gem-cfg/ssp_config_hallc.cfg") == ERROR)
-    {
-      daLogMsg("ERROR","Error in configuration file");
-      return;
+      nanosleep(&pause, NULL);
     }
 
-  sspMpdConfigLoad();
+  *notSynced = pending;
 
-  if(nSSP <= 0)
-    {
-      extern unsigned int sspAddrList[MAX_VME_SLOTS+1];
+  return now - t0;
+}
+
+/* Memory test, I2C init, APV scan, APV configuration, ADC configuration
+   and 101 reset of one MPD.  The MPD is only reached through its own
+   fiber of the SSP. */
+static void
+sspMpdSetupOne(SSP_MPD_SETUP *m)
+{
+  int i = m->id;
+  int try_cnt = 0;
+  char apvmsg[256];
+  int len;
 
-      sspAddrList[0] = SSP_MAROC_SLOT << 19;
-      sspAddrList[1] = SSP_MPD_SLOT << 19;
+  m->status = OK;
+  m->slotError = 0;
 
-      iFlag = 0xFFFF0000 | SSP_INIT_MODE_VXSLOCAL; // MPD SSP Uses it's local clock
-      iFlag |= SSP_INIT_USE_ADDRLIST;
+  mpdHISTO_MemTest(i);
 
-      sspInit(0, 0, 2, iFlag); /* Scan for, and initialize all SSPs in crate */
-      printf("%s: found %d SSPs (using iFlag=0x%08x)\n",
-	 __func__, nSSP,iFlag);
+ retry:
 
+  MPD_SETUP_MSG(i, "Try initialize I2C\n");
+  if (mpdI2C_Init(i) != OK) {
+    MPD_SETUP_MSG(i, "WRN: I2C fails\n");
+  }
 
-    }
-  else
+  MPD_SETUP_MSG(i, "Try APV discovery and init\n");
+  if (mpdAPV_Scan(i)<=0 && try_cnt < 3 ) { // no apd found, skip next
+    try_cnt++;
+    MPD_SETUP_MSG(i, "failing retrying\n");
+    goto retry;
+  }
+
+  if( try_cnt == 3 )
     {
-      printf("%s: SSPs previously initialized (%d)\n", __func__, nSSP);
-      /* FIXME: Do MPD specific SSP init here... (check clock) */
+      MPD_SETUP_MSG(i, "APV blind scan failed for %d TIMES !!!!\n\n", try_cnt);
+      m->slotError = 1;
     }
 
-  sspMpdFiberReset(SSP_MPD_SLOT);
-  sspMpdFiberLinkReset(SSP_MPD_SLOT, 0xffffffff);
+  MPD_SETUP_MSG(i, " - APV Reset\n");
+  if (mpdI2C_ApvReset(i) != OK)
+    {
+      MPD_SETUP_MSG(i, " * * APV Reset FAILED\n");
+      m->status = ERROR;
+      m->slotError = 1;
+    }
 
+  usleep(10);
+  I2C_SendStop(i);
 
-  sspMpdDisable(SSP_MPD_SLOT, 0xffffffff);
-  sspFiberMaskToInit = mpdGetSSPFiberMask(SSP_MPD_SLOT);
-  printf("sspSlot: %d, mask: 0x%08x", SSP_MPD_SLOT, sspFiberMaskToInit);
 
-  while(sspFiberMaskToInit != 0){
-    if((sspFiberMaskToInit & 0x1) == 1)
-      sspMpdEnable(SSP_MPD_SLOT, 0x1 << sspFiberBit);
-    sspFiberMaskToInit = sspFiberMaskToInit >> 1;
-    ++sspFiberBit;
-  }
+  // board configuration (APV-ADC clocks phase)
+  MPD_SETUP_MSG(i, "Do DELAY setting\n");
+  mpdDELAY25_Set(i, mpdGetAdcClockPhase(i,0), mpdGetAdcClockPhase(i,1));
 
 
-  int build_all_samples = 1;
-  //1 => For pedestal run, will write ADC samples from the APV (i.e. disable zero suppression)
-  //0 => will apply the threshold and peak position logic to decide if data is written to the event (i.e. zero suppression enabled)
+  // apv configuration
+  MPD_SETUP_MSG(i, "Configure %d APVs\n",mpdGetNumberAPV(i));
 
-  int build_debug_headers = 0;
-  //1 => will write extra debugging info headers about the common-mode processing (which APV chip reported data, avg A/B values and counts for each APV)
-  //0 => disables extra debug info headers
-  int enable_cm = 0;
-  //1 => enables the common-mode subtraction logic
-  //0 => disables the common-mode subtraction logic (so raw ADC samples only have the channel offset applied)
-  int noprocessing_prescale = 100;
-  //0 => prescaling disabled (all events are processed)
-  //1-65535 => every Nth event has common-mode subtract and zero suppression disabled
+  int itry, badTry = 0, iapv, error_status = OK;
+  for (itry = 0; itry < 3; itry++)
+    {
+      error_status = OK;
+      badTry = 0;
+      len = 0;
+      apvmsg[0] = 0;
+      for (iapv = 0; iapv < mpdGetNumberAPV(i); iapv++)
+	{
+	  if (mpdAPV_Config(i, iapv) != OK)
+	    {
+	      if(len < (int)sizeof(apvmsg) - 4)
+		len += snprintf(apvmsg + len, sizeof(apvmsg) - len, " %2d", iapv);
+	      error_status = ERROR;
+	      badTry = 1;
+	    }
+	}
+      if(badTry)
+	{
+	  MPD_SETUP_MSG(i, " * * FAILED for APV%s\n", apvmsg);
+	  MPD_SETUP_MSG(i, " ***** APV RESET *****%s\n",
+			(itry < 2) ? " ******** RETRY ********" : "");
+	  mpdI2C_ApvReset(i);
+	}
+      else
+	{
+	  if(itry > 0)
+	    {
+	      MPD_SETUP_MSG(i, " ****** SUCCESS!!!! ******\n");
+	    }
+	  break;
+	}
 
-  sspMpdEbSetFlags(SSP_MPD_SLOT, build_all_samples, build_debug_headers,
-		   enable_cm, noprocessing_prescale);
+    }
 
-  sspEnableBusError(SSP_MPD_SLOT);
+  if(error_status == ERROR)
+    {
+      m->status = ERROR;
+      m->slotError = 1;
+    }
 
-  //char* mpdSlot[10],apvId[10],cModeMin[10],cModeMax[10];
-  int sspSlotID, apvId, cModeMin, cModeMax;
-  int fiberID = -1, last_mpdSlot = -1;
-  //FILE *fcommon   = fopen("/home/sbs-onl/cfg/CommonModeRange.txt","r");
-  //FILE *fcommon   = NULL;
-  FILE *fcommon   = fopen("/home/sbs-onl/cfg/CommonModeRange_747.txt","r");
+  // configure adc on MPD
+  MPD_SETUP_MSG(i, "Configure ADC\n");
+  mpdADS5281_Config(i);
 
-  //valid pedestal file => will load APV offset file and subtract from APV samples
-  //NULL => will load 0's for all APV offsets
-  //FILE *fpedestal = fopen("/home/sbs-onl/cfg/pedestal.txt","r");
-  //FILE *fpedestal = fopen("/home/sbs-onl/cfg/pedestal_test.txt","r");    //Test file with offset set to -1000 in fiber 15, apv 11, channel 10
-  FILE *fpedestal = fopen("/home/sbs-onl/cfg/gem_ped_747.dat","r");//all GEMs
-  //FILE *fpedestal = NULL;
-
-  // Load pedestal & threshold file settings
-  int stripNo;
-  float ped_offset, ped_rms;
-  char buf[10];
-  int i1, i2, i3, n;
-  char *line_ptr = NULL;
-  size_t line_len;
-  fiberID = -1, last_mpdSlot = -1;
-  if((fpedestal==NULL) || (sspPedSubtractionMode == 0)) {
-
-    /* Correct sspPedSubtractionMode if fpedestal == NULL */
-    if(fpedestal==NULL) sspPedSubtractionMode = 0;
-
-    for(fiberID=0; fiberID<16; fiberID++)
-      {
-	for(apvId=0; apvId<15; apvId++)
-          {
-            for(stripNo=0; stripNo<128; stripNo++)
-	      {
-		sspMpdSetApvOffset(SSP_MPD_SLOT, fiberID, apvId, stripNo, 0);
-		sspMpdSetApvThreshold(SSP_MPD_SLOT, fiberID, apvId, stripNo, 0);
-	      }
-          }
-      }
-    printf("no pedestal file or sspPedSubtractionmode == 0\n");
-  }else{
-    printf("trying to read pedestal \n");
+  // configure fir
+  // not implemented yet
 
-    while(!feof(fpedestal))
-      {
-	getline(&line_ptr, &line_len, fpedestal);
-
-	n = sscanf(line_ptr, "%10s %d %d %d", buf, &i1, &i2, &i3);
-	if( (n == 4) && !strcmp("APV", buf))
-          {
-            sspSlotID = i1;
-            fiberID = i2;
-            apvId = i3;
-            continue;
-          }
-
-	n = sscanf(line_ptr, "%d %f %f", &stripNo, &ped_offset, &ped_rms);
-	if( (n == 3) && (SSP_MPD_SLOT == sspSlotID) )
-          {
-	    //            printf("sspSlot: %2d, fiberID: %2d, apvId %2d, stripNo: %3d, ped_offset: %4.0f ped_rms: %4.0f \n", sspSlotID, fiberID, apvId, stripNo, ped_offset, ped_rms);
-            sspMpdSetApvOffset(SSP_MPD_SLOT, fiberID, apvId, stripNo, (int)ped_offset);
-	    sspMpdSetApvThreshold(SSP_MPD_SLOT, fiberID, apvId, stripNo, 5*(int)ped_rms);
-          }
-      }
-    fclose(fpedestal);
-  }
+  // 101 reset on the APV
+  MPD_SETUP_MSG(i, "Do 101 Reset\n");
+  mpdAPV_Reset101(i);
 
-  // Load common-mode file settings
-  if(fcommon==NULL){
-    printf("no commonMode file\n");
-  }else{
-    printf("trying to read commonMode\n");
-    while(fscanf(fcommon, "%d %d %d %d", &fiberID, &apvId, &cModeMin, &cModeMax)==4){
-      printf("fiberID %d %d %d %d \n", fiberID, apvId, cModeMin, cModeMax);
-
-      //	  cModeMin = 200;
-      //	  cModeMax = 800;
-      //	  cModeMin = 0;
-      //	  cModeMax = 4095;
-      sspMpdSetAvg(SSP_MPD_SLOT, fiberID, apvId, cModeMin, cModeMax);
+  // <- MPD+APV initialization ends here, once the APVs are in sync
+  unsigned int notSynced;
+  m->settle_ns = sspMpdSettle(i, &notSynced);
+  if(notSynced)
+    {
+      MPD_SETUP_MSG(i, "WRN: APVs not in sync after %.1f ms (APV mask 0x%04x)\n",
+		    1e-6 * m->settle_ns, notSynced);
+    }
+  else
+    {
+      MPD_SETUP_MSG(i, "APVs in sync after %.1f ms\n", 1e-6 * m->settle_ns);
     }
-    fclose(fcommon);
+}
+
+static void *
+sspMpdSetupThread(void *arg)
+{
+  int k;
+
+  while((k = __atomic_fetch_add(&sspMpdSetupNext, 1, __ATOMIC_RELAXED)) < sspMpdSetupN)
+    sspMpdSetupOne(&sspMpdSetupList[k]);
+
+  return NULL;
+}
+
+/*
+  APV strip offsets and thresholds of the SSP event builder.
+
+  The tables are built in memory (sspMpdPedestalLoad) and written to the
+  SSP (sspMpdPedestalUpload) for the fibers in use only.  What has been
+  written is remembered, and only the strips whose values changed since
+  are written again.
+*/
+#define SSP_MPD_PED_NFIBER 16
+#define SSP_MPD_PED_NAPV   15
+#define SSP_MPD_PED_NCH    128
+static int sspMpdPedOffset[SSP_MPD_PED_NFIBER][SSP_MPD_PED_NAPV][SSP_MPD_PED_NCH];
+static int sspMpdPedThreshold[SSP_MPD_PED_NFIBER][SSP_MPD_PED_NAPV][SSP_MPD_PED_NCH];
+static int sspMpdPedOffsetSSP[SSP_MPD_PED_NFIBER][SSP_MPD_PED_NAPV][SSP_MPD_PED_NCH];
+static int sspMpdPedThresholdSSP[SSP_MPD_PED_NFIBER][SSP_MPD_PED_NAPV][SSP_MPD_PED_NCH];
+static uint32_t sspMpdPedWritten = 0;   /* fibers with tables in the SSP */
+
+/* Text files, and their binary cache (pedcache_rol_include.c) */
+#ifndef SSP_MPD_PEDESTAL_FILE
+#define SSP_MPD_PEDESTAL_FILE   "/home/sbs-onl/cfg/gem_ped_747.dat"
+#endif
+#ifndef SSP_MPD_COMMONMODE_FILE
+#define SSP_MPD_COMMONMODE_FILE "/home/sbs-onl/cfg/CommonModeRange_747.txt"
+#endif
+#ifndef SSP_MPD_PEDESTAL_CACHE
+#define SSP_MPD_PEDESTAL_CACHE  "/home/sbs-onl/cfg/gem_ped_747.cache"
+#endif
+
+/* Fill the tables from the pedestal file (offsets, 5 x rms thresholds),
+   or with 0's if there is no file or pedestal subtraction is disabled */
+void
+sspMpdPedestalLoad(const PED_CACHE *pc)
+{
+  int fiberID, apvId, stripNo;
+
+  memset(sspMpdPedOffset, 0, sizeof(sspMpdPedOffset));
+  memset(sspMpdPedThreshold, 0, sizeof(sspMpdPedThreshold));
 
+  if((pc == NULL) || !pc->hdr.ped.exists || (sspPedSubtractionMode == 0)) {
 
+    /* Correct sspPedSubtractionMode if there is no pedestal file */
+    if((pc == NULL) || !pc->hdr.ped.exists) sspPedSubtractionMode = 0;
+
+    printf("no pedestal file or sspPedSubtractionmode == 0\n");
+    return;
   }
-  sspSoftReset(SSP_MPD_SLOT);
-  sspMigReset(SSP_MPD_SLOT, 1);
-  sspMigReset(SSP_MPD_SLOT, 0);
-  //  sspPrintMigStatus(SSP_MPD_SLOT);
 
-  sspGStatus(0);
-  sspMpdPrintStatus(SSP_MPD_SLOT);
-#ifdef NO_MPD_TEST
-  return;
+  printf("loading pedestal (%d APVs)\n", pc->hdr.napv_ped);
+
+  for(fiberID = 0; fiberID < SSP_MPD_PED_NFIBER; fiberID++)
+    for(apvId = 0; apvId < SSP_MPD_PED_NAPV; apvId++)
+      for(stripNo = 0; stripNo < SSP_MPD_PED_NCH; stripNo++)
+	{
+	  sspMpdPedOffset[fiberID][apvId][stripNo] = pc->offset[fiberID][apvId][stripNo];
+	  sspMpdPedThreshold[fiberID][apvId][stripNo] = 5*pc->rms[fiberID][apvId][stripNo];
+	}
+}
+
+/* Write the tables of the fibers in use to the SSP, skipping the strips
+   already written with the same values */
+int
+sspMpdPedestalUpload()
+{
+  uint32_t fiberMask = mpdGetSSPFiberMask(SSP_MPD_SLOT);
+  unsigned long long t0 = rolPollNow();
+  int fiberID, apvId, stripNo, nwrite = 0, nskip = 0;
+
+  for(fiberID = 0; fiberID < SSP_MPD_PED_NFIBER; fiberID++)
+    {
+      int written = (sspMpdPedWritten & (1 << fiberID)) ? 1 : 0;
+
+      if((fiberMask & (1 << fiberID)) == 0)
+	continue;
+
+      for(apvId = 0; apvId < SSP_MPD_PED_NAPV; apvId++)
+	{
+	  int *off = sspMpdPedOffset[fiberID][apvId];
+	  int *thr = sspMpdPedThreshold[fiberID][apvId];
+	  int *offSSP = sspMpdPedOffsetSSP[fiberID][apvId];
+	  int *thrSSP = sspMpdPedThresholdSSP[fiberID][apvId];
+
+	  for(stripNo = 0; stripNo < SSP_MPD_PED_NCH; stripNo++)
+	    {
+	      if(!written || (off[stripNo] != offSSP[stripNo]))
+		{
+		  sspMpdSetApvOffset(SSP_MPD_SLOT, fiberID, apvId, stripNo, off[stripNo]);
+		  offSSP[stripNo] = off[stripNo];
+		  nwrite++;
+		}
+	      else
+		nskip++;
+
+	      if(!written || (thr[stripNo] != thrSSP[stripNo]))
+		{
+		  sspMpdSetApvThreshold(SSP_MPD_SLOT, fiberID, apvId, stripNo, thr[stripNo]);
+		  thrSSP[stripNo] = thr[stripNo];
+		  nwrite++;
+		}
+	      else
+		nskip++;
+	    }
+	}
+
+      sspMpdPedWritten |= (1 << fiberID);
+    }
+
+  printf("%s: fibers 0x%04x: %d offset/threshold writes (%d unchanged) in %.1f ms\n",
+	 __func__, fiberMask & ((1 << SSP_MPD_PED_NFIBER) - 1),
+	 nwrite, nskip, 1e-6 * (rolPollNow() - t0));
+
+  return nwrite;
+}
+
+/*
+  Pedestals and noise measured in the run, from the MPD data of the
+  pulser triggers of the first sync events (tiSyncEventConfig.pedestal).
+
+  Between sspMpdPedestalStart(evtype) and sspMpdPedestalStop(), the
+  events of the TI trigger block with the pulser event type are picked
+  (sspMpdPedestalSelect, before the readout).  Those of each SSP block
+  read out are decoded and, per fiber / APV / strip, the samples are
+  summed (offset) and, after the common mode of the APV is subtracted,
+  summed and squared (noise).  Strips with a signal (sample range above
+  sspMpdPedHitCut) are left out of that event.  The offsets loaded in
+  the SSP are added back.
+
+  At End, sspMpdPedestalWrite() writes the result, in the pedestal file
+  format read by ssp_mpd_setup(), to SSP_MPD_PEDESTAL_OUT (%d: run number).
+
+  Enable with sspMpdSetPedestalAccumulate(1);
+*/
+#ifndef SSP_MPD_PED_ACCUMULATE
+#define SSP_MPD_PED_ACCUMULATE 0
+#endif
+#ifndef SSP_MPD_PEDESTAL_OUT
+#define SSP_MPD_PEDESTAL_OUT "/home/sbs-onl/cfg/gem_ped_run%d.dat"
 #endif
+int sspMpdPedAccumulate = SSP_MPD_PED_ACCUMULATE;
+int sspMpdPedHitCut = 250;           /* ADC, max - min of the 6 samples */
 
-  /*****************
-   *   MPD SETUP
-   *****************/
-  int rval = OK;
-  unsigned int errSlotMask = 0;
+typedef struct
+{
+  int64_t sum[PED_CACHE_NCH];        /* samples */
+  int64_t dsum[PED_CACHE_NCH];       /* samples - common mode */
+  int64_t dsum2[PED_CACHE_NCH];
+  int32_t n[PED_CACHE_NCH];
+} SSP_MPD_PED_ACC;
+
+static SSP_MPD_PED_ACC *sspMpdPedAcc = NULL;   /* [fiber][apv] */
+static MPD_DECODE *sspMpdPedDecode = NULL;
+static volatile int sspMpdPedActive = 0;
+static unsigned int sspMpdPedNevents = 0;
+static unsigned int sspMpdPedEvtype = 0;      /* TI event type of the pulser triggers */
+static uint64_t sspMpdPedSelect = 0;          /* events of this block with that type */
+
+void
+sspMpdSetPedestalAccumulate(int enable)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, enable);
+    }
+  else
+    {
+      sspMpdPedAccumulate = (enable) ? 1 : 0;
+
+      daLogMsg("INFO","Setting MPD pedestal accumulation (%d)", sspMpdPedAccumulate);
+    }
+}
+
+/* Start accumulating the events with TI event type evtype (at Go, if
+   the run starts with pedestal triggers) */
+void
+sspMpdPedestalStart(int evtype)
+{
+  if(!sspMpdPedAccumulate)
+    return;
 
-  mpdSetPrintDebug(0);
+  if(sspMpdPedAcc == NULL)
+    sspMpdPedAcc = (SSP_MPD_PED_ACC *)
+      malloc(PED_CACHE_NFIBER * PED_CACHE_NAPV * sizeof(SSP_MPD_PED_ACC));
+  if(sspMpdPedDecode == NULL)
+    sspMpdPedDecode = mpdDecodeCreate();
+  if((sspMpdPedAcc == NULL) || (sspMpdPedDecode == NULL))
+    {
+      printf("%s: ERROR: Unable to allocate the accumulators\n", __func__);
+      return;
+    }
 
-  // discover MPDs and initialize memory mapping
+  memset(sspMpdPedAcc, 0, PED_CACHE_NFIBER * PED_CACHE_NAPV * sizeof(SSP_MPD_PED_ACC));
+  sspMpdPedNevents = 0;
+  sspMpdPedEvtype = evtype & 0xFF;
+  sspMpdPedSelect = 0;
+  sspMpdPedActive = 1;
+}
 
-  // In SSP mode, par1(fiber mask) and par3(number of mpds) are not used in mpdInit(par1, par2, par3, par4)
-  // Instead, they come from the configuration file
-  mpdInit(0, 0, 0,
-	  MPD_INIT_SSP_MODE | MPD_INIT_NO_CONFIG_FILE_CHECK);
-  fnMPD = mpdGetNumberMPD();
+/* Stop accumulating (end of the pedestal triggers) */
+void
+sspMpdPedestalStop()
+{
+  sspMpdPedActive = 0;
+}
 
+/* Before the readout of a trigger: the events of the TI trigger block
+   (tiReadTriggerBlock) with the pulser event type */
+static inline void
+sspMpdPedestalSelect(volatile unsigned int *tiblock, int nwords)
+{
+  unsigned int w;
+  int iev, nev, pos = 2;
 
-  //fnMPD = 1;
-  if (fnMPD<=0) { // test all possible vme slot ?
-    printf("ERR: no MPD discovered, cannot continue\n");
+  sspMpdPedSelect = 0;
+  if(!sspMpdPedActive || (nwords < 3))
     return;
-  }
 
-  printf(" MPD discovered = %d\n",fnMPD);
+  nev = tiblock[1] & 0xff;
+  for(iev = 0; (iev < nev) && (iev < 64) && (pos < nwords); iev++)
+    {
+      w = tiblock[pos];
+      if((w >> 24) == sspMpdPedEvtype)
+	sspMpdPedSelect |= 1ULL << iev;
+      pos += (w & 0xffff) + 1;
+    }
+}
+
+/* Add the decoded event of a fiber */
+static void
+sspMpdPedestalAddFiber(MPD_DECODE *d, int fiber)
+{
+  int apv, ch, is, keep, npresent;
+  int32_t cm[6], s1[PED_CACHE_NCH], d1[PED_CACHE_NCH], d2[PED_CACHE_NCH];
+  int32_t lo[PED_CACHE_NCH], hi[PED_CACHE_NCH];
+  uint8_t present[PED_CACHE_NCH];
 
-  // APV configuration on all active MPDs
-  int error_status = OK;
-  int k, i;
-  for (k=0;k<fnMPD;k++) { // only active mpd set
-    i = mpdSlot(k);
+  for(apv = 0; apv < PED_CACHE_NAPV; apv++)
+    {
+      SSP_MPD_PED_ACC *acc = &sspMpdPedAcc[fiber * PED_CACHE_NAPV + apv];
+      int16_t (*x)[PED_CACHE_NCH] = d->adc[fiber][apv];
+      uint64_t *mask = d->present[fiber][apv];
+
+      if((d->apvMask[fiber] & (1 << apv)) == 0)
+	continue;
+
+      npresent = __builtin_popcountll(mask[0]) + __builtin_popcountll(mask[1]);
+      for(ch = 0; ch < PED_CACHE_NCH; ch++)
+	present[ch] = (mask[ch >> 6] >> (ch & 63)) & 1;
+
+      /* common mode of each sample: average over the strips */
+      for(is = 0; is < 6; is++)
+	{
+	  int32_t sum = 0;
+	  for(ch = 0; ch < PED_CACHE_NCH; ch++)
+	    sum += x[is][ch] * present[ch];
+	  cm[is] = sum / npresent;
+	}
+
+      for(ch = 0; ch < PED_CACHE_NCH; ch++)
+	{
+	  s1[ch] = d1[ch] = d2[ch] = 0;
+	  lo[ch] = hi[ch] = x[0][ch];
+	}
+
+      for(is = 0; is < 6; is++)
+	for(ch = 0; ch < PED_CACHE_NCH; ch++)
+	  {
+	    int32_t v = x[is][ch], dv = v - cm[is];
+	    s1[ch] += v;
+	    d1[ch] += dv;
+	    d2[ch] += dv * dv;
+	    lo[ch] = (v < lo[ch]) ? v : lo[ch];
+	    hi[ch] = (v > hi[ch]) ? v : hi[ch];
+	  }
+
+      for(ch = 0; ch < PED_CACHE_NCH; ch++)
+	{
+	  keep = present[ch] && ((hi[ch] - lo[ch]) <= sspMpdPedHitCut);
+	  acc->sum[ch]   += keep * s1[ch];
+	  acc->dsum[ch]  += keep * d1[ch];
+	  acc->dsum2[ch] += keep * d2[ch];
+	  acc->n[ch]     += keep * 6;
+	}
+    }
+}
+
+/* Decode an SSP block (as read) and accumulate its pulser events */
+static void
+sspMpdPedestalAccumulate(volatile unsigned int *data, int nwords)
+{
+  MPD_DECODE *d = sspMpdPedDecode;
+  int pos = 0, fiber, iev;
+
+  for(iev = 0; mpdDecodeNext(d, (const uint32_t *) data, nwords, &pos); iev++)
+    {
+      if((iev >= 64) || !(sspMpdPedSelect & (1ULL << iev)))
+	continue;
+
+      sspMpdPedNevents++;
+      for(fiber = 0; fiber < PED_CACHE_NFIBER; fiber++)
+	if(d->fiberMask & (1u << fiber))
+	  sspMpdPedestalAddFiber(d, fiber);
+    }
+}
+
+/* Write what was accumulated, in the pedestal file format */
+int
+sspMpdPedestalWrite(int runNumber)
+{
+  char fname[256];
+  FILE *f;
+  int fiber, apv, ch, napv = 0;
+  double rms_sum = 0;
+
+  sspMpdPedActive = 0;
+  if(sspMpdPedAcc == NULL || sspMpdPedNevents == 0)
+    return ERROR;
+
+  snprintf(fname, sizeof(fname), SSP_MPD_PEDESTAL_OUT, runNumber);
+  f = fopen(fname, "w");
+  if(f == NULL)
+    {
+      printf("%s: ERROR: Unable to write %s\n", __func__, fname);
+      return ERROR;
+    }
+
+  for(fiber = 0; fiber < PED_CACHE_NFIBER; fiber++)
+    for(apv = 0; apv < PED_CACHE_NAPV; apv++)
+      {
+	SSP_MPD_PED_ACC *acc = &sspMpdPedAcc[fiber * PED_CACHE_NAPV + apv];
+
+	for(ch = 0; ch < PED_CACHE_NCH; ch++)
+	  if(acc->n[ch])
+	    break;
+	if(ch == PED_CACHE_NCH)
+	  continue;
+
+	fprintf(f, "APV %d %d %d\n", SSP_MPD_SLOT, fiber, apv);
+	for(ch = 0; ch < PED_CACHE_NCH; ch++)
+	  {
+	    double mean = 0, rms = 0, dmean;
+
+	    if(acc->n[ch])
+	      {
+		mean = (double) acc->sum[ch] / acc->n[ch];
+		dmean = (double) acc->dsum[ch] / acc->n[ch];
+		rms = (double) acc->dsum2[ch] / acc->n[ch] - dmean * dmean;
+		rms = (rms > 0) ? sqrt(rms) : 0;
+	      }
+	    if(apv < SSP_MPD_PED_NAPV)
+	      mean += sspMpdPedOffsetSSP[fiber][apv][ch];
+
+	    fprintf(f, "%d %.2f %.2f\n", ch, mean, rms);
+	    rms_sum += rms;
+	  }
+	napv++;
+      }
+  fclose(f);
+
+  printf("%s: %u events, %d APVs, average noise %.1f ADC -> %s\n", __func__,
+	 sspMpdPedNevents, napv, (napv) ? rms_sum / (napv * PED_CACHE_NCH) : 0., fname);
+  daLogMsg("INFO","MPD pedestals from %u events written to %s", sspMpdPedNevents, fname);
+
+  return OK;
+}
+
+/*
+  Zero suppression in the ROC, for when the SSP sends all the samples
+  of all the strips (build_all_samples = 1, enable_cm = 0).
 
-    int try_cnt = 0;
+  Each SSP block read out is rewritten in place: per APV, the pedestal
+  (the offsets of the pedestal file not already subtracted in the SSP)
+  and the common mode of each sample are subtracted, and only the
+  strips with a sum of the 6 samples above sspMpdZsNsigma x 6 x rms are
+  kept, in the same data format.  The block trailer word count is
+  updated, and the bank number (code) of the SSP bank is set to
+  SSP_MPD_BANK_ZS.
 
-    mpdHISTO_MemTest(i);
+  The common mode of an APV is the average of the strips inside its
+  range of the common-mode file, or of all strips without one.
 
-  retry:
+  Every sspMpdZsRawPrescale'th block is left as read (0: none).
 
-    printf(" Try initialize I2C mpd in slot %d\n",i);
-    if (mpdI2C_Init(i) != OK) {
-      printf("WRN: I2C fails on MPD %d\n",i);
+  Enable with sspMpdSetZeroSuppression(1, nsigma, rawPrescale);
+*/
+#ifndef SSP_MPD_ZERO_SUPPRESS
+#define SSP_MPD_ZERO_SUPPRESS 0
+#endif
+#define SSP_MPD_BANK_ZS 1
+int sspMpdZeroSuppress = SSP_MPD_ZERO_SUPPRESS;
+float sspMpdZsNsigma = 5.;
+int sspMpdZsRawPrescale = 100;
+
+static int sspMpdZsActive = 0;
+static MPD_DECODE *sspMpdZsDecode = NULL;
+static int16_t sspMpdZsPed[PED_CACHE_NFIBER][PED_CACHE_NAPV][PED_CACHE_NCH];
+static int32_t sspMpdZsThr[PED_CACHE_NFIBER][PED_CACHE_NAPV][PED_CACHE_NCH];
+static int32_t sspMpdZsCmRange[PED_CACHE_NFIBER][PED_CACHE_NAPV][2];
+static unsigned int sspMpdZsBlocks = 0, sspMpdZsRaw = 0;
+static unsigned long long sspMpdZsWordsIn = 0, sspMpdZsWordsOut = 0;
+
+void
+sspMpdSetZeroSuppression(int enable, float nsigma, int rawPrescale)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, enable);
     }
+  else
+    {
+      sspMpdZeroSuppress = (enable) ? 1 : 0;
+      sspMpdZsNsigma = (nsigma > 0) ? nsigma : 0;
+      sspMpdZsRawPrescale = (rawPrescale > 0) ? rawPrescale : 0;
 
-    printf("Try APV discovery and init on MPD slot %d\n",i);
-    if (mpdAPV_Scan(i)<=0 && try_cnt < 3 ) { // no apd found, skip next
-      try_cnt++;
-      printf("failing retrying\n");
-      goto retry;
+      daLogMsg("INFO","Setting MPD zero suppression (%d, %.1f sigma, 1/%d raw)",
+	       sspMpdZeroSuppress, sspMpdZsNsigma, sspMpdZsRawPrescale);
     }
+}
+
+/* Pedestals, thresholds and common-mode ranges, from the pedestal cache
+   (at Prestart, after the offsets are written to the SSP) */
+static void
+sspMpdZsLoad(const PED_CACHE *pc)
+{
+  int fiberID, apvId, stripNo, off;
+
+  sspMpdZsActive = 0;
+  if(!sspMpdZeroSuppress)
+    return;
 
+  if((pc == NULL) || !pc->hdr.ped.exists)
+    {
+      printf("%s: WARN: No pedestal file.  Zero suppression disabled.\n", __func__);
+      daLogMsg("WARN", "No MPD pedestals.  Zero suppression in the ROC disabled");
+      return;
+    }
 
+  if(sspMpdZsDecode == NULL)
+    sspMpdZsDecode = mpdDecodeCreate();
+  if(sspMpdZsDecode == NULL)
+    {
+      printf("%s: ERROR: Unable to allocate the decoder\n", __func__);
+      return;
+    }
 
-    if( try_cnt == 3 )
+  for(fiberID = 0; fiberID < PED_CACHE_NFIBER; fiberID++)
+    for(apvId = 0; apvId < PED_CACHE_NAPV; apvId++)
       {
-	printf("APV blind scan failed for %d TIMES !!!!\n\n", try_cnt);
-	errSlotMask |= (1 << i);
+	for(stripNo = 0; stripNo < PED_CACHE_NCH; stripNo++)
+	  {
+	    off = pc->offset[fiberID][apvId][stripNo];
+	    if(apvId < SSP_MPD_PED_NAPV)
+	      off -= sspMpdPedOffsetSSP[fiberID][apvId][stripNo];
+	    sspMpdZsPed[fiberID][apvId][stripNo] = off;
+	    sspMpdZsThr[fiberID][apvId][stripNo] =
+	      (int32_t)(6 * sspMpdZsNsigma * pc->rms[fiberID][apvId][stripNo]);
+	  }
+
+	if(pc->cm_set[fiberID][apvId])
+	  {
+	    sspMpdZsCmRange[fiberID][apvId][0] = pc->cm_min[fiberID][apvId];
+	    sspMpdZsCmRange[fiberID][apvId][1] = pc->cm_max[fiberID][apvId];
+	  }
+	else
+	  {
+	    sspMpdZsCmRange[fiberID][apvId][0] = -4096;
+	    sspMpdZsCmRange[fiberID][apvId][1] = 4095;
+	  }
       }
 
-    printf(" - APV Reset\n");
-    fflush(stdout);
-    if (mpdI2C_ApvReset(i) != OK)
-      {
-	printf(" * * FAILED\n");
-	error_status = ERROR;
-	errSlotMask |= (1 << i);
-      }
+  sspMpdZsBlocks = sspMpdZsRaw = 0;
+  sspMpdZsWordsIn = sspMpdZsWordsOut = 0;
+  sspMpdZsActive = 1;
+
+  printf("%s: %.1f sigma, 1/%d blocks raw\n", __func__,
+	 sspMpdZsNsigma, sspMpdZsRawPrescale);
+}
+
+/* Pedestal and common mode subtracted strips of a fiber above threshold,
+   written from out.  Returns the number of words written. */
+static int
+sspMpdZsFiber(MPD_DECODE *d, int fiber, volatile unsigned int *out)
+{
+  int apv, ch, is, n = 0;
+  int16_t x[6][PED_CACHE_NCH];
+  int32_t sum[PED_CACHE_NCH], cm[6];
+  uint8_t present[PED_CACHE_NCH];
+
+  for(apv = 0; apv < PED_CACHE_NAPV; apv++)
+    {
+      int16_t (*adc)[PED_CACHE_NCH] = d->adc[fiber][apv];
+      int16_t *ped = sspMpdZsPed[fiber][apv];
+      int32_t *thr = sspMpdZsThr[fiber][apv];
+      int32_t cmMin = sspMpdZsCmRange[fiber][apv][0];
+      int32_t cmMax = sspMpdZsCmRange[fiber][apv][1];
+      uint64_t *mask = d->present[fiber][apv];
+
+      if((d->apvMask[fiber] & (1 << apv)) == 0)
+	continue;
+
+      for(ch = 0; ch < PED_CACHE_NCH; ch++)
+	present[ch] = (mask[ch >> 6] >> (ch & 63)) & 1;
+
+      /* pedestal, and common mode of each sample */
+      for(is = 0; is < 6; is++)
+	{
+	  int32_t s = 0, nin = 0;
+
+	  for(ch = 0; ch < PED_CACHE_NCH; ch++)
+	    {
+	      int32_t v = adc[is][ch] - ped[ch];
+	      int32_t in = present[ch] & (v >= cmMin) & (v <= cmMax);
+	      x[is][ch] = v;
+	      s += in * v;
+	      nin += in;
+	    }
+	  cm[is] = (nin) ? s / nin : 0;
+	}
+
+      for(ch = 0; ch < PED_CACHE_NCH; ch++)
+	sum[ch] = 0;
+
+      for(is = 0; is < 6; is++)
+	for(ch = 0; ch < PED_CACHE_NCH; ch++)
+	  {
+	    int32_t v = x[is][ch] - cm[is];
+	    v = (v < -4096) ? -4096 : ((v > 4095) ? 4095 : v);
+	    x[is][ch] = v;
+	    sum[ch] += v;
+	  }
+
+      for(ch = 0; ch < PED_CACHE_NCH; ch++)
+	{
+	  if(!present[ch] || (sum[ch] <= thr[ch]))
+	    continue;
+
+	  out[n++] = LSWAP(((ch & 0x1F) << 26) | ((x[1][ch] & 0x1FFF) << 13) |
+			   (x[0][ch] & 0x1FFF));
+	  out[n++] = LSWAP((((ch >> 5) & 0x3) << 26) | ((x[3][ch] & 0x1FFF) << 13) |
+			   (x[2][ch] & 0x1FFF));
+	  out[n++] = LSWAP(((apv & 0x1F) << 26) | ((x[5][ch] & 0x1FFF) << 13) |
+			   (x[4][ch] & 0x1FFF));
+	}
+    }
+
+  return n;
+}
+
+/* Zero suppress an SSP block in place.  Returns its new length, and
+   *suppressed = 0 if it was left as read. */
+static int
+sspMpdZsBlock(volatile unsigned int *data, int nwords, int *suppressed)
+{
+  MPD_DECODE *d = sspMpdZsDecode;
+  int pos = 0, start, iw, out = 0, blk = 0, tag = -1;
+  unsigned int val;
+
+  sspMpdZsBlocks++;
+  sspMpdZsWordsIn += nwords;
+  *suppressed = 0;
+
+  if(sspMpdZsRawPrescale && ((sspMpdZsBlocks % sspMpdZsRawPrescale) == 0))
+    {
+      sspMpdZsRaw++;
+      sspMpdZsWordsOut += nwords;
+      return nwords;
+    }
+
+  /* The output never gets ahead of the words still to be read */
+  while(start = pos, mpdDecodeNext(d, (const uint32_t *) data, nwords, &pos))
+    {
+      for(iw = start; iw < pos; iw++)
+	{
+	  val = LSWAP(data[iw]);
+
+	  if(val & 0x80000000)
+	    {
+	      tag = (val >> 27) & 0xf;
+	      if(tag == 0)
+		blk = out;
+	      else if(tag == 1)
+		val = (val & 0xFFC00000) | ((out - blk + 1) & 0x3FFFFF);
+
+	      data[out++] = LSWAP(val);
+
+	      if((tag == 5) && (((val >> 16) & 0x1f) < PED_CACHE_NFIBER))
+		out += sspMpdZsFiber(d, (val >> 16) & 0x1f, &data[out]);
+	    }
+	  else if(tag != 5)
+	    data[out++] = data[iw];
+	}
+    }
+
+  if(out & 1)
+    data[out++] = LSWAP(0xF8000000);
+
+  sspMpdZsWordsOut += out;
+  *suppressed = 1;
+
+  return out;
+}
+
+/*
+  Configuration state, so that a Prestart only redoes what changed since
+  the last one:
+    SSP        : fiber mask (a change means a full setup), event builder flags
+    MPD        : hash of the configuration file and of the library settings
+                 of each MPD.  MPDs with setup errors are always redone.
+    pedestals  : per strip (sspMpdPedestalUpload)
+    common mode: per APV (sspMpdCommonModeUpload)
+  sspMpdRequestFullConfig() makes the next Prestart set up everything
+  from scratch, as the first one does.
+*/
+#ifndef SSP_MPD_CONFIG_FILE
+#define SSP_MPD_CONFIG_FILE "/home/solid/gem-cfg/ssp_config_hallc.cfg"
+#endif
+static int sspMpdCfgValid = 0;
+static uint32_t sspMpdCfgFiberMask = 0, sspMpdCfgEbHash = 0;
+static uint32_t sspMpdCfgMpdHash[MPD_MAX_BOARDS+1];
+static uint32_t sspMpdCfgMpdOK = 0;     /* MPDs set up without errors */
+static int sspMpdCmSSP[PED_CACHE_NFIBER][PED_CACHE_NAPV][3];  /* set, min, max written */
+
+void
+sspMpdRequestFullConfig()
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring request.\n",
+	     __func__);
+    }
+  else
+    {
+      sspMpdCfgValid = 0;
+
+      daLogMsg("INFO","Full SSP/MPD configuration at next Prestart");
+    }
+}
+
+/* Event builder flags, written if changed (or full) */
+static void
+sspMpdEbSetup(int full)
+{
+  int build_all_samples = 1;
+  //1 => For pedestal run, will write ADC samples from the APV (i.e. disable zero suppression)
+  //0 => will apply the threshold and peak position logic to decide if data is written to the event (i.e. zero suppression enabled)
+
+  int build_debug_headers = 0;
+  //1 => will write extra debugging info headers about the common-mode processing (which APV chip reported data, avg A/B values and counts for each APV)
+  //0 => disables extra debug info headers
+  int enable_cm = 0;
+  //1 => enables the common-mode subtraction logic
+  //0 => disables the common-mode subtraction logic (so raw ADC samples only have the channel offset applied)
+  int noprocessing_prescale = 100;
+  //0 => prescaling disabled (all events are processed)
+  //1-65535 => every Nth event has common-mode subtract and zero suppression disabled
+
+  int32_t flags[4] = {build_all_samples, build_debug_headers,
+		      enable_cm, noprocessing_prescale};
+  uint32_t hash = pedCacheHash(PED_CACHE_HASH_INIT, flags, sizeof(flags));
+
+  if(!full && (hash == sspMpdCfgEbHash))
+    return;
+
+  sspMpdEbSetFlags(SSP_MPD_SLOT, build_all_samples, build_debug_headers,
+		   enable_cm, noprocessing_prescale);
+  sspMpdCfgEbHash = hash;
+}
+
+/* Common-mode ranges of the cache, written for the APVs that changed */
+static void
+sspMpdCommonModeUpload(const PED_CACHE *pc, int full)
+{
+  int fiberID, apvId, nwrite = 0;
+
+  if(full)
+    memset(sspMpdCmSSP, 0, sizeof(sspMpdCmSSP));
+
+  if((pc == NULL) || !pc->hdr.cm.exists){
+    printf("no commonMode file\n");
+    return;
+  }
+
+  printf("loading commonMode (%d APVs)\n", pc->hdr.ncm);
+  for(fiberID = 0; fiberID < PED_CACHE_NFIBER; fiberID++)
+    for(apvId = 0; apvId < PED_CACHE_NAPV; apvId++)
+      {
+	int *cm = sspMpdCmSSP[fiberID][apvId];
+
+	if(!pc->cm_set[fiberID][apvId])
+	  continue;
+
+	if(cm[0] && (cm[1] == pc->cm_min[fiberID][apvId]) &&
+	   (cm[2] == pc->cm_max[fiberID][apvId]))
+	  continue;
+
+	printf("fiberID %d %d %d %d \n", fiberID, apvId,
+	       pc->cm_min[fiberID][apvId], pc->cm_max[fiberID][apvId]);
+	sspMpdSetAvg(SSP_MPD_SLOT, fiberID, apvId,
+		     pc->cm_min[fiberID][apvId], pc->cm_max[fiberID][apvId]);
+	cm[0] = 1;
+	cm[1] = pc->cm_min[fiberID][apvId];
+	cm[2] = pc->cm_max[fiberID][apvId];
+	nwrite++;
+      }
+
+  if(!full)
+    printf("%s: %d common-mode ranges changed\n", __func__, nwrite);
+}
+
+/* Settings of an MPD: configuration file, and what the library has for it */
+static uint32_t
+sspMpdConfigHash(int id, uint32_t fileHash)
+{
+  int32_t v[6];
+
+  v[0] = fileHash;
+  v[1] = mpdGetNumberAPV(id);
+  v[2] = mpdGetAdcClockPhase(id, 0);
+  v[3] = mpdGetAdcClockPhase(id, 1);
+  v[4] = mpdGetUseSdram(id);
+  v[5] = mpdGetFastReadout(id);
+
+  return pedCacheHash(PED_CACHE_HASH_INIT, v, sizeof(v));
+}
+
+void ssp_mpd_setup()
+{
+  int full = (sspMpdCfgValid == 0);
+  PED_CACHE_SOURCE cfgFile;
+
+  /*****************
+   *   SSP SETUP
+   *****************/
+  sspA32Base = 0x08800000;
+  int iFlag = 0, issp=0;
+  int sspFiberBit = 0;
+  uint32_t sspFiberMaskToInit;
+
+
+  if(sspMpdConfigInit(SSP_MPD_CONFIG_FILE) == ERROR)
+    {
+      daLogMsg("ERROR","Error in configuration file");
+      return;
+    }
+
+  sspMpdConfigLoad();
+  pedCacheStamp(SSP_MPD_CONFIG_FILE, &cfgFile);
+
+  if(!full && (mpdGetSSPFiberMask(SSP_MPD_SLOT) != sspMpdCfgFiberMask))
+    {
+      printf("%s: SSP fiber mask changed (0x%08x -> 0x%08x)\n", __func__,
+	     sspMpdCfgFiberMask, mpdGetSSPFiberMask(SSP_MPD_SLOT));
+      full = 1;
+    }
+  printf("%s: %s configuration\n", __func__, (full) ? "Full" : "Incremental");
+
+  if(full)
+    {
+      sspMpdCfgValid = 0;
+
+      if(nSSP <= 0)
+	{
+	  extern unsigned int sspAddrList[MAX_VME_SLOTS+1];
+
+	  sspAddrList[0] = SSP_MAROC_SLOT << 19;
+	  sspAddrList[1] = SSP_MPD_SLOT << 19;
+
+	  iFlag = 0xFFFF0000 | SSP_INIT_MODE_VXSLOCAL; // MPD SSP Uses it's local clock
+	  iFlag |= SSP_INIT_USE_ADDRLIST;
+
+	  sspInit(0, 0, 2, iFlag); /* Scan for, and initialize all SSPs in crate */
+	  printf("%s: found %d SSPs (using iFlag=0x%08x)\n",
+		 __func__, nSSP,iFlag);
+
+
+	}
+      else
+	{
+	  printf("%s: SSPs previously initialized (%d)\n", __func__, nSSP);
+	  /* FIXME: Do MPD specific SSP init here... (check clock) */
+	}
+
+      sspMpdFiberReset(SSP_MPD_SLOT);
+      sspMpdFiberLinkReset(SSP_MPD_SLOT, 0xffffffff);
+
+
+      sspMpdDisable(SSP_MPD_SLOT, 0xffffffff);
+      sspFiberMaskToInit = mpdGetSSPFiberMask(SSP_MPD_SLOT);
+      sspMpdCfgFiberMask = sspFiberMaskToInit;
+      printf("sspSlot: %d, mask: 0x%08x\n", SSP_MPD_SLOT, sspFiberMaskToInit);
+
+      while(sspFiberMaskToInit != 0){
+	if((sspFiberMaskToInit & 0x1) == 1)
+	  sspMpdEnable(SSP_MPD_SLOT, 0x1 << sspFiberBit);
+	sspFiberMaskToInit = sspFiberMaskToInit >> 1;
+	++sspFiberBit;
+      }
+    }
+
+  sspMpdEbSetup(full);
+
+  if(full)
+    sspEnableBusError(SSP_MPD_SLOT);
+
+  //valid pedestal file => will load APV offset file and subtract from APV samples
+  //missing => will load 0's for all APV offsets
+  const PED_CACHE *pc = pedCacheOpen(SSP_MPD_PEDESTAL_FILE, SSP_MPD_COMMONMODE_FILE,
+				     SSP_MPD_PEDESTAL_CACHE, SSP_MPD_SLOT);
+
+  // Load pedestal & threshold file settings, and write what changed to the SSP
+  if(full)
+    sspMpdPedWritten = 0;
+  sspMpdPedestalLoad(pc);
+  sspMpdPedestalUpload();
+
+  // Load common-mode file settings
+  sspMpdCommonModeUpload(pc, full);
+  sspMpdZsLoad(pc);
+  pedCacheClose();
+
+  if(full)
+    {
+      sspSoftReset(SSP_MPD_SLOT);
+      sspMigReset(SSP_MPD_SLOT, 1);
+      sspMigReset(SSP_MPD_SLOT, 0);
+      //  sspPrintMigStatus(SSP_MPD_SLOT);
+
+      sspGStatus(0);
+    }
+  sspMpdPrintStatus(SSP_MPD_SLOT);
+#ifdef NO_MPD_TEST
+  sspMpdCfgValid = 1;
+  return;
+#endif
+
+  /*****************
+   *   MPD SETUP
+   *****************/
+  int rval = OK;
+  unsigned int errSlotMask = 0;
+
+  if(full)
+    {
+      mpdSetPrintDebug(0);
+
+      // discover MPDs and initialize memory mapping
+
+      // In SSP mode, par1(fiber mask) and par3(number of mpds) are not used in mpdInit(par1, par2, par3, par4)
+      // Instead, they come from the configuration file
+      mpdInit(0, 0, 0,
+	      MPD_INIT_SSP_MODE | MPD_INIT_NO_CONFIG_FILE_CHECK);
+      fnMPD = mpdGetNumberMPD();
+
+
+      //fnMPD = 1;
+      if (fnMPD<=0) { // test all possible vme slot ?
+	printf("ERR: no MPD discovered, cannot continue\n");
+	return;
+      }
+
+      printf(" MPD discovered = %d\n",fnMPD);
+
+      sspMpdCfgMpdOK = 0;
+    }
+
+  // APV configuration on the MPDs that need it, sspMpdSetupThreads at a time
+  int error_status = OK;
+  int k, n, nthreads;
+  pthread_t *threads;
+  uint32_t hash[MPD_MAX_BOARDS+1];
+
+  sspMpdSetupList = (SSP_MPD_SETUP *) calloc(fnMPD, sizeof(SSP_MPD_SETUP));
+  for (k=0, n=0;k<fnMPD;k++) // only active mpd set
+    {
+      int id = mpdSlot(k);
+
+      hash[k] = sspMpdConfigHash(id, cfgFile.hash);
+      if(!full && (sspMpdCfgMpdOK & (1 << id)) && (hash[k] == sspMpdCfgMpdHash[id]))
+	continue;
+
+      sspMpdSetupList[n++].id = id;
+    }
+  sspMpdSetupN = n;
+  sspMpdSetupNext = 0;
+
+  nthreads = (sspMpdSetupThreads < n) ? sspMpdSetupThreads : n;
+  threads = (pthread_t *) calloc(nthreads + 1, sizeof(pthread_t));
+  printf("%s: Setup of %d of %d MPDs, %d at a time\n", __func__, n, fnMPD, nthreads);
+
+  for (k = 1; k < nthreads; k++)
+    if (pthread_create(&threads[k], NULL, sspMpdSetupThread, NULL) != 0)
+      {
+	printf("%s: WARN: Unable to start setup thread %d\n", __func__, k);
+	break;
+      }
+  nthreads = k;
+
+  /* this thread takes its share too */
+  sspMpdSetupThread(NULL);
+
+  for (k = 1; k < nthreads; k++)
+    pthread_join(threads[k], NULL);
+  free(threads);
+
+  for (k=0;k<n;k++)
+    {
+      int id = sspMpdSetupList[k].id;
+
+      sspMpdCfgMpdOK |= (1 << id);
+      if(sspMpdSetupList[k].status == ERROR)
+	error_status = ERROR;
+      if(sspMpdSetupList[k].slotError)
+	{
+	  errSlotMask |= (1 << id);
+	  sspMpdCfgMpdOK &= ~(1 << id);
+	}
+    }
+  for (k=0;k<fnMPD;k++)
+    sspMpdCfgMpdHash[mpdSlot(k)] = hash[k];
+  free(sspMpdSetupList);
+  sspMpdSetupList = NULL;
+
+  sspMpdCfgValid = 1;
+  //END of MPD configure
+
+  // summary report
+  DALMA_INIT;
+
+  DALMA_MSG("\n");
+  DALMA_MSG("Configured APVs (ADC 15 ... 0)\n");
+
+  int ibit;
+  int impd, id, iapv;
+  for (impd = 0; impd < fnMPD; impd++)
+    {
+      id = mpdSlot(impd);
+
+      if (mpdGetApvEnableMask(id) != 0)
+	{
+	  DALMA_MSG("  MPD %2d : ", id);
+
+	  iapv = 0;
+	  for (ibit = 15; ibit >= 0; ibit--)
+	    {
+	      if (((ibit + 1) % 4) == 0)
+		{
+		  DALMA_MSG(" ");
+		}
+	      if (mpdGetApvEnableMask(id) & (1 << ibit))
+		{
+		  DALMA_MSG("1");
+		  iapv++;
+		}
+	      else
+		{
+		  DALMA_MSG(".");
+		}
+	    }
+	  DALMA_MSG(" (#APV %d)", iapv);
+	  if(errSlotMask & (1 << id))
+	    {
+	      DALMA_MSG(" INIT ERRORS\n");
+	    }
+	  else
+	    {
+	      DALMA_MSG("\n");
+	    }
+	}
+      else
+	{
+	  DALMA_MSG("  MPD %2d :                                INIT ERRORS\n", id);
+	}
+    }
+  DALMA_MSG("\n");
+
+  DALMA_LOG;
+
+
+#ifdef OLDOUTPUT
+  for (impd = 0; impd < fnMPD; impd++)
+    {
+      id = mpdSlot(impd);
+
+      if (mpdGetApvEnableMask(id) != 0)
+	{
+	  printf("  MPD %2d : ", id);
+	  iapv = 0;
+	  for (ibit = 15; ibit >= 0; ibit--)
+	    {
+	      if (((ibit + 1) % 4) == 0)
+		printf(" ");
+	      if (mpdGetApvEnableMask(id) & (1 << ibit))
+		{
+		  printf("1");
+		  iapv++;
+		}
+	      else
+		{
+		  printf(".");
+		}
+	    }
+	  printf(" (#APV %d)\n", iapv);
+	}
+    }
+#endif
+
+  if (error_status != OK)
+    daLogMsg("ERROR", "MPD initialization has errors");
+}
+
+/****************************************
+ *  FIBER HEALTH
+ ****************************************/
+/*
+  Sampled by the health monitor (health_rol_include.c) during the run.
+  For each enabled fiber: the SSP link status (channel up, hard and
+  frame error) and soft error count, and the output buffer of its MPD
+  (FIFO full flag, missed triggers).  The soft error rate is averaged
+  over about 8 samples.
+
+  A warning goes out when the average soft error rate passes
+  sspMpdHealthSoftRate (/s), and when a fiber first shows a hard or frame
+  error, a full output buffer or missed triggers; an error when its link
+  goes down.
+
+  Set with sspMpdSetHealthSoftRate(double rate);
+*/
+#ifndef SSP_MPD_HEALTH_SOFT_RATE
+#define SSP_MPD_HEALTH_SOFT_RATE 1.0
+#endif
+
+enum sspMpdHealthFlag
+  {
+    SSP_MPD_HEALTH_DOWN   = (1<<0),
+    SSP_MPD_HEALTH_HARD   = (1<<1),
+    SSP_MPD_HEALTH_FRAME  = (1<<2),
+    SSP_MPD_HEALTH_SOFT   = (1<<3),
+    SSP_MPD_HEALTH_FULL   = (1<<4),
+    SSP_MPD_HEALTH_MISSED = (1<<5)
+  };
+
+typedef struct
+{
+  unsigned int status;            /* last link status */
+  unsigned int nsample, ndown, nhard, nframe, nfull;
+  unsigned int soft;              /* soft errors, this run */
+  double soft_rate, soft_rate_max;   /* average, /s */
+  int missed_first, missed;       /* missed trigger count at the first / last sample */
+  unsigned int warned;            /* sspMpdHealthFlag, raised and not cleared */
+  unsigned int raised;            /* sspMpdHealthFlag, raised and not written */
+} SSP_MPD_HEALTH;
+
+SSP_MPD_HEALTH sspMpdHealth[32];
+double sspMpdHealthSoftRate = SSP_MPD_HEALTH_SOFT_RATE;
+
+void
+sspMpdSetHealthSoftRate(double rate)
+{
+  sspMpdHealthSoftRate = rate;
+  daLogMsg("INFO","Setting MPD soft error warning rate (%.2f /s)", rate);
+}
+
+/* Raise a warning once, until cleared.  Written by sspMpd_HealthReport */
+#define SSP_MPD_HEALTH_WARN(h, flag) {					\
+    if(!((h)->warned & (flag)))						\
+      {									\
+	(h)->warned |= (flag);						\
+	(h)->raised |= (flag);						\
+      }}
+
+/* One health sample of all enabled fibers, dt seconds after the last */
+void
+sspMpd_HealthSample(double dt)
+{
+  SSP_MPD_SNAPSHOT *s = &sspMpdHealthSnap;
+  int k, fiber, soft;
+  unsigned int status, fifo, missed;
+  SSP_MPD_HEALTH *h;
+
+  /* Called with the VME bus lock held */
+  if(sspMpdSnapshot(s, SSP_MPD_SLOT, mpdGetSSPFiberMask(SSP_MPD_SLOT),
+		    SSP_MPD_SNAP_LINK | SSP_MPD_SNAP_OB_FLAGS) != OK)
+    return;
+
+  /* SSP side, all fibers */
+  for(fiber = 0; fiber < 32; fiber++)
+    {
+      if((s->fmask & (1 << fiber)) == 0)
+	continue;
+      h = &sspMpdHealth[fiber];
+
+      status = s->fiber[fiber].status;
+      soft = s->fiber[fiber].soft;
+      h->status = status;
+      h->nsample++;
+
+      if(!(status & MPD_STATUS_CHANNELUP))
+	{
+	  h->ndown++;
+	  SSP_MPD_HEALTH_WARN(h, SSP_MPD_HEALTH_DOWN);
+	}
+      else
+	h->warned &= ~SSP_MPD_HEALTH_DOWN;
+
+      if(status & MPD_STATUS_HARDERROR)
+	{
+	  h->nhard++;
+	  SSP_MPD_HEALTH_WARN(h, SSP_MPD_HEALTH_HARD);
+	}
+
+      if(status & MPD_STATUS_FRAMEERROR)
+	{
+	  h->nframe++;
+	  SSP_MPD_HEALTH_WARN(h, SSP_MPD_HEALTH_FRAME);
+	}
+
+      /* Soft error trend */
+      if((soft >= 0) && (last_soft_err_cnt[fiber] >= 0) && (dt > 0))
+	{
+	  int dsoft = soft - last_soft_err_cnt[fiber];
+	  if(dsoft < 0)
+	    dsoft = soft;                       /* counter was reset */
+	  h->soft += dsoft;
+	  h->soft_rate += (dsoft / dt - h->soft_rate) / 8.;
+	  if(h->soft_rate > h->soft_rate_max)
+	    h->soft_rate_max = h->soft_rate;
+
+	  if(h->soft_rate > sspMpdHealthSoftRate)
+	    SSP_MPD_HEALTH_WARN(h, SSP_MPD_HEALTH_SOFT);
+	  if(h->soft_rate < 0.5 * sspMpdHealthSoftRate)
+	    h->warned &= ~SSP_MPD_HEALTH_SOFT;
+	}
+      if(soft >= 0)
+	last_soft_err_cnt[fiber] = soft;
+    }
+
+  /* MPD output buffers, through the fibers */
+  for(k = 0; k < s->nmpd; k++)
+    {
+      fiber = s->mpd_slot[k];
+      h = &sspMpdHealth[fiber];
+
+      fifo = s->ob[k].evb_fifo_word_count;
+      missed = s->ob[k].missed_trigger;
+
+      if(fifo & (1<<17))
+	{
+	  h->nfull++;
+	  SSP_MPD_HEALTH_WARN(h, SSP_MPD_HEALTH_FULL);
+	}
+
+      if(h->missed_first < 0)
+	h->missed_first = missed;
+      else if(missed != h->missed)
+	SSP_MPD_HEALTH_WARN(h, SSP_MPD_HEALTH_MISSED);
+      h->missed = missed;
+    }
+}
+
+/* Write the warnings raised by the last sample.  Called by the health
+   monitor after the bus lock is released. */
+void
+sspMpd_HealthReport()
+{
+  int fiber;
+  unsigned int raised;
+  SSP_MPD_HEALTH *h;
+
+  for(fiber = 0; fiber < 32; fiber++)
+    {
+      h = &sspMpdHealth[fiber];
+      raised = h->raised;             /* same thread as the sample */
+      if(raised == 0)
+	continue;
+      h->raised = 0;
+
+      if(raised & SSP_MPD_HEALTH_DOWN)
+	daLogMsg("ERROR", "SSP-MPD fiber %d: link DOWN (%u soft errors this run)",
+		 fiber, h->soft);
+      if(raised & SSP_MPD_HEALTH_HARD)
+	daLogMsg("WARN", "SSP-MPD fiber %d: hard error", fiber);
+      if(raised & SSP_MPD_HEALTH_FRAME)
+	daLogMsg("WARN", "SSP-MPD fiber %d: frame error", fiber);
+      if(raised & SSP_MPD_HEALTH_SOFT)
+	daLogMsg("WARN", "SSP-MPD fiber %d: %.1f soft errors/s (%u this run), link degrading",
+		 fiber, h->soft_rate, h->soft);
+      if(raised & SSP_MPD_HEALTH_FULL)
+	daLogMsg("WARN", "SSP-MPD fiber %d: MPD output buffer full", fiber);
+      if(raised & SSP_MPD_HEALTH_MISSED)
+	daLogMsg("WARN", "SSP-MPD fiber %d: MPD missed %d triggers", fiber,
+		 (int)(h->missed - h->missed_first));
+    }
+}
+
+/* Clear the trends.  Called at Prestart. */
+void
+sspMpd_HealthClear()
+{
+  int fiber;
+
+  memset(sspMpdHealth, 0, sizeof(sspMpdHealth));
+  for(fiber = 0; fiber < 32; fiber++)
+    {
+      sspMpdHealth[fiber].missed_first = -1;
+      last_soft_err_cnt[fiber] = -1;
+    }
+}
+
+void
+sspMpd_HealthStatus()
+{
+  SSP_MPD_HEALTH *h;
+  int fiber;
+
+  printf("%s: Fiber health during the run\n", __func__);
+  printf("  Fiber  Link  Samples  Down  Hard Frame  Full   Soft  Soft/s avg/max   Missed\n");
+  for(fiber = 0; fiber < 32; fiber++)
+    {
+      h = &sspMpdHealth[fiber];
+      if(h->nsample == 0)
+	continue;
+
+      printf("  %5d  %4s  %7u %5u %5u %5u %5u %6u  %6.2f %7.2f %8d%s\n",
+	     fiber, (h->status & MPD_STATUS_CHANNELUP) ? "UP" : "DOWN",
+	     h->nsample, h->ndown, h->nhard, h->nframe, h->nfull, h->soft,
+	     h->soft_rate, h->soft_rate_max,
+	     (h->missed_first >= 0) ? (int)(h->missed - h->missed_first) : 0,
+	     (h->warned) ? "  WARNED" : "");
+    }
+}
+
+static volatile int sspMpdRecoverBusy;
+
+/* Status of MPD and SSP after a readout timeout.
+   Run by the log worker (rolLogDiagRequest), not in the trigger. */
+void
+sspMpd_TimeoutDump()
+{
+  int rval, busy;
+
+  /* The registers all at once, close to the timeout, with the bus held
+     for the capture only (no recovery step in between), then printed */
+  vmeBusLock();
+  rval = sspMpdSnapshot(&sspMpdSnap, SSP_MPD_SLOT, mpdGetSSPFiberMask(SSP_MPD_SLOT),
+			SSP_MPD_SNAP_ALL);
+  busy = __atomic_load_n(&sspMpdRecoverBusy, __ATOMIC_ACQUIRE);
+  vmeBusUnlock();
+
+  if(rval != OK)
+    {
+      printf("%s: ERROR: SSP in slot %d not initialized\n", __func__, SSP_MPD_SLOT);
+      return;
+    }
+
+  if(busy)
+    printf("%s: taken between two steps of an SSP-MPD recovery\n", __func__);
+  sspMpdSnapshotPrint(&sspMpdSnap, 0);
+}
+
+/****************************************
+ *  RECOVERY
+ ****************************************/
+/*
+  In-run recovery from SSP readout timeouts.  A timeout in the readout
+  only notes it (sspMpdRecoverRequest); once the trigger is done with
+  all modules and the sync event checks, the SSP and its MPDs are handed
+  to the recovery thread (sspMpdRecoverKick, at the end of rocTrigger).
+  The next trigger waits for it to finish (sspMpdRecoverWait, at the
+  start of rocTrigger), so the TI holds busy meanwhile.  Each step is
+  time bounded, and takes the VME bus lock for itself only.  A step that fails
+  goes on to the next one, and so does a timeout before
+  SSP_MPD_RECOVER_GOOD blocks were read after the last recovery:
+
+    1 drain     wait up to SSP_MPD_RECOVER_DRAIN_MS for the late block
+                and discard the SSP blocks up to the event that timed
+                out.  The first block of a later event is kept for its
+                trigger.  Fails if a fiber is down, or if no block came
+                for the triggers the TI took meanwhile.
+    2 link      fiber link reset, and wait up to SSP_MPD_RECOVER_LINK_MS
+                for the links to come up
+    3 re-arm    per MPD: DAQ disable, acquisition mode, pedestals and
+                thresholds, DAQ enable and 101 reset, and wait for the
+                APVs to sync (SSP_MPD_SETTLE_TIMEOUT)
+    4 run stop  stop the TI triggers (block limit) and ask for the run
+                to be ended
+
+  After a link reset or a re-arm, what is left in the SSP is discarded,
+  and the triggers the TI took before it get an empty SSP-MPD bank.
+
+  Event numbers are those of the SSP event headers (22 bits), against
+  the TI block count and the block level.
+
+  Set with sspMpdSetRecoverLevel(int level);   last step, 0: no recovery
+*/
+#ifndef SSP_MPD_RECOVER_LEVEL
+#define SSP_MPD_RECOVER_LEVEL     4
+#endif
+#define SSP_MPD_RECOVER_DRAIN_MS  200
+#define SSP_MPD_RECOVER_LINK_MS   1000
+#define SSP_MPD_RECOVER_GOOD      16
+#define SSP_MPD_RECOVER_WAIT_MS   5000   /* complain if a trigger waits longer */
+#define SSP_MPD_RECOVER_PAUSE_US  100
+
+enum sspMpdRecoverStep
+  {
+    SSP_MPD_RECOVER_NONE  = 0,
+    SSP_MPD_RECOVER_DRAIN = 1,
+    SSP_MPD_RECOVER_LINK  = 2,
+    SSP_MPD_RECOVER_REARM = 3,
+    SSP_MPD_RECOVER_STOP  = 4,
+    SSP_MPD_RECOVER_NSTEP
+  };
+
+static const char *sspMpdRecoverName[SSP_MPD_RECOVER_NSTEP] =
+  { "none", "drain", "link reset", "re-arm", "run stop" };
+
+int sspMpdRecoverLevel = SSP_MPD_RECOVER_LEVEL;
+static int sspMpdBlockLevel = 1;
+
+static pthread_t sspMpdRecoverThread;
+static pthread_mutex_t sspMpdRecoverLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sspMpdRecoverCond = PTHREAD_COND_INITIALIZER;
+static int sspMpdRecoverRunning = 0;
+static int sspMpdRecoverStep = SSP_MPD_RECOVER_NONE;   /* requested */
+static int sspMpdRecoverPending = SSP_MPD_RECOVER_NONE; /* noted in this trigger */
+static volatile int sspMpdRecoverBusy = 0;     /* requested or in progress */
+static volatile int sspMpdRecoverHeld = 0;     /* skip or stash, for the readout */
+static int sspMpdRecoverStopped = 0;
+static unsigned int sspMpdRecoverEvent;        /* last event of the block that timed out */
+static int sspMpdRecoverLast = SSP_MPD_RECOVER_NONE;
+static unsigned int sspMpdRecoverGood = 0;     /* blocks read since */
+
+/* Triggers up to this event get an empty bank */
+static int sspMpdRecoverSkip = 0;
+static unsigned int sspMpdRecoverSkipTo;
+
+/* A block of a later event, read while draining */
+static unsigned int *sspMpdStash = NULL;
+static int sspMpdStashSize = 0, sspMpdStashWords = 0;
+static unsigned int sspMpdStashEvent;
+
+static SSP_MPD_SNAPSHOT sspMpdRecoverSnap;
+
+/* per-run statistics */
+static unsigned int sspMpdRecoverN[SSP_MPD_RECOVER_NSTEP], sspMpdRecoverFail[SSP_MPD_RECOVER_NSTEP];
+static unsigned int sspMpdRecoverDrained = 0, sspMpdRecoverSkipped = 0, sspMpdRecoverLost = 0;
+static unsigned int sspMpdRecoverNrun = 0, sspMpdRecoverWaits = 0;
+static unsigned long long sspMpdRecoverTime_sum = 0, sspMpdRecoverTime_max = 0;
+
+int sspMpdReadBlock(volatile unsigned int *data, int maxwords);
+int sspMpd_Ready();
+
+void
+sspMpdSetRecoverLevel(int level)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, level);
+    }
+  else
+    {
+      sspMpdRecoverLevel = (level < 0) ? 0 :
+	(level > SSP_MPD_RECOVER_STOP) ? SSP_MPD_RECOVER_STOP : level;
+
+      daLogMsg("INFO","Setting SSP-MPD recovery level (%d: %s)", sspMpdRecoverLevel,
+	       sspMpdRecoverName[sspMpdRecoverLevel]);
+    }
+}
+
+/* a - b, for 22 bit event numbers */
+static inline int
+sspMpdEventDiff(unsigned int a, unsigned int b)
+{
+  return ((int)((a - b) << 10)) >> 10;
+}
+
+/* First event of the current trigger's block */
+static inline unsigned int
+sspMpdTriggerEvent()
+{
+  return ((tiGetIntCount() - 1) * sspMpdBlockLevel + 1) & 0x3FFFFF;
+}
+
+/* First event of an SSP block (as read), -1 if there is no event header */
+static int
+sspMpdBlockEvent(volatile unsigned int *data, int nwords)
+{
+  unsigned int word;
+  int i;
+
+  for(i = 0; (i < nwords) && (i < 4); i++)
+    {
+      word = LSWAP(data[i]);
+      if((word & 0xF8000000) == 0x90000000)
+	return word & 0x3FFFFF;
+    }
+
+  return -1;
+}
+
+static void
+sspMpdRecoverPause()
+{
+  struct timespec ts = {0, 1000L * SSP_MPD_RECOVER_PAUSE_US};
+  nanosleep(&ts, NULL);
+}
+
+/* Enabled fibers with their link down, 0 if none */
+static unsigned int
+sspMpdRecoverLinksDown()
+{
+  SSP_MPD_SNAPSHOT *s = &sspMpdRecoverSnap;
+  unsigned int down = 0;
+  int fiber;
+
+  if(sspMpdSnapshot(s, SSP_MPD_SLOT, mpdGetSSPFiberMask(SSP_MPD_SLOT),
+		    SSP_MPD_SNAP_LINK) != OK)
+    return 0xFFFFFFFF;
+
+  for(fiber = 0; fiber < SSP_MAX_FIBERS; fiber++)
+    if((s->fmask & (1 << fiber)) && !(s->fiber[fiber].status & MPD_STATUS_CHANNELUP))
+      down |= (1 << fiber);
+
+  return down;
+}
+
+/* Read the SSP blocks there are until deadline (ns), discarding those up
+   to event.  With keep, stops at the first block of a later event (left
+   in the stash), and returns 1 then. */
+static int
+sspMpdRecoverDrain(unsigned int event, unsigned long long deadline, int keep)
+{
+  int n, ev;
+
+  vmeDmaConfig(2,5,1);
+  while(1)
+    {
+      if(sspBReady(SSP_MPD_SLOT))
+	{
+	  n = sspMpdReadBlock(sspMpdStash, sspMpdStashSize);
+	  ev = sspMpdBlockEvent(sspMpdStash, n);
+	  if(keep && (ev >= 0) && (sspMpdEventDiff(ev, event) > 0))
+	    {
+	      sspMpdStashWords = n;
+	      sspMpdStashEvent = ev;
+	      return 1;
+	    }
+	  sspMpdRecoverDrained++;
+	  continue;
+	}
+
+      if(rolPollNow() >= deadline)
+	return 0;
+      sspMpdRecoverPause();
+    }
+}
+
+/* After a reset: what the SSP had is stale, and the triggers the TI
+   took before it will not get their block */
+static void
+sspMpdRecoverFlush(unsigned int event)
+{
+  int pending = tiBReady();
+
+  sspMpdRecoverDrain(event, rolPollNow(), 0);
+  sspMpdStashWords = 0;
+
+  if(pending > 0)
+    {
+      sspMpdRecoverSkip = 1;
+      sspMpdRecoverSkipTo = (event + pending * sspMpdBlockLevel) & 0x3FFFFF;
+    }
+}
+
+/* One recovery step.  Returns 1 if it went through. */
+static int
+sspMpdRecoverDo(int step, unsigned int event)
+{
+  unsigned long long t0 = rolPollNow(), deadline;
+  unsigned int down, notSynced, fmask = mpdGetSSPFiberMask(SSP_MPD_SLOT);
+  int k, ok = 1;
+
+  switch(step)
+    {
+    case SSP_MPD_RECOVER_DRAIN:
+      if(sspMpdRecoverLinksDown())
+	return 0;
+      if(sspMpdRecoverDrain(event, t0 + 1000000ULL * SSP_MPD_RECOVER_DRAIN_MS, 1))
+	return 1;
+      /* Nothing for the triggers taken meanwhile */
+      return (tiBReady() == 0);
+
+    case SSP_MPD_RECOVER_LINK:
+      sspMpdFiberLinkReset(SSP_MPD_SLOT, fmask);
+      deadline = t0 + 1000000ULL * SSP_MPD_RECOVER_LINK_MS;
+      while((down = sspMpdRecoverLinksDown()) && (rolPollNow() < deadline))
+	sspMpdRecoverPause();
+      sspMpdRecoverFlush(event);
+      if(down)
+	daLogMsg("ERROR", "SSP-MPD recovery: fibers 0x%08x still down", down);
+      return (down == 0);
+
+    case SSP_MPD_RECOVER_REARM:
+      for(k = 0; k < fnMPD; k++)
+	mpdDAQ_Disable(mpdSlot(k));
+      for(k = 0; k < fnMPD; k++)
+	{
+	  mpdSetAcqMode(mpdSlot(k), "process");
+	  mpdPEDTHR_Write(mpdSlot(k));
+	  mpdDAQ_Enable(mpdSlot(k));
+	  mpdAPV_Reset101(mpdSlot(k));
+	}
+      for(k = 0; k < fnMPD; k++)
+	{
+	  sspMpdSettle(mpdSlot(k), &notSynced);
+	  if(notSynced)
+	    {
+	      daLogMsg("ERROR", "SSP-MPD recovery: MPD %d APVs 0x%04x not in sync",
+		       mpdSlot(k), notSynced);
+	      ok = 0;
+	    }
+	}
+      sspMpdRecoverFlush(event);
+      return ok;
+
+    case SSP_MPD_RECOVER_STOP:
+      tiSetBlockLimit(1);
+      sspMpdRecoverStopped = 1;
+      return 1;
+    }
+
+  return 0;
+}
+
+static void *
+sspMpdRecoverWorker(void *arg)
+{
+  unsigned long long t0, dt;
+  unsigned int event;
+  int step, ok;
+
+  pthread_mutex_lock(&sspMpdRecoverLock);
+  while(1)
+    {
+      while(sspMpdRecoverRunning && (sspMpdRecoverStep == SSP_MPD_RECOVER_NONE))
+	pthread_cond_wait(&sspMpdRecoverCond, &sspMpdRecoverLock);
+      if(!sspMpdRecoverRunning)
+	break;
+      step = sspMpdRecoverStep;
+      event = sspMpdRecoverEvent;
+      pthread_mutex_unlock(&sspMpdRecoverLock);
+
+      t0 = rolPollNow();
+      while(1)
+	{
+	  /* The bus is let go between steps */
+	  vmeBusLock();
+	  ok = sspMpdRecoverDo(step, event);
+	  vmeBusUnlock();
+
+	  sspMpdRecoverN[step]++;
+	  if(!ok)
+	    sspMpdRecoverFail[step]++;
+	  daLogMsg((ok) ? "WARN" : "ERROR", "SSP-MPD recovery at event %u: %s %s",
+		   event, sspMpdRecoverName[step], (ok) ? "done" : "FAILED");
+	  if(ok || (step >= sspMpdRecoverLevel))
+	    break;
+	  step++;
+	}
+
+      if(step == SSP_MPD_RECOVER_STOP)
+	daLogMsg("ERROR", "SSP-MPD recovery failed.  Triggers stopped, end the run.");
+
+      dt = rolPollNow() - t0;
+      sspMpdRecoverNrun++;
+      sspMpdRecoverTime_sum += dt;
+      if(dt > sspMpdRecoverTime_max)
+	sspMpdRecoverTime_max = dt;
+
+      pthread_mutex_lock(&sspMpdRecoverLock);
+      sspMpdRecoverLast = step;
+      sspMpdRecoverGood = 0;
+      sspMpdRecoverHeld = sspMpdRecoverSkip || (sspMpdStashWords > 0);
+      sspMpdRecoverStep = SSP_MPD_RECOVER_NONE;
+      __atomic_store_n(&sspMpdRecoverBusy, 0, __ATOMIC_RELEASE);
+      pthread_cond_broadcast(&sspMpdRecoverCond);
+    }
+  pthread_mutex_unlock(&sspMpdRecoverLock);
+
+  return NULL;
+}
+
+/* From the readout: the SSP timed out on the current block.  Only
+   noted, the recovery starts with sspMpdRecoverKick(). */
+static void
+sspMpdRecoverRequest()
+{
+  int step = SSP_MPD_RECOVER_DRAIN;
+
+  if(!sspMpdRecoverRunning || sspMpdRecoverStopped)
+    return;
 
-    usleep(10);
-    I2C_SendStop(i);
+  /* The last recovery did not do it */
+  if(sspMpdRecoverLast && (sspMpdRecoverGood < SSP_MPD_RECOVER_GOOD))
+    step = sspMpdRecoverLast + 1;
+  if(step > sspMpdRecoverLevel)
+    step = sspMpdRecoverLevel;
 
+  sspMpdRecoverEvent = (sspMpdTriggerEvent() + sspMpdBlockLevel - 1) & 0x3FFFFF;
+  sspMpdRecoverPending = step;
+}
 
-    // board configuration (APV-ADC clocks phase)
-    printf("Do DELAY setting on MPD slot %d\n",i);
-    mpdDELAY25_Set(i, mpdGetAdcClockPhase(i,0), mpdGetAdcClockPhase(i,1));
+/* At the end of a trigger, after all modules and the sync event checks:
+   start the recovery noted by the readout */
+void
+sspMpdRecoverKick()
+{
+  if(sspMpdRecoverPending == SSP_MPD_RECOVER_NONE)
+    return;
 
+  pthread_mutex_lock(&sspMpdRecoverLock);
+  sspMpdRecoverStep = sspMpdRecoverPending;
+  sspMpdRecoverBusy = 1;
+  pthread_cond_broadcast(&sspMpdRecoverCond);
+  pthread_mutex_unlock(&sspMpdRecoverLock);
 
+  sspMpdRecoverPending = SSP_MPD_RECOVER_NONE;
+}
 
-    // apv configuration
-    printf("Configure %d APVs on MPD slot %d\n",mpdGetNumberAPV(i),i);
+/* At the start of a trigger: wait for a recovery in progress */
+void
+sspMpdRecoverWait()
+{
+  struct timespec ts;
+  int waited = 0;
 
+  if(!__atomic_load_n(&sspMpdRecoverBusy, __ATOMIC_ACQUIRE))
+    return;
 
-    // apv configuration
-    mpdSetPrintDebug(0);
-    printf(" - Configure Individual APVs\n");
-    printf(" - - ");
-    fflush(stdout);
-    int itry, badTry = 0, iapv, saveError = error_status;
-    error_status = OK;
-    for (itry = 0; itry < 3; itry++)
-      {
-	if(badTry)
-	  {
-	    printf(" ******** RETRY ********\n");
-	    printf(" - - ");
-	    fflush(stdout);
-	    error_status = OK;
-	  }
-	badTry = 0;
-	for (iapv = 0; iapv < mpdGetNumberAPV(i); iapv++)
-	  {
-	    printf("%2d ", iapv);
-	    fflush(stdout);
+  sspMpdRecoverWaits++;
+  pthread_mutex_lock(&sspMpdRecoverLock);
+  while(sspMpdRecoverBusy)
+    {
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_sec += SSP_MPD_RECOVER_WAIT_MS / 1000;
+      if((pthread_cond_timedwait(&sspMpdRecoverCond, &sspMpdRecoverLock, &ts) == ETIMEDOUT) &&
+	 !waited++)
+	rolLog(ROL_LOG_ERROR, "SSP-MPD recovery: trigger held more than %ld ms\n",
+	       SSP_MPD_RECOVER_WAIT_MS);
+    }
+  pthread_mutex_unlock(&sspMpdRecoverLock);
+}
 
-	    if (mpdAPV_Config(i, iapv) != OK)
-	      {
-		printf(" * * FAILED for APV %2d\n", iapv);
-		if(iapv < (mpdGetNumberAPV(i) - 1))
-		  printf(" - - ");
-		fflush(stdout);
-		error_status = ERROR;
-		badTry = 1;
-	      }
-	  }
-	printf("\n");
-	fflush(stdout);
-	if(badTry)
-	  {
-	    printf(" ***** APV RESET *****\n");
-	    fflush(stdout);
-	    mpdI2C_ApvReset(i);
-	  }
-	else
-	  {
-	    if(itry > 0)
-	      {
-		printf(" ****** SUCCESS!!!! ******\n");
-		fflush(stdout);
-	      }
-	    break;
-	  }
+/* For the readout of a trigger after a recovery: words of the block it
+   left for this trigger, 0 for an empty bank, or -1 to read the SSP
+   (*ready: once the SSP has the block) */
+static int
+sspMpdRecoverRead(volatile unsigned int *data, int *ready)
+{
+  unsigned int event = sspMpdTriggerEvent();
+  int diff;
 
-      }
+  if(sspMpdRecoverSkip)
+    {
+      if(sspMpdEventDiff(event + sspMpdBlockLevel - 1, sspMpdRecoverSkipTo) <= 0)
+	{
+	  sspMpdRecoverSkipped++;
+	  return 0;
+	}
+      sspMpdRecoverSkip = 0;
+    }
 
-    error_status |= saveError;
+  if(sspMpdStashWords > 0)
+    {
+      diff = sspMpdEventDiff(sspMpdStashEvent, event);
+      if(diff > 0)
+	{
+	  /* the block of this trigger never came */
+	  sspMpdRecoverLost++;
+	  return 0;
+	}
 
-    if(error_status == ERROR)
-      errSlotMask |= (1 << i);
+      sspMpdRecoverHeld = 0;
+      if((diff == 0) && (rolBufLimit(sspMpdStashWords) == sspMpdStashWords))
+	{
+	  diff = sspMpdStashWords;
+	  sspMpdStashWords = 0;
+	  memcpy((void *)data, sspMpdStash, diff << 2);
+	  return diff;
+	}
 
-    // configure adc on MPD
-    printf("Configure ADC on MPD slot %d\n",i);
-    mpdADS5281_Config(i);
+      sspMpdStashWords = 0;
+      sspMpdRecoverDrained++;
+      if(diff == 0)
+	return 0;
+    }
 
-    // configure fir
-    // not implemented yet
+  /* sspMpd_Ready did not check the SSP for this one */
+  sspMpdRecoverHeld = 0;
+  *ready = rolPollWait(&sspMpd_Poll, sspMpd_Ready);
+  return -1;
+}
 
-    // 101 reset on the APV
-    printf("Do 101 Reset on MPD slot %d\n",i);
-    mpdAPV_Reset101(i);
+/* A block read for a trigger, of a later event: the block of this trigger
+   never came, without a timeout since the next one was there.  Keep it in
+   the stash for its own trigger.  Returns 1 then, for an empty bank. */
+static int
+sspMpdRecoverAhead(volatile unsigned int *data, int nwords)
+{
+  int ev;
 
-    // <- MPD+APV initialization ends here
-    sleep(1);
-  } // end loop on mpds
-  //END of MPD configure
+  if((sspMpdRecoverLevel == SSP_MPD_RECOVER_NONE) || (sspMpdStash == NULL) ||
+     (nwords <= 0) || (nwords > sspMpdStashSize))
+    return 0;
 
-  // summary report
-  DALMA_INIT;
+  ev = sspMpdBlockEvent(data, nwords);
+  if((ev < 0) || (sspMpdEventDiff(ev, sspMpdTriggerEvent()) <= 0))
+    return 0;
 
-  DALMA_MSG("\n");
-  DALMA_MSG("Configured APVs (ADC 15 ... 0)\n");
+  memcpy(sspMpdStash, (void *)data, nwords << 2);
+  sspMpdStashWords = nwords;
+  sspMpdStashEvent = ev;
+  sspMpdRecoverLost++;
+  sspMpdRecoverHeld = 1;
 
-  int ibit;
-  int impd, id, iapv;
-  for (impd = 0; impd < fnMPD; impd++)
-    {
-      id = mpdSlot(impd);
+  return 1;
+}
 
-      if (mpdGetApvEnableMask(id) != 0)
-	{
-	  DALMA_MSG("  MPD %2d : ", id);
+/* Start the recovery thread.  Called at Go. */
+static void
+sspMpdRecoverStart(int blocklevel)
+{
+  int words = SSP_MAX_EVENT_LENGTH >> 2;
+
+  memset(sspMpdRecoverN, 0, sizeof(sspMpdRecoverN));
+  memset(sspMpdRecoverFail, 0, sizeof(sspMpdRecoverFail));
+  sspMpdRecoverDrained = sspMpdRecoverSkipped = sspMpdRecoverLost = 0;
+  sspMpdRecoverNrun = sspMpdRecoverWaits = 0;
+  sspMpdRecoverTime_sum = sspMpdRecoverTime_max = 0;
+  sspMpdRecoverLast = sspMpdRecoverPending = SSP_MPD_RECOVER_NONE;
+  sspMpdRecoverSkip = sspMpdStashWords = sspMpdRecoverHeld = 0;
+  sspMpdRecoverStep = SSP_MPD_RECOVER_NONE;
+  sspMpdRecoverBusy = 0;
+  sspMpdBlockLevel = (blocklevel > 0) ? blocklevel : 1;
+
+  if(sspMpdRecoverRunning || (sspMpdRecoverLevel == 0))
+    return;
 
-	  iapv = 0;
-	  for (ibit = 15; ibit >= 0; ibit--)
-	    {
-	      if (((ibit + 1) % 4) == 0)
-		{
-		  DALMA_MSG(" ");
-		}
-	      if (mpdGetApvEnableMask(id) & (1 << ibit))
-		{
-		  DALMA_MSG("1");
-		  iapv++;
-		}
-	      else
-		{
-		  DALMA_MSG(".");
-		}
-	    }
-	  DALMA_MSG(" (#APV %d)", iapv);
-	  if(errSlotMask & (1 << id))
-	    {
-	      DALMA_MSG(" INIT ERRORS\n");
-	    }
-	  else
-	    {
-	      DALMA_MSG("\n");
-	    }
-	}
-      else
+  if(sspMpdStashSize < words)
+    {
+      if(sspMpdStash)
+	free(sspMpdStash);
+      sspMpdStash = (unsigned int *) malloc(words * sizeof(unsigned int));
+      sspMpdStashSize = (sspMpdStash) ? words : 0;
+      if(sspMpdStash == NULL)
 	{
-	  DALMA_MSG("  MPD %2d :                                INIT ERRORS\n", id);
+	  printf("%s: ERROR: Unable to allocate the recovery buffer\n", __func__);
+	  return;
 	}
     }
-  DALMA_MSG("\n");
 
-  DALMA_LOG;
+  sspMpdRecoverRunning = 1;
+  if(pthread_create(&sspMpdRecoverThread, NULL, sspMpdRecoverWorker, NULL) != 0)
+    {
+      printf("%s: ERROR: Unable to start the recovery thread\n", __func__);
+      sspMpdRecoverRunning = 0;
+    }
+}
 
+/* Stop the recovery thread, after the step in progress.  Called at End. */
+static void
+sspMpdRecoverStop()
+{
+  if(!sspMpdRecoverRunning)
+    return;
 
-#ifdef OLDOUTPUT
-  for (impd = 0; impd < fnMPD; impd++)
-    {
-      id = mpdSlot(impd);
+  pthread_mutex_lock(&sspMpdRecoverLock);
+  sspMpdRecoverRunning = 0;
+  pthread_cond_broadcast(&sspMpdRecoverCond);
+  pthread_mutex_unlock(&sspMpdRecoverLock);
+  pthread_join(sspMpdRecoverThread, NULL);
+  sspMpdRecoverBusy = 0;
+}
 
-      if (mpdGetApvEnableMask(id) != 0)
-	{
-	  printf("  MPD %2d : ", id);
-	  iapv = 0;
-	  for (ibit = 15; ibit >= 0; ibit--)
-	    {
-	      if (((ibit + 1) % 4) == 0)
-		printf(" ");
-	      if (mpdGetApvEnableMask(id) & (1 << ibit))
-		{
-		  printf("1");
-		  iapv++;
-		}
-	      else
-		{
-		  printf(".");
-		}
-	    }
-	  printf(" (#APV %d)\n", iapv);
-	}
-    }
-#endif
+/* Triggers stopped by the last run's recovery: on again.  Called at Prestart. */
+static void
+sspMpdRecoverClear()
+{
+  if(sspMpdRecoverStopped)
+    tiSetBlockLimit(0);
+  sspMpdRecoverStopped = 0;
+}
 
-  if (error_status != OK)
-    daLogMsg("ERROR", "MPD initialization has errors");
+static void
+sspMpdRecoverStatus()
+{
+  int step;
+
+  if(sspMpdRecoverNrun == 0)
+    return;
+
+  printf("%s: %u recoveries (up to %s), %.1f / %.1f ms avg/max, %u triggers held\n",
+	 __func__, sspMpdRecoverNrun, sspMpdRecoverName[sspMpdRecoverLevel],
+	 1e-6 * sspMpdRecoverTime_sum / sspMpdRecoverNrun, 1e-6 * sspMpdRecoverTime_max,
+	 sspMpdRecoverWaits);
+  for(step = SSP_MPD_RECOVER_DRAIN; step < SSP_MPD_RECOVER_NSTEP; step++)
+    if(sspMpdRecoverN[step])
+      printf("  %-10s %6u (%u failed)\n", sspMpdRecoverName[step],
+	     sspMpdRecoverN[step], sspMpdRecoverFail[step]);
+  printf("  %u blocks discarded, %u triggers with an empty bank after a reset, "
+	 "%u blocks missing\n",
+	 sspMpdRecoverDrained, sspMpdRecoverSkipped, sspMpdRecoverLost);
+  if(sspMpdRecoverStopped)
+    printf("  Triggers stopped\n");
 }
 
 /****************************************
@@ -786,6 +2665,13 @@ sspMpd_Download(char *configFilename)
 {
   printf("%s: Build date/time %s/%s\n", __func__, __DATE__, __TIME__);
 
+  rolPollInit(&sspMpd_Poll, "SSP-MPD", SSP_MPD_READY_TIMEOUT);
+  rolPackInit(&sspMpd_Pack, "SSP-MPD", ROL_PACK_MPD);
+  sspMpd_TimeoutDiag = rolLogDiagRegister("SSP-MPD timeout status", sspMpd_TimeoutDump);
+  rolHealthRegister("SSP-MPD fibers", sspMpd_HealthSample, sspMpd_HealthReport);
+  sspMpd_Size = rolSizeRegister("SSP-MPD");
+  sspMpd_Check = rolCheckRegister("SSP-MPD");
+
   /* Check usrString for pedestal subtraction mode */
   if(strcmp("SSPPedSub",rol->usrString) == 0)
     {
@@ -830,8 +2716,8 @@ sspMpd_Prestart()
 
   // Setup in Prestart since TI 125MHz clock is used by SSP (it glitches at end of Download())
   ssp_mpd_setup();
-  for(i=0;i<sizeof(last_soft_err_cnt)/sizeof(last_soft_err_cnt[0]);i++)
-    last_soft_err_cnt[i] = -1;
+  sspMpd_HealthClear();
+  sspMpdRecoverClear();
 
   printf("%s: done\n", __func__);
 }
@@ -844,6 +2730,8 @@ sspMpd_Go()
 {
   int UseSdram, FastReadout;
 
+  rolPollClear(&sspMpd_Poll);
+
   /* Enable modules, if needed, here */
   //  sspMpdMonEnable(0,7);
   /*Enable MPD*/
@@ -870,13 +2758,16 @@ sspMpd_Go()
 
 
   /* Get the current block level */
-  uint32_t BLOCKLEVEL = tiGetCurrentBlockLevel();
+  uint32_t blocklevel = tiGetCurrentBlockLevel();
   int32_t issp;
   for(issp=0; issp<nSSP; issp++)
     {
-      sspSetBlockLevel(sspSlot(issp),BLOCKLEVEL);
+      sspSetBlockLevel(sspSlot(issp),blocklevel);
     }
-  SSP_MAX_EVENT_LENGTH = 32000 * 12 * BLOCKLEVEL;     // update SSP readout size
+  SSP_MAX_EVENT_LENGTH = 32000 * 12 * blocklevel;     // update SSP readout size
+  rolPackGo(&sspMpd_Pack, sspMpd_MaxWords());
+  sspMpdDmaPredict = 0;
+  sspMpdDmaExact = sspMpdDmaPredicted = sspMpdDmaShort = sspMpdDmaFull = 0;
 
 
   //sspSoftReset(0);
@@ -885,6 +2776,8 @@ sspMpd_Go()
   sspMpdDalogStatus(SSP_MPD_SLOT, mpdGetSSPFiberMask(SSP_MPD_SLOT));
   /* Use this info to change block level is all modules */
 
+  sspMpdRecoverStart(blocklevel);
+
 }
 
 /****************************************
@@ -895,11 +2788,28 @@ sspMpd_End()
 {
   //mpd close
   int k;
+
+  sspMpdRecoverStop();
   for (k=0;k<fnMPD;k++) { // only active mpd set
     mpdTRIG_Disable(mpdSlot(k));
   }
   //mpd close
 
+  printf("%s: SSP block DMA: %u from word count, %u predicted, %u maximum, %u short\n",
+	 __func__, sspMpdDmaExact, sspMpdDmaPredicted, sspMpdDmaFull, sspMpdDmaShort);
+
+  if(sspMpdPedAccumulate)
+    sspMpdPedestalWrite(rol->runNumber);
+
+  if(sspMpdZsActive)
+    printf("%s: zero suppression: %u blocks (%u raw), %llu -> %llu words (%.1f%%)\n",
+	   __func__, sspMpdZsBlocks, sspMpdZsRaw, sspMpdZsWordsIn, sspMpdZsWordsOut,
+	   (sspMpdZsWordsIn) ? 100. * sspMpdZsWordsOut / sspMpdZsWordsIn : 0.);
+
+  rolPackStatus(&sspMpd_Pack);
+  sspMpd_HealthStatus();
+  sspMpdRecoverStatus();
+
   printf("%s: done\n", __func__);
 
 }
@@ -908,39 +2818,110 @@ sspMpd_End()
 /****************************************
  *  TRIGGER
  ****************************************/
-void
-sspMpd_Trigger(int arg)
+/*
+  Read one block from the SSP, up to maxwords.  The DMA is sized from the
+  event builder word count when exactly one block is waiting, otherwise
+  from the size of recent blocks.  If the block trailer did not come with
+  it (stale count, short prediction) the rest is read with a maximum size
+  DMA.
+*/
+int
+sspMpdReadBlock(volatile unsigned int *data, int maxwords)
+{
+  uint32_t bc = 0, wc = 0, ec = 0;
+  int nwords, dCnt, rval, target;
+
+  if(sspMpdDmaMode == 0)
+    {
+      sspMpdDmaFull++;
+      return sspReadBlock(SSP_MPD_SLOT, data, maxwords, 1);
+    }
+
+  sspGetEbStatus(SSP_MPD_SLOT, &bc, &wc, &ec);
+  if((bc == 1) && (wc > 0) && (wc <= maxwords))
+    {
+      nwords = wc;
+      sspMpdDmaExact++;
+    }
+  else if(sspMpdDmaPredict > 0)
+    {
+      nwords = sspMpdDmaPredict;
+      sspMpdDmaPredicted++;
+    }
+  else
+    {
+      nwords = maxwords;
+      sspMpdDmaFull++;
+    }
+
+  /* 64 bit transfers */
+  nwords = (nwords + 1) & ~1;
+  if(nwords > maxwords)
+    nwords = maxwords;
+
+  dCnt = sspReadBlock(SSP_MPD_SLOT, data, nwords, 1);
+  if(dCnt <= 0)
+    return dCnt;
+
+  if((dCnt == nwords) && (nwords < maxwords) &&
+     !rolBufBlockComplete(data, dCnt))
+    {
+      sspMpdDmaShort++;
+      rval = sspReadBlock(SSP_MPD_SLOT, &data[dCnt], maxwords - dCnt, 1);
+      if(rval > 0)
+	dCnt += rval;
+    }
+
+  /* Follow the block size up immediately, and down slowly */
+  target = dCnt + (dCnt >> 3);
+  if(target > sspMpdDmaPredict)
+    sspMpdDmaPredict = target;
+  else
+    sspMpdDmaPredict -= (sspMpdDmaPredict - target) >> 6;
+
+  return dCnt;
+}
+
+/* Readiness checks that found no block, since the last readout */
+static int sspMpd_npoll = 0;
+
+/* Non-blocking check for a block ready in the SSP */
+int
+sspMpd_Ready()
+{
+  if(sspMpdRecoverHeld || sspBReady(SSP_MPD_SLOT))
+    return 1;
+
+  sspMpd_npoll++;
+#ifdef DEBUG_TIMEOUT
+  sspPrintEbStatus(SSP_MPD_SLOT);
+#endif
+  return 0;
+}
+
+/* Readout the SSP MPD bank.  ready = 0 if the block was never ready. */
+int
+sspMpd_Readout(int arg, int ready)
 {
   static int evt = 1;
-  static int16_t words_expected = -1;
-  int sync_flag = tiGetSyncEventFlag();
 #ifdef LOUD_MPD_READOUT
   printf("*** This is start of event %d\n", evt);
 #endif
 
-  int dCnt;
-  int ssp_timeout;
+  int dCnt, maxwords, truncated = 0;
+  int ssp_timeout = sspMpd_npoll;
   uint32_t bc, wc, ec;
   static int tcnt = 0;
   int count;
   int do_soft_err;
-  static int errorCount = 0;
+  volatile unsigned int *start = dma_dabufp;
+
+  sspMpd_npoll = 0;
 
   vmeDmaConfig(2,5,1);
   /* Readout SSP */
   BANKOPEN(SSP_MPD_BANK, BT_UI4, 0);
 
-  ssp_timeout=0;
-  int ssp_timeout_max=10000;
-
-  while ((sspBReady(SSP_MPD_SLOT)==0) && (ssp_timeout<ssp_timeout_max))
-    {
-      ssp_timeout++;
-#ifdef DEBUG_TIMEOUT
-      sspPrintEbStatus(SSP_MPD_SLOT);
-#endif
-    }
-
 #ifdef DEBUG_BREADY
   sspPrintEbStatus(SSP_MPD_SLOT);
 #endif
@@ -948,23 +2929,28 @@ sspMpd_Trigger(int arg)
   int i;
   int xb_debug;
 
-  if (ssp_timeout == ssp_timeout_max )
+  dCnt = (sspMpdRecoverHeld) ? sspMpdRecoverRead(dma_dabufp, &ready) : -1;
+  if(dCnt >= 0)
+    {
+      /* Left by a recovery */
+      if(dCnt > 0)
+	{
+	  rolSizeAdd(sspMpd_Size, dCnt, 1);
+	  rolCheckBlock(sspMpd_Check, dma_dabufp, dCnt);
+	}
+      dma_dabufp += dCnt;
+    }
+  else if (!ready)
     {
-      printf("*** SSP TIMEOUT ***\n ");
-      daLogMsg("ERROR","SSP Timeout");
+      rolLog(ROL_LOG_ERROR, "SSP Timeout\n");
+      rolSizeAdd(sspMpd_Size, 0, 0);
 
 
       // sspMpdFiberReset(SSP_MPD_SLOT);
       //sspSoftReset(SSP_MPD_SLOT);
 
-      printf("*** Status of MPD and SSP before reset ***\n");
-      sspMpdPrintStatus(SSP_MPD_SLOT);
-      sspPrintMPD_OB_STATUS(0);
-      sspMpdDalogStatus(SSP_MPD_SLOT, mpdGetSSPFiberMask(SSP_MPD_SLOT));
-      printf("xb_debug mpdGStatus============================================\n");
-      mpdGStatus(1);
-      printf("xb_debug sspPrintEbStatus============================================\n");
-      sspPrintEbStatus(SSP_MPD_SLOT);
+      /* Status of MPD and SSP, dumped by the log worker */
+      rolLogDiagRequest(sspMpd_TimeoutDiag);
       //printf("xb_debug sspPrintScalers(0)============================================\n");
       //sspPrintScalers(SSP_MPD_SLOT);
       //printf("xb_debug sspStatus(0, 1)============================================\n");
@@ -975,66 +2961,17 @@ sspMpd_Trigger(int arg)
       //      sspMpdMonDump(SSP_MPD_SLOT,7);
       //      printf("*** sspMpdMonDump() ends\n");
       //vmeDmaConfig(2,5,1);
-      printf("Trying to read w/e there are in ssp...\n");
+      /* Read w/e there are in ssp */
       sspGetEbStatus(SSP_MPD_SLOT, &bc, &wc, &ec);
-      dCnt = sspReadBlock(SSP_MPD_SLOT, dma_dabufp, wc,1);
-      unsigned int *pBuf = (unsigned int *)dma_dabufp;
-      printf("dCnt read: %d\n", dCnt);
+      dCnt = sspReadBlock(SSP_MPD_SLOT, dma_dabufp, rolBufLimit(wc),1);
+      rolLog(ROL_LOG_PRINT, "SSP Timeout: %ld words read (EB: %ld blocks, %ld words)\n",
+	     dCnt, bc, wc);
       if(dCnt > 0)
 	dma_dabufp += dCnt;
 
-      tcnt++;
-      if(!(tcnt & 0x3ff))
-	printf("tcnt = %u, EV Header: %u, MPD HDR = %u\n", tcnt&0xFFF, LSWAP(pBuf[1])&0xFFF, LSWAP(pBuf[5])&0xFFF);
-
-      //      sspPrintBlock(pBuf, dCnt);
-      errorCount++;
-      /* printf("*** Press Enter to start reset procedure***\n"); */
-      /* getchar(); */
-      /*
-	sspMpdFiberReset(SSP_MPD_SLOT);
-	//tiSetBlockLimit(1);
-
-	printf("*** Invoking sspMpdFiberReset()***\n");
-	sspMpdFiberReset(SSP_MPD_SLOT);
-	printf("*** Invoking sspSoftReset() (tempararily skipped for testing)***\n");
-	// sspSoftReset(SSP_MPD_SLOT);
-
-	int i_re, k_re;
-	printf("*** Invoking MPD resets***\n");
-	for(k_re=0;k_re<fnMPD;k_re++)
-	{
-	i_re = mpdSlot(k_re);
-	mpdDAQ_Disable(i_re);
-	}
-	usleep(100);
-	for(k_re=0;k_re<fnMPD;k_re++)
-	{
-	i_re = mpdSlot(k_re);
-	// mpd latest configuration before trigger is enabled
-	mpdSetAcqMode(i_re, "process");
-
-	// load pedestal and thr default values
-	mpdPEDTHR_Write(i_re);
-
-	// enable acq
-	mpdDAQ_Enable(i_re);
-
-	printf("Do 101 Reset on MPD slot %d\n",i);
-	mpdAPV_Reset101(i_re);
-	}
-
-	//sspSoftReset(SSP_MPD_SLOT);
-
-
-	printf("\n\n*** Status of MPD and SSP after reset ***\n");
-	sspPrintMPD_OB_STATUS();
-	sspMpdPrintStatus(SSP_MPD_SLOT);
-	mpdGStatus(1);
-	sspPrintEbStatus(SSP_MPD_SLOT);
-	printf("*** Reset done!!! press enter to continue...*** \n ");
-	getchar();
-      */
+      /* Drain, and reset the fibers or MPDs if it comes to that, before
+	 the next trigger */
+      sspMpdRecoverRequest();
     }
   else
     {
@@ -1042,7 +2979,18 @@ sspMpd_Trigger(int arg)
       printf("***This event doesn't have timeout, but printing data for checking\n");
       sspPrintEbStatus(SSP_MPD_SLOT);
 #endif
-      dCnt = sspReadBlock(SSP_MPD_SLOT, dma_dabufp, SSP_MAX_EVENT_LENGTH>>2,1);
+      maxwords = rolBufLimit(SSP_MAX_EVENT_LENGTH >> 2);
+      dCnt = sspMpdReadBlock(dma_dabufp, maxwords);
+      truncated = rolBufShort(dma_dabufp, dCnt, maxwords, SSP_MAX_EVENT_LENGTH >> 2);
+      if(truncated)
+	rolLog(ROL_LOG_ERROR, "SSP : block truncated at %ld words\n", dCnt);
+      else if(sspMpdRecoverAhead(dma_dabufp, dCnt))
+	dCnt = 0;
+      else
+	{
+	  rolSizeAdd(sspMpd_Size, dCnt, 1);
+	  rolCheckBlock(sspMpd_Check, dma_dabufp, dCnt);
+	}
 #ifdef LOUD_MPD_READOUT
       unsigned int *pBuf = (unsigned int *)dma_dabufp;
       tcnt++;
@@ -1060,6 +3008,18 @@ sspMpd_Trigger(int arg)
 #endif
       if(SSP_READOUT)
 	{
+	  /* a truncated block is kept as read */
+	  if(sspMpdPedActive && sspMpdPedSelect && (dCnt > 0) && !truncated)
+	    sspMpdPedestalAccumulate(dma_dabufp, dCnt);
+
+	  if(sspMpdZsActive && (dCnt > 0) && !truncated)
+	    {
+	      int suppressed;
+	      dCnt = sspMpdZsBlock(dma_dabufp, dCnt, &suppressed);
+	      if(suppressed)
+		start[1] |= SSP_MPD_BANK_ZS;
+	    }
+
 	  dma_dabufp += dCnt;
 	}
       else
@@ -1067,38 +3027,13 @@ sspMpd_Trigger(int arg)
 	  *dma_dabufp++ = LSWAP(ssp_timeout);
 	}
 
-      if(evt < 5) {
-      }else if(words_expected == -1){
-	words_expected = dCnt;
-      }else{
-	if(dCnt != words_expected){
-	  //          char c = 'n';
-	  //          time_t t;
-	  //         FILE *f = fopen("/home/daq/ssp_failure.txt", "wt");
-	  //          time(&t);
-	  //          fprintf(f, "failed @ %s\n", ctime(&t));
-	  //          fclose(f);
-	  //	  printf("***unexpected count of words\n");
-	  //	  printf("***printing data:\n");
-	  //	  sspPrintBlock(pBuf, dCnt);
-	  //	  printf("*** Dumping ssp mpd monitor sspMpdMonDump()\n");
-	  //          sspMpdMonDump(0,7);
-	  //	  printf("*** sspMpdMonDump() ends\n");
-	  //	  printf("***printing status...\n");
-	  //	  sspPrintMPD_OB_STATUS();
-	  //	  sspMpdPrintStatus(0);
-	  //	  mpdGStatus(1);
-	  //	  sspPrintEbStatus(0);
-	  //	  printf("Continue? ");
-	  //          while(c != 'y')
-	  //            scanf("%c", &c);
+      if(sspMpdRecoverHeld)
+	{
+	  rolLog(ROL_LOG_ERROR, "SSP : block of a later event, kept for its trigger\n");
 	}
-      }
-
-      if(dCnt<=0)
+      else if(dCnt<=0)
 	{
-	  daLogMsg("ERROR","SSP : No data or error");
-	  printf("No data or error.  dCnt = %d\n",dCnt);
+	  rolLog(ROL_LOG_ERROR, "SSP : No data or error.  dCnt = %ld\n", dCnt);
 	  // tiSetBlockLimit(1); ---danning comment for the following try on resetting mpd
 	  //---------trying to reset mpd ---danning
 
@@ -1114,6 +3049,7 @@ sspMpd_Trigger(int arg)
 	{
 	  //comment next line to disable GEM data
 	  //dma_dabufp += dCnt;
+	  sspMpdRecoverGood++;
 	}
 
 
@@ -1144,39 +3080,73 @@ sspMpd_Trigger(int arg)
 
   //  sspMpdMonEnable(0,7);
 
+  if(rolPackEnable)
+    dma_dabufp = rolPackBank(&sspMpd_Pack, (unsigned int *) start, dma_dabufp,
+			     SSP_MPD_PACKED_BANK);
+
   BANKCLOSE;
 
-  /* Sync Event checks.   Modules should not have any more data here */
-  if(sync_flag)
-    {
+  return (dma_dabufp - start);
+}
+
+/* Largest SSP MPD bank, in words, for the block level of this run */
+int
+sspMpd_MaxWords()
+{
+  return (SSP_MAX_EVENT_LENGTH >> 2) + 2;
+}
+
+/* Read out a block not wanted for this trigger, or the rest of a
+   truncated block, to dma_dabufp (not kept) */
+int
+sspMpd_Discard()
+{
+  sspMpd_npoll = 0;
+
+  vmeDmaConfig(2,5,1);
+  return sspMpdReadBlock(dma_dabufp, SSP_MAX_EVENT_LENGTH >> 2);
+}
+
+/* Sync Event checks.   Modules should not have any more data here */
+void
+sspMpd_SyncCheck()
+{
+  uint32_t bc, wc, ec;
+
 #ifdef DEBUG_SYNC_CHECK
-      printf("%s: (%d) Sync Event check\n",
-	     __func__, tiGetIntCount());
+  printf("%s: (%d) Sync Event check\n",
+	 __func__, tiGetIntCount());
 #endif
-      sspGetEbStatus(SSP_MPD_SLOT, &bc, &wc, &ec);
-      if( (bc > 0) )//|| (wc > 0) || (ec > 0))
-	{
-	  printf("%s: Error at sync event\n",
-		 __func__);
-	  sspPrintEbStatus(SSP_MPD_SLOT);
-	}
-      int bready = sspBReady(SSP_MPD_SLOT);
-      if (bready > 0)
-	{
-	  printf("%s: Error at sync event\n",
-		 __func__);
-	  printf("   SSP blocks ready = %d\n",
-		 bready);
-	}
-
+  sspGetEbStatus(SSP_MPD_SLOT, &bc, &wc, &ec);
+  if( (bc > 0) )//|| (wc > 0) || (ec > 0))
+    {
+      rolLog(ROL_LOG_PRINT, "sspMpd_SyncCheck: Error at sync event"
+	     " (EB: %ld blocks, %ld words, %ld events)\n", bc, wc, ec);
     }
-
-  if(errorCount > 10)
+  int bready = sspBReady(SSP_MPD_SLOT);
+  if (bready > 0)
     {
-      //printf("errorCount = %d.   Too many errors.  Stopping TI triggers\n",errorCount);
-      //tiSetBlockLimit(1); //  original
+      rolLog(ROL_LOG_PRINT, "sspMpd_SyncCheck: Error at sync event\n"
+	     "   SSP blocks ready = %ld\n", bready);
     }
+}
+
+/* Standalone readout, for lists that do not use the readout scheduler */
+void
+sspMpd_Trigger(int arg)
+{
+  int sync_flag = tiGetSyncEventFlag();
+  int ready;
+
+  sspMpdRecoverWait();
+  ready = rolPollWait(&sspMpd_Poll, sspMpd_Ready);
+
+  sspMpd_Readout(arg, ready);
+
+  if(sync_flag)
+    sspMpd_SyncCheck();
 
+  sspMpdRecoverKick();
 }
 
 void
@@ -0,0 +1,307 @@
+#pragma once
+/*************************************************************************
+ *
+ *  stats_rol_include.c -
+ *
+ *   Latency histograms for the stages of rocTrigger().
+ *
+ *   Stages are timed with the CPU time stamp counter (rolStatsTick(),
+ *   calibrated against CLOCK_MONOTONIC at Download) and filled into
+ *   histograms with 4 bins per factor of 2, from 1 ns up to ~17 s.  The
+ *   words per trigger are histogrammed the same way.
+ *
+ *   Only the readout thread writes the histograms, with no locks.  They
+ *   are kept in POSIX shared memory (ROL_STATS_SHM) so they can be read
+ *   during the run with tools/rolstat, and are printed by rocEnd().
+ *
+ *   Included with ROL_STATS_READER defined, only the shared memory
+ *   layout and the printout are compiled (tools/rolstat.c).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define ROL_STATS_SHM        "/rolstats"
+#define ROL_STATS_MAGIC      0x524f4c53  /* "ROLS" */
+#define ROL_STATS_VERSION    1
+#define ROL_STATS_MAX_STAGES 16
+#define ROL_STATS_NBINS      136         /* 4 bins per octave, 2^0 .. 2^34 */
+
+typedef struct
+{
+  char name[24];
+  char unit[8];
+  volatile uint64_t n;
+  volatile uint64_t sum;
+  volatile uint64_t min;
+  volatile uint64_t max;
+  volatile uint32_t hist[ROL_STATS_NBINS];
+} ROL_STATS_STAGE;
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  volatile int32_t  running;
+  volatile int32_t  runNumber;
+  volatile int32_t  nstage;
+  double ns_per_tick;
+  ROL_STATS_STAGE stage[ROL_STATS_MAX_STAGES];
+} ROL_STATS;
+
+/* Lower edge of a histogram bin */
+static inline uint64_t
+rolStatsBinLow(int bin)
+{
+  int msb = bin >> 2;
+
+  if(msb < 2)
+    return bin;   /* 0, 1, 2, 3 ... exact below 4 */
+
+  return (1ULL << msb) | ((uint64_t)(bin & 3) << (msb - 2));
+}
+
+/* Value below which a fraction q of the entries lie, interpolated
+   within the bin */
+static double
+rolStatsQuantile(ROL_STATS_STAGE *s, double q)
+{
+  uint64_t n = 0, lo, hi;
+  double target, v;
+  int bin;
+
+  target = q * s->n;
+  for(bin = 0; bin < ROL_STATS_NBINS; bin++)
+    {
+      if((s->hist[bin] == 0) || (n + s->hist[bin] < target))
+	{
+	  n += s->hist[bin];
+	  continue;
+	}
+
+      lo = rolStatsBinLow(bin);
+      hi = (bin + 1 < ROL_STATS_NBINS) ? rolStatsBinLow(bin + 1) : s->max;
+      v = lo + (hi - lo) * (target - n) / s->hist[bin];
+      if(v < s->min)
+	v = s->min;
+      return (v < s->max) ? v : s->max;
+    }
+
+  return s->max;
+}
+
+void
+rolStatsPrintTable(ROL_STATS *st)
+{
+  int istage;
+
+  printf("  %-20s %10s %10s %10s %10s %10s %10s\n",
+	 "Stage", "n", "avg", "p50", "p90", "p99", "max");
+  printf("--------------------------------------------------------------------------------------\n");
+  for(istage = 0; istage < st->nstage; istage++)
+    {
+      ROL_STATS_STAGE *s = &st->stage[istage];
+      double scale = (strcmp(s->unit, "us") == 0) ? 1e-3 : 1.;
+
+      if(s->n == 0)
+	{
+	  printf("  %-20s %10d\n", s->name, 0);
+	  continue;
+	}
+
+      printf("  %-20s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %s\n",
+	     s->name, (unsigned long long) s->n,
+	     scale * s->sum / s->n,
+	     scale * rolStatsQuantile(s, 0.50),
+	     scale * rolStatsQuantile(s, 0.90),
+	     scale * rolStatsQuantile(s, 0.99),
+	     scale * s->max, s->unit);
+    }
+  printf("--------------------------------------------------------------------------------------\n");
+}
+
+#ifndef ROL_STATS_READER
+
+static ROL_STATS *rolStats = NULL;
+static ROL_STATS rolStatsLocal;
+
+/* Stages timed in ti_list.c */
+int rolStatsTrigger = -1, rolStatsTi = -1, rolStatsSync = -1, rolStatsWords = -1;
+int rolStatsPool = -1;
+
+static inline uint64_t
+rolStatsTick()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline uint64_t
+rolStatsNs(uint64_t ticks)
+{
+  return (uint64_t)(ticks * rolStats->ns_per_tick);
+}
+
+static double
+rolStatsCalibrate()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  struct timespec ts0, ts1, sl = {0, 20000000};
+  uint64_t t0, t1;
+  double ns;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts0);
+  t0 = rolStatsTick();
+  nanosleep(&sl, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &ts1);
+  t1 = rolStatsTick();
+
+  ns = 1e9 * (ts1.tv_sec - ts0.tv_sec) + (ts1.tv_nsec - ts0.tv_nsec);
+  if(t1 > t0)
+    return ns / (t1 - t0);
+#endif
+  return 1.;
+}
+
+/* Map the shared memory (or fall back to local memory) and forget all
+   stages.  Called at the start of Download. */
+void
+rolStatsInit()
+{
+  int fd;
+  void *p = MAP_FAILED;
+
+  if(rolStats == NULL)
+    {
+      fd = shm_open(ROL_STATS_SHM, O_CREAT | O_RDWR, 0644);
+      if(fd >= 0)
+	{
+	  if(ftruncate(fd, sizeof(ROL_STATS)) == 0)
+	    p = mmap(NULL, sizeof(ROL_STATS), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	  close(fd);
+	}
+
+      if(p == MAP_FAILED)
+	{
+	  printf("%s: WARN: %s not available.  Statistics only printed at End.\n",
+		 __func__, ROL_STATS_SHM);
+	  rolStats = &rolStatsLocal;
+	}
+      else
+	rolStats = (ROL_STATS *) p;
+    }
+
+  memset(rolStats, 0, sizeof(ROL_STATS));
+  rolStats->magic = ROL_STATS_MAGIC;
+  rolStats->version = ROL_STATS_VERSION;
+  rolStats->ns_per_tick = rolStatsCalibrate();
+
+  printf("%s: %.4f ns per tick\n", __func__, rolStats->ns_per_tick);
+}
+
+/* Add a stage.  unit "us" for times (filled in ns), else a count. */
+int
+rolStatsStage(const char *name, const char *unit)
+{
+  ROL_STATS_STAGE *s;
+
+  if(rolStats->nstage >= ROL_STATS_MAX_STAGES)
+    {
+      printf("%s: ERROR: Too many stages (max = %d).  Ignoring %s\n",
+	     __func__, ROL_STATS_MAX_STAGES, name);
+      return -1;
+    }
+
+  s = &rolStats->stage[rolStats->nstage];
+  strncpy(s->name, name, sizeof(s->name) - 1);
+  strncpy(s->unit, unit, sizeof(s->unit) - 1);
+  s->min = ~0ULL;
+
+  return rolStats->nstage++;
+}
+
+void
+rolStatsGo()
+{
+  int istage;
+
+  for(istage = 0; istage < rolStats->nstage; istage++)
+    {
+      ROL_STATS_STAGE *s = &rolStats->stage[istage];
+      s->n = s->sum = s->max = 0;
+      s->min = ~0ULL;
+      memset((void *)s->hist, 0, sizeof(s->hist));
+    }
+
+  rolStats->runNumber = rol->runNumber;
+  rolStats->running = 1;
+}
+
+void
+rolStatsEnd()
+{
+  rolStats->running = 0;
+}
+
+static inline void
+rolStatsAdd(int istage, uint64_t val)
+{
+  ROL_STATS_STAGE *s;
+  int msb, bin;
+
+  if(istage < 0)
+    return;
+
+  s = &rolStats->stage[istage];
+
+  if(val < 4)
+    bin = val;
+  else
+    {
+      msb = 63 - __builtin_clzll(val);
+      bin = (msb << 2) | ((val >> (msb - 2)) & 3);
+      if(bin >= ROL_STATS_NBINS)
+	bin = ROL_STATS_NBINS - 1;
+    }
+
+  s->hist[bin]++;
+  s->sum += val;
+  if(val < s->min)
+    s->min = val;
+  if(val > s->max)
+    s->max = val;
+  s->n++;
+}
+
+/* Time from t0 to t1 (ticks) */
+static inline void
+rolStatsAddTicks(int istage, uint64_t t0, uint64_t t1)
+{
+  rolStatsAdd(istage, rolStatsNs(t1 - t0));
+}
+
+void
+rolStatsPrint()
+{
+  printf("\n%s: rocTrigger stages (times in us)\n", __func__);
+  rolStatsPrintTable(rolStats);
+  printf("\n");
+}
+
+#endif /* ROL_STATS_READER */
+
+/*
+  Local Variables:
+  compile-command: "make -k"
+  End:
+*/
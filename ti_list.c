@@ -6,10 +6,26 @@
  *
  */
 
-/* Event Buffer definitions */
+/* Define initial blocklevel and buffering level, and the largest
+   blocklevel the event buffers are sized for */
+#ifndef BLOCKLEVEL
+#define BLOCKLEVEL 1
+#endif
+#ifndef BUFFERLEVEL
+#define BUFFERLEVEL 5
+#endif
+#ifndef BLOCKLEVEL_MAX
+#define BLOCKLEVEL_MAX 4
+#endif
+#if BLOCKLEVEL > BLOCKLEVEL_MAX
+#error "BLOCKLEVEL is more than BLOCKLEVEL_MAX"
+#endif
+
+/* Event Buffer definitions, as made at Download for the initial
+   blocklevel.  Re-sized at Go for the run (rocEventPool). */
 #define MAX_EVENT_POOL     10
 //#define MAX_EVENT_LENGTH   1024*64      /* Size in Bytes */
-#define MAX_EVENT_LENGTH   16000*64      /* Size in Bytes */
+#define MAX_EVENT_LENGTH   (16000*64 * BLOCKLEVEL)      /* Size in Bytes */
 
 /* TI_MASTER / TI_SLAVE defined in Makefile */
 #ifdef TI_MASTER
@@ -45,9 +61,11 @@
 #include "ssp_maroc_rol_include.c"
 #endif
 
-/* Define initial blocklevel and buffering level */
-#define BLOCKLEVEL 1
-#define BUFFERLEVEL 5
+#include "sched_rol_include.c"
+#include "log_rol_include.c"
+#include "health_rol_include.c"
+#include "sizemon_rol_include.c"
+#include "evcheck_rol_include.c"
 
 
 typedef struct
@@ -57,10 +75,14 @@ typedef struct
   int pedestal;     // disable (0) / Disable after <pedestal> sync events
   int current;      // sync event counter for pedestal feature
   int pulser_arg1;  // fixed pulser <period> argument.  Units of 120ns.
+  int evtype;       // TI event type of the pulser (pedestal) triggers
 } TI_SYNCEVENT_CONFIG;
 
-TI_SYNCEVENT_CONFIG tiSyncEventConfig = {1, 1000, 100, 0, 83};
-//TI_SYNCEVENT_CONFIG tiSyncEventConfig = {0, 1000, 0, 0, 83}; // disable pulser trigger
+#ifndef TI_PEDESTAL_EVTYPE
+#define TI_PEDESTAL_EVTYPE 253
+#endif
+TI_SYNCEVENT_CONFIG tiSyncEventConfig = {1, 1000, 100, 0, 83, TI_PEDESTAL_EVTYPE};
+//TI_SYNCEVENT_CONFIG tiSyncEventConfig = {0, 1000, 0, 0, 83, TI_PEDESTAL_EVTYPE}; // disable pulser trigger
 
 
 
@@ -75,6 +97,71 @@ TI_SYNCEVENT_CONFIG tiSyncEventConfig = {1, 1000, 100, 0, 83};
 int rocTriggerSource = 0;
 void rocSetTriggerSource(int source); // routine prototype
 
+/*
+  Globals to configure the TI buffering (TI_MASTER), applied at Download
+  and Prestart
+    rocBlockLevel  : events per block (1 .. BLOCKLEVEL_MAX)
+    rocBufferLevel : blocks the TI lets go unread before going busy (1 .. 10)
+
+  Set with rocSetBlockLevel(int blocklevel, int bufferlevel);
+
+  Or, with rocAutoBlock enabled and the TS inputs trigger source, picked
+  at Prestart from the trigger rate measured on the TS input scalers
+    blocklevel  = rate / rocAutoBlockRate                 (1 .. BLOCKLEVEL_MAX)
+    bufferlevel = ROC_AUTOBLOCK_EVENTS / blocklevel       (2 .. 10)
+
+  Set with rocSetAutoBlockLevel(int enable, int blockRate);
+*/
+#ifndef ROC_AUTOBLOCK
+#define ROC_AUTOBLOCK 0
+#endif
+#define ROC_AUTOBLOCK_RATE      2000  /* blocks/s */
+#define ROC_AUTOBLOCK_EVENTS    20    /* events buffered in the modules */
+#define ROC_AUTOBLOCK_SAMPLE_MS 200   /* TS input scaler sampling */
+
+int rocBlockLevel    = BLOCKLEVEL;
+int rocBufferLevel   = BUFFERLEVEL;
+int rocAutoBlock     = ROC_AUTOBLOCK;
+int rocAutoBlockRate = ROC_AUTOBLOCK_RATE;
+unsigned int rocTSInputs = TI_TSINPUT_1 | TI_TSINPUT_2 | TI_TSINPUT_3;
+void rocSetBlockLevel(int blocklevel, int bufferlevel); // routine prototype
+void rocSetAutoBlockLevel(int enable, int blockRate); // routine prototype
+void rocApplyBlockLevel(); // routine prototype
+
+/*
+  Event buffer pool (vmeIN), re-sized at Go for the largest block of the
+  run: the TI block and the largest bank each module declares.  As many
+  buffers as fit in rocPoolBytes, from 2 to rocPoolMax.
+
+  Buffers in use (taken for readout, or waiting for the event builder)
+  are histogrammed at each trigger (rolstat, "event buffers in use").
+
+  Set with rocSetEventPool(int maxBuffers, int mbytes);
+
+  The buffers may be made smaller than the largest block (rocPoolLimit,
+  bytes, 0 = no limit).  A module bank that does not fit in what is left
+  of the buffer is then truncated, and marked (evbuf_rol_include.c).
+
+  Set with rocSetEventBufferSize(int kbytes);
+*/
+#define ROC_POOL_MAX 32
+#ifndef ROC_POOL_LIMIT
+#define ROC_POOL_LIMIT 0
+#endif
+#define ROC_POOL_BYTES (MAX_EVENT_POOL * 16000*64 * BLOCKLEVEL_MAX)
+#define TI_MAX_WORDS(bl) (2 + 8 * (bl))   /* 4 words per event, room for longer TI formats */
+
+int rocPoolMax   = ROC_POOL_MAX;
+int rocPoolBytes = ROC_POOL_BYTES;
+int rocPoolLimit = ROC_POOL_LIMIT;
+int rocPoolSize  = MAX_EVENT_LENGTH;   /* current buffers */
+int rocPoolDepth = MAX_EVENT_POOL;
+int rocPoolHigh  = 0;                  /* high water mark, this run */
+unsigned int rocPoolFull = 0;          /* triggers that took the last buffer */
+void rocSetEventPool(int maxBuffers, int mbytes); // routine prototype
+void rocSetEventBufferSize(int kbytes); // routine prototype
+void rocEventPool(); // routine prototype
+
 /****************************************
  *  DOWNLOAD
  ****************************************/
@@ -84,7 +171,7 @@ rocDownload()
   int stat;
 
   /* Define BLock Level */
-  blockLevel = BLOCKLEVEL;
+  blockLevel = rocBlockLevel;
 
 
   /*****************
@@ -110,7 +197,7 @@ rocDownload()
 
   /* Enable set specific TS input bits (1-6) */
   //tiEnableTSInput( TI_TSINPUT_1 | TI_TSINPUT_2 );
-  tiEnableTSInput( TI_TSINPUT_1 | TI_TSINPUT_2 | TI_TSINPUT_3);
+  tiEnableTSInput(rocTSInputs);
   //tiEnableTSInput( TI_TSINPUT_ALL );
 
   /* Load the trigger table that associates
@@ -127,7 +214,7 @@ rocDownload()
   tiSetBlockLevel(blockLevel);
 
   /* Set Trigger Buffer Level */
-  tiSetBlockBufferLevel(BUFFERLEVEL);
+  tiSetBlockBufferLevel(rocBufferLevel);
 
   /*Set prescale for each TS#*/
   tiSetInputPrescale(1,0);
@@ -159,24 +246,52 @@ rocDownload()
 
       if(tiSyncEventConfig.pedestal > 0)
 	{
-	  printf("\tpedestal for first %d sync events\n", tiSyncEventConfig.pedestal);
+	  printf("\tpedestal for first %d sync events (event type %d)\n",
+		 tiSyncEventConfig.pedestal, tiSyncEventConfig.evtype);
 	}
     }
 
   tiStatus(0);
 
+  /* Messages and status dumps from the trigger are written by a worker */
+  rolLogInit();
+
+  /* rocTrigger stage timing */
+  rolStatsInit();
+  rolStatsTrigger = rolStatsStage("rocTrigger", "us");
+  rolStatsTi      = rolStatsStage("TI block read", "us");
+
+  /* Modules are registered with the readout scheduler in bank order */
+  rolSchedInit();
+
 #ifdef USE_FA250
   fa250_Download(NULL);
+  rolSchedRegister(&fa250_Poll, fa250_Ready, fa250_Readout, fa250_Discard,
+		   fa250_SyncCheck, fa250_MaxWords);
 #endif
 
 #ifdef USE_SSP_MPD
   sspMpd_Download(NULL);
+  rolSchedRegister(&sspMpd_Poll, sspMpd_Ready, sspMpd_Readout, sspMpd_Discard,
+		   sspMpd_SyncCheck, sspMpd_MaxWords);
 #endif
 
 #ifdef USE_SSP_MAROC
   sspMaroc_Download(NULL);
+  rolSchedRegister(&sspMaroc_Poll, sspMaroc_Ready, sspMaroc_Readout, sspMaroc_Discard,
+		   NULL, sspMaroc_MaxWords);
 #endif
 
+  rolSchedDownload();
+
+  rolStatsSync    = rolStatsStage("sync event checks", "us");
+  rolStatsWords   = rolStatsStage("words/trigger", "words");
+  rolStatsPool    = rolStatsStage("event buffers in use", "bufs");
+
+  /* As made by the library at Download */
+  rocPoolSize  = MAX_EVENT_LENGTH;
+  rocPoolDepth = MAX_EVENT_POOL;
+
   printf("rocDownload: User Download Executed\n");
 
 }
@@ -188,6 +303,11 @@ void
 rocPrestart()
 {
 
+#ifdef TI_MASTER
+  /* Block and buffer level for this run */
+  rocApplyBlockLevel();
+#endif
+
   tiStatus(0);
 
 #ifdef USE_FA250
@@ -231,22 +351,24 @@ rocGo()
   /* In case of slave, set TI busy to be enabled for full buffer level */
 
   /* Check first for valid blockLevel and bufferLevel */
-  if((bufferLevel > 10) || (blockLevel > 1))
+  if(bufferLevel > 10)
     {
-      daLogMsg("ERROR","Invalid blockLevel / bufferLevel received: %d / %d",
-	       blockLevel, bufferLevel);
+      daLogMsg("ERROR","Invalid bufferLevel received: %d", bufferLevel);
       tiUseBroadcastBufferLevel(0);
       tiSetBlockBufferLevel(1);
-
-      /* Cannot help the TI blockLevel with the current library.
-	 modules can be spared, though
-      */
-      blockLevel = 1;
     }
   else
     {
       tiUseBroadcastBufferLevel(1);
     }
+
+  /* Cannot help the TI blockLevel.  The modules follow it (in their Go),
+     but the event buffers are only sized up to BLOCKLEVEL_MAX */
+  if(blockLevel > BLOCKLEVEL_MAX)
+    {
+      daLogMsg("ERROR","blockLevel received (%d) is more than the event buffers are sized for (%d)",
+	       blockLevel, BLOCKLEVEL_MAX);
+    }
 #endif
 
   /* Enable/Set Block Level on modules, if needed, here */
@@ -300,11 +422,26 @@ rocGo()
 
 #ifdef USE_SSP_MPD
   sspMpd_Go();
+
+  /* MPD pedestals from the pulser triggers of the first sync events */
+  if(tiSyncEventConfig.enable && (tiSyncEventConfig.pedestal > 1))
+    sspMpdPedestalStart(tiSyncEventConfig.evtype);
 #endif
 
 #ifdef USE_SSP_MAROC
   sspMaroc_Go();
 #endif
+
+  /* Event buffers for the largest block the modules can now give */
+  rocEventPool();
+
+  rolSchedGo();
+  rolStatsGo();
+  rolSizeGo();
+  rolCheckGo();
+
+  /* Module health sampled in the background during the run */
+  rolHealthStart();
 }
 
 /****************************************
@@ -328,12 +465,31 @@ rocEnd()
     }
 #endif
 
+  rolHealthStop();
+
+  /* Messages from the last blocks before the summaries */
+  rolLogFlush();
+
   tiStatus(0);
 
 #ifdef USE_FA250
   fa250_End();
 #endif
 
+#ifdef USE_SSP_MPD
+  sspMpd_End();
+#endif
+
+  rolStatsEnd();
+  rolSchedStatus();
+  rolStatsPrint();
+  rolHealthStatus();
+  rolSizeStatus();
+  rolCheckStatus();
+
+  printf("rocEnd: Event buffers: %d x %d bytes, high water %d, all in use at %u triggers\n",
+	 rocPoolDepth, rocPoolSize, rocPoolHigh, rocPoolFull);
+
   printf("rocEnd: Ended after %d blocks\n",tiGetIntCount());
 
 }
@@ -344,38 +500,69 @@ rocEnd()
 void
 rocTrigger(int arg)
 {
-  int dCnt;
+  int dCnt, syncFlag, inuse;
+  unsigned int *start = dma_dabufp, modules;
+  uint64_t t0 = rolStatsTick(), t1;
+
+#ifdef USE_SSP_MPD
+  /* The TI holds busy while the SSP-MPD recovery runs */
+  sspMpdRecoverWait();
+#endif
+
+  rolHealthTrigger(1);
+
+  /* Module banks are limited to what is left of the buffer */
+  rolBufSet(start, rocPoolSize);
+
+  /* Event buffers in use, this one included */
+  inuse = rocPoolDepth - dmaPNodeCount(vmeIN);
+  rolStatsAdd(rolStatsPool, inuse);
+  if(inuse > rocPoolHigh)
+    rocPoolHigh = inuse;
+  if(inuse >= rocPoolDepth)
+    rocPoolFull++;
 
   /* Set TI output 1 high for diagnostics */
   tiSetOutputPort(1,0,0,0);
 
   /* Readout the trigger block from the TI
      Trigger Block MUST be readout first */
+  t1 = rolStatsTick();
   dCnt = tiReadTriggerBlock(dma_dabufp);
+  rolStatsAddTicks(rolStatsTi, t1, rolStatsTick());
 
   if(dCnt<=0)
     {
-      printf("No TI Trigger data or error.  dCnt = %d\n",dCnt);
+      rolLog(ROL_LOG_ERROR, "No TI Trigger data or error.  dCnt = %ld\n", dCnt);
     }
   else
     { /* TI Data is already in a bank structure.  Bump the pointer */
       dma_dabufp += dCnt;
     }
 
-#ifdef USE_FA250
-  fa250_Trigger(arg);
-#endif
+  /* Modules wanted by the event type(s) of the block (rolSchedTable) */
+  syncFlag = tiGetSyncEventFlag();
+  modules = rolSchedSelect(start, dCnt, (syncFlag == 1));
+
+  /* Event number and time stamp of the modules against the TI, every
+     rolCheckEvery blocks */
+  rolCheckStart(start, dCnt);
 
 #ifdef USE_SSP_MPD
-  sspMpd_Trigger(arg);
+  /* Pulser triggers of the block, for the MPD pedestals */
+  sspMpdPedestalSelect(start, dCnt);
 #endif
 
-#ifdef USE_SSP_MAROC
-  sspMaroc_Trigger(arg);
-#endif
+  /* Readout the modules, banks in the order they were registered */
+  rolSchedReadout(arg, modules);
+  rolCheckTrigger();
 
-  if(tiGetSyncEventFlag() == 1)
+  if(syncFlag == 1)
     {
+      /* Modules should not have any more data here */
+      t1 = rolStatsTick();
+      rolSchedSyncCheck();
+
       /* Update counter */
       tiSyncEventConfig.current++;
 
@@ -384,6 +571,9 @@ rocTrigger(int arg)
 	  static int32_t doOnce = 0;
 	  /* Disable pulser */
 	  if(doOnce++ == 1) tiSoftTrig(1, 0, 0, 0);
+#ifdef USE_SSP_MPD
+	  sspMpdPedestalStop();
+#endif
 	}
       else
 	{
@@ -395,19 +585,30 @@ rocTrigger(int arg)
       int davail = tiBReady();
       if(davail > 0)
 	{
-	  printf("%s: ERROR: TI Data available (%d) after readout in SYNC event \n",
-		 __func__, davail);
+	  rolLog(ROL_LOG_ERROR, "rocTrigger: TI Data available (%ld) after readout in SYNC event \n",
+		 davail);
 
 	  while(tiBReady())
 	    {
 	      vmeDmaFlush(tiGetAdr32());
 	    }
 	}
+      rolStatsAddTicks(rolStatsSync, t1, rolStatsTick());
     }
 
+#ifdef USE_SSP_MPD
+  /* A recovery noted by the SSP-MPD readout, now that this trigger is
+     done with the modules */
+  sspMpdRecoverKick();
+#endif
+
   /* Set TI output 0 low */
   tiSetOutputPort(0,0,0,0);
 
+  rolStatsAddTicks(rolStatsTrigger, t0, rolStatsTick());
+  rolStatsAdd(rolStatsWords, dma_dabufp - start);
+
+  rolHealthTrigger(0);
 }
 
 void
@@ -436,6 +637,7 @@ rocCleanup()
   sspMaroc_Cleanup();
 #endif
 
+  rolLogStop();
 }
 /*
   Routine to configure pedestal subtraction mode
@@ -473,8 +675,201 @@ rocSetTriggerSource(int source)
 #endif
 }
 
+void
+rocSetBlockLevel(int blocklevel, int bufferlevel)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, blocklevel);
+      return;
+    }
+
+  if((blocklevel < 1) || (blocklevel > BLOCKLEVEL_MAX) ||
+     (bufferlevel < 1) || (bufferlevel > 10))
+    {
+      printf("%s: ERROR: Invalid blockLevel / bufferLevel: %d / %d (1..%d / 1..10)\n",
+	     __func__, blocklevel, bufferlevel, BLOCKLEVEL_MAX);
+      return;
+    }
+
+  rocBlockLevel  = blocklevel;
+  rocBufferLevel = bufferlevel;
+
+  daLogMsg("INFO","Setting blockLevel %d, bufferLevel %d",
+	   rocBlockLevel, rocBufferLevel);
+}
+
+void
+rocSetAutoBlockLevel(int enable, int blockRate)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, enable);
+      return;
+    }
+
+  rocAutoBlock = (enable) ? 1 : 0;
+  if(blockRate > 0)
+    rocAutoBlockRate = blockRate;
+
+  daLogMsg("INFO","Setting automatic blockLevel %s (%d blocks/s)",
+	   (rocAutoBlock) ? "ENABLED" : "DISABLED", rocAutoBlockRate);
+}
+
+#ifdef TI_MASTER
+/* Accepted trigger rate (Hz): TS input scalers over ROC_AUTOBLOCK_SAMPLE_MS,
+   less the input prescales */
+static double
+rocMeasureTriggerRate()
+{
+  unsigned int c0[6], c1;
+  unsigned long long t0, t1;
+  double rate = 0;
+  int inp;
+
+  t0 = rolPollNow();
+  for(inp = 0; inp < 6; inp++)
+    if(rocTSInputs & (1 << inp))
+      c0[inp] = tiGetTSscaler(inp + 1, 1);
+
+  usleep(1000 * ROC_AUTOBLOCK_SAMPLE_MS);
+
+  t1 = rolPollNow();
+  for(inp = 0; inp < 6; inp++)
+    if(rocTSInputs & (1 << inp))
+      {
+	c1 = tiGetTSscaler(inp + 1, 1);
+	rate += (double)(c1 - c0[inp]) / (1 << tiGetInputPrescale(inp + 1));
+      }
+
+  return rate * 1e9 / (t1 - t0);
+}
+#endif
+
+/* Program the TI block and buffer level for the next run */
+void
+rocApplyBlockLevel()
+{
+#ifdef TI_MASTER
+  int blocklevel = rocBlockLevel, bufferlevel = rocBufferLevel;
+  double rate;
+
+  if(rocAutoBlock && (rocTriggerSource == 0))
+    {
+      rate = rocMeasureTriggerRate();
+
+      blocklevel = ((int) rate + rocAutoBlockRate - 1) / rocAutoBlockRate;
+      if(blocklevel < 1)
+	blocklevel = 1;
+      if(blocklevel > BLOCKLEVEL_MAX)
+	blocklevel = BLOCKLEVEL_MAX;
+
+      bufferlevel = (ROC_AUTOBLOCK_EVENTS + blocklevel - 1) / blocklevel;
+      if(bufferlevel < 2)
+	bufferlevel = 2;
+      if(bufferlevel > 10)
+	bufferlevel = 10;
+
+      daLogMsg("INFO","Trigger rate %.0f Hz: blockLevel %d, bufferLevel %d",
+	       rate, blocklevel, bufferlevel);
+    }
+
+  blockLevel = blocklevel;
+  tiSetBlockLevel(blocklevel);
+  tiSetBlockBufferLevel(bufferlevel);
+#endif
+}
 
 
+
+void
+rocSetEventPool(int maxBuffers, int mbytes)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, maxBuffers);
+      return;
+    }
+
+  if((maxBuffers < 2) || (mbytes < 1) || (mbytes > 2047))
+    {
+      printf("%s: ERROR: Invalid pool: %d buffers max, %d MB\n",
+	     __func__, maxBuffers, mbytes);
+      return;
+    }
+
+  rocPoolMax   = maxBuffers;
+  rocPoolBytes = mbytes << 20;
+
+  daLogMsg("INFO","Setting event buffer pool (up to %d buffers in %d MB)",
+	   rocPoolMax, mbytes);
+}
+
+void
+rocSetEventBufferSize(int kbytes)
+{
+  if(TIPRIMARYflag == 1)
+    {
+      printf("%s: ERROR: Trigger Source already enabled.  Ignoring change to %d.\n",
+	     __func__, kbytes);
+      return;
+    }
+
+  rocPoolLimit = (kbytes > 0) ? (kbytes << 10) : 0;
+  if(rocPoolLimit)
+    daLogMsg("INFO","Setting event buffer size limit (%d kB)", kbytes);
+  else
+    daLogMsg("INFO","Setting event buffer size for the largest block");
+}
+
+/* Size the event buffers (vmeIN) for the largest block of this run.
+   Call at Go, after the modules' Go. */
+void
+rocEventPool()
+{
+  int nwords, bytes, depth;
+
+  nwords = TI_MAX_WORDS(blockLevel) + rolSchedMaxWords() + ROL_BUF_MARGIN;
+  bytes  = ((4 * nwords) + 4095) & ~4095;
+  if((rocPoolLimit > 0) && (bytes > rocPoolLimit))
+    bytes = rocPoolLimit;
+
+  depth = rocPoolBytes / bytes;
+  if(depth > rocPoolMax)
+    depth = rocPoolMax;
+  if(depth < 2)
+    {
+      daLogMsg("WARN","Largest block (%d bytes) leaves less than 2 event buffers in %d MB",
+	       bytes, rocPoolBytes >> 20);
+      depth = 2;
+    }
+
+  if((bytes != rocPoolSize) || (depth != rocPoolDepth))
+    {
+      dmaPFree(vmeIN);
+      vmeIN = dmaPCreate("vmeIN", bytes, depth, 0);
+      if(vmeIN == 0)
+	{
+	  daLogMsg("ERROR","Unable to allocate %d event buffers of %d bytes",
+		   depth, bytes);
+	  bytes = MAX_EVENT_LENGTH;
+	  depth = MAX_EVENT_POOL;
+	  vmeIN = dmaPCreate("vmeIN", bytes, depth, 0);
+	}
+      rocPoolSize  = bytes;
+      rocPoolDepth = depth;
+    }
+
+  rocPoolHigh = 0;
+  rocPoolFull = 0;
+
+  printf("%s: %d event buffers of %d bytes (largest block %d words)\n",
+	 __func__, rocPoolDepth, rocPoolSize, nwords);
+}
+
 /*
   Local Variables:
   compile-command: "make -k"
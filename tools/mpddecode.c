@@ -0,0 +1,238 @@
+/*************************************************************************
+ *
+ *  mpddecode.c -
+ *
+ *   Benchmark of the MPD data decoder (mpddecode_rol_include.c).
+ *
+ *   Builds SSP blocks of MPD data in memory, checks that mpdDecodeNext()
+ *   gives the same events as the word by word mpdDecodeNextScalar(), and
+ *   times both.
+ *
+ *   Usage:
+ *     mpddecode [-n events] [-f fibers] [-a apvs] [-o occupancy] [-t seconds]
+ *       -n <events>     events in the data                  (default 100)
+ *       -f <fibers>     MPDs per event                      (default 8)
+ *       -a <apvs>       APVs per MPD                        (default 16)
+ *       -o <fraction>   fraction of the strips in the data  (default 1)
+ *       -t <seconds>    time each decoder for               (default 1)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../mpddecode_rol_include.c"
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static uint32_t
+word(uint32_t w)
+{
+  return mpdDecodeSwap(w);   /* as read out */
+}
+
+/* SSP block of nev events, one event per block header / trailer */
+static int
+makeData(uint32_t *d, int nev, int nfiber, int napv, double occupancy)
+{
+  uint32_t *d0 = d;
+  int iev, ifiber, iapv, ich, is, s[6];
+
+  for(iev = 0; iev < nev; iev++)
+    {
+      uint32_t *blk = d;
+
+      *d++ = word((1u << 31) | (0 << 27) | (20 << 22) | ((iev & 0x3FF) << 8) | 1);
+      *d++ = word((1u << 31) | (2 << 27) | (iev & 0x3FFFFF));
+      *d++ = word((1u << 31) | (3 << 27) | ((iev * 83) & 0xFFFFFF));
+      *d++ = word(0);
+
+      for(ifiber = 0; ifiber < nfiber; ifiber++)
+	{
+	  *d++ = word((1u << 31) | (5 << 27) | (ifiber << 16) | ifiber);
+	  for(iapv = 0; iapv < napv; iapv++)
+	    for(ich = 0; ich < 128; ich++)
+	      {
+		if(drand48() >= occupancy)
+		  continue;
+		for(is = 0; is < 6; is++)
+		  s[is] = (int)(8192 * drand48()) - 4096;
+
+		*d++ = word(((ich & 0x1F) << 26) | ((s[1] & 0x1FFF) << 13) | (s[0] & 0x1FFF));
+		*d++ = word((((ich >> 5) & 0x3) << 26) | ((s[3] & 0x1FFF) << 13) | (s[2] & 0x1FFF));
+		*d++ = word(((iapv & 0x1F) << 26) | ((s[5] & 0x1FFF) << 13) | (s[4] & 0x1FFF));
+	      }
+	}
+
+      *d = word((1u << 31) | (1 << 27) | (20 << 22) | ((d - blk + 1) & 0x3FFFFF));
+      d++;
+      if((d - blk) & 1)
+	*d++ = word(0xF8000000);
+    }
+
+  return d - d0;
+}
+
+/* Same event from both decoders? */
+static int
+sameEvent(MPD_DECODE *a, MPD_DECODE *b)
+{
+  int fiber, apv, is, ch;
+
+  if((a->evnum != b->evnum) || (a->timestamp != b->timestamp) ||
+     (a->fiberMask != b->fiberMask) || (a->nstrips != b->nstrips) ||
+     (a->nerror != b->nerror))
+    return 0;
+
+  for(fiber = 0; fiber < MPD_DECODE_NFIBER; fiber++)
+    {
+      if(a->apvMask[fiber] != b->apvMask[fiber])
+	return 0;
+
+      for(apv = 0; apv < MPD_DECODE_NAPV; apv++)
+	{
+	  if(memcmp(a->present[fiber][apv], b->present[fiber][apv],
+		    sizeof(a->present[fiber][apv])))
+	    return 0;
+
+	  for(ch = 0; ch < MPD_DECODE_NCH; ch++)
+	    {
+	      if(((a->present[fiber][apv][ch >> 6] >> (ch & 63)) & 1) == 0)
+		continue;
+	      for(is = 0; is < MPD_DECODE_NSAMPLE; is++)
+		if(a->adc[fiber][apv][is][ch] != b->adc[fiber][apv][is][ch])
+		  return 0;
+	    }
+	}
+    }
+
+  return 1;
+}
+
+static double
+timeDecoder(int (*next)(MPD_DECODE *, const uint32_t *, int, int *),
+	    MPD_DECODE *d, const uint32_t *data, int nwords, double seconds,
+	    long *npass)
+{
+  double t0 = now(), t;
+  int pos;
+
+  *npass = 0;
+  do
+    {
+      pos = 0;
+      while(next(d, data, nwords, &pos))
+	;
+      (*npass)++;
+      t = now() - t0;
+    }
+  while(t < seconds);
+
+  return t;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ch, nev = 100, nfiber = 8, napv = 16, nwords, posa = 0, posb = 0, n = 0;
+  int ra, rb;
+  double occupancy = 1., seconds = 1., ts, tv;
+  long nstrips = 0, npass_s, npass_v;
+  uint32_t *data;
+  MPD_DECODE *a, *b;
+
+  while((ch = getopt(argc, argv, "n:f:a:o:t:h")) != -1)
+    {
+      switch(ch)
+	{
+	case 'n':
+	  nev = atoi(optarg);
+	  break;
+	case 'f':
+	  nfiber = atoi(optarg);
+	  break;
+	case 'a':
+	  napv = atoi(optarg);
+	  break;
+	case 'o':
+	  occupancy = atof(optarg);
+	  break;
+	case 't':
+	  seconds = atof(optarg);
+	  break;
+	default:
+	  fprintf(stderr,
+		  "Usage: %s [-n events] [-f fibers] [-a apvs] [-o occupancy] [-t seconds]\n",
+		  argv[0]);
+	  return 1;
+	}
+    }
+
+  if(nfiber > MPD_DECODE_NFIBER)
+    nfiber = MPD_DECODE_NFIBER;
+  if(napv > MPD_DECODE_NAPV)
+    napv = MPD_DECODE_NAPV;
+
+  data = malloc(sizeof(uint32_t) * nev * (6 + nfiber * (1 + napv * 128 * 3)));
+  a = mpdDecodeCreate();
+  b = mpdDecodeCreate();
+  if((data == NULL) || (a == NULL) || (b == NULL))
+    {
+      fprintf(stderr, "%s: out of memory\n", argv[0]);
+      return 1;
+    }
+
+  srand48(1);
+  nwords = makeData(data, nev, nfiber, napv, occupancy);
+
+  /* check */
+  while(1)
+    {
+      ra = mpdDecodeNextScalar(a, data, nwords, &posa);
+      rb = mpdDecodeNext(b, data, nwords, &posb);
+      if((ra != rb) || (posa != posb) || (ra && !sameEvent(a, b)))
+	{
+	  fprintf(stderr, "%s: ERROR: decoders differ at event %d (word %d / %d)\n",
+		  argv[0], n, posa, posb);
+	  return 1;
+	}
+      if(!ra)
+	break;
+      nstrips += a->nstrips;
+      n++;
+    }
+
+  printf("%d events, %d MPDs x %d APVs, occupancy %.2f: %d words, %ld strips\n",
+	 n, nfiber, napv, occupancy, nwords, nstrips);
+  printf("decoders agree\n");
+
+  ts = timeDecoder(mpdDecodeNextScalar, a, data, nwords, seconds, &npass_s);
+  tv = timeDecoder(mpdDecodeNext, b, data, nwords, seconds, &npass_v);
+
+  printf("  %-8s %10.1f MB/s %10.2f Mstrips/s\n", "scalar",
+	 4e-6 * nwords * npass_s / ts, 1e-6 * nstrips * npass_s / ts);
+  printf("  %-8s %10.1f MB/s %10.2f Mstrips/s  (x %.2f)\n",
+#if defined(__SSSE3__)
+	 "ssse3",
+#elif defined(__SSE2__)
+	 "sse2",
+#else
+	 "scalar",
+#endif
+	 4e-6 * nwords * npass_v / tv, 1e-6 * nstrips * npass_v / tv,
+	 (npass_v / tv) / (npass_s / ts));
+
+  mpdDecodeFree(a);
+  mpdDecodeFree(b);
+  free(data);
+
+  return 0;
+}
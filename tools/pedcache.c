@@ -0,0 +1,144 @@
+/*************************************************************************
+ *
+ *  pedcache.c -
+ *
+ *   Build the binary pedestal / common-mode cache read by the SSP MPD
+ *   readout (pedcache_rol_include.c) from the text files, or check and
+ *   print an existing cache.
+ *
+ *   Usage:
+ *     pedcache [-s slot] [-c cmfile] -o cache pedfile
+ *       -s <slot>       SSP slot of the pedestals to keep  (default 20)
+ *       -c <cmfile>     common-mode range file             (default none)
+ *       -o <cache>      cache file to write
+ *     pedcache -p [-s slot] cache
+ *       -p              check and print a cache
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../pedcache_rol_include.c"
+
+static void
+printSource(const char *label, const PED_CACHE_SOURCE *src)
+{
+  if(!src->exists)
+    {
+      printf("  %-10s none\n", label);
+      return;
+    }
+
+  printf("  %-10s %lld bytes, hash 0x%08x, mtime %lld.%09lld\n", label,
+	 (long long) src->size, src->hash,
+	 (long long) (src->mtime_ns / 1000000000LL),
+	 (long long) (src->mtime_ns % 1000000000LL));
+}
+
+static void
+printCache(const PED_CACHE *c)
+{
+  int fiber, apv, napv;
+
+  printf("  version    %u, %u bytes, checksum 0x%08x\n",
+	 c->hdr.version, c->hdr.size, c->hdr.checksum);
+  printf("  SSP slot   %d\n", c->hdr.ssp_slot);
+  printSource("pedestals", &c->hdr.ped);
+  printSource("commonmode", &c->hdr.cm);
+  printf("  %d APVs with pedestals, %d with common-mode ranges\n",
+	 c->hdr.napv_ped, c->hdr.ncm);
+
+  for(fiber = 0; fiber < PED_CACHE_NFIBER; fiber++)
+    {
+      for(apv = 0, napv = 0; apv < PED_CACHE_NAPV; apv++)
+	if(c->cm_set[fiber][apv])
+	  napv++;
+      if(napv)
+	printf("    fiber %2d: %2d common-mode ranges\n", fiber, napv);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+  const char *cmName = NULL, *cacheName = NULL;
+  const char *why;
+  PED_CACHE *c;
+  int ch, sspSlot = 20, print = 0;
+  size_t size;
+
+  while((ch = getopt(argc, argv, "s:c:o:ph")) != -1)
+    {
+      switch(ch)
+	{
+	case 's':
+	  sspSlot = atoi(optarg);
+	  break;
+	case 'c':
+	  cmName = optarg;
+	  break;
+	case 'o':
+	  cacheName = optarg;
+	  break;
+	case 'p':
+	  print = 1;
+	  break;
+	default:
+	  fprintf(stderr,
+		  "Usage: %s [-s slot] [-c cmfile] -o cache pedfile\n"
+		  "       %s -p [-s slot] cache\n", argv[0], argv[0]);
+	  return 1;
+	}
+    }
+
+  if(optind >= argc)
+    {
+      fprintf(stderr, "%s: no %s file given\n", argv[0], (print) ? "cache" : "pedestal");
+      return 1;
+    }
+
+  if(print)
+    {
+      c = pedCacheMap(argv[optind], &size);
+      if(c == NULL)
+	{
+	  fprintf(stderr, "%s: unable to read %s\n", argv[0], argv[optind]);
+	  return 1;
+	}
+
+      why = pedCacheCheck(c, size, sspSlot);
+      printf("%s: %s\n", argv[optind], (why) ? why : "OK");
+      if((why == NULL) || (size == sizeof(PED_CACHE)))
+	printCache(c);
+
+      munmap(c, size);
+      return (why) ? 1 : 0;
+    }
+
+  if(cacheName == NULL)
+    {
+      fprintf(stderr, "%s: no cache file given (-o)\n", argv[0]);
+      return 1;
+    }
+
+  c = pedCacheBuild(argv[optind], cmName, sspSlot);
+  if((c == NULL) || !c->hdr.ped.exists)
+    {
+      fprintf(stderr, "%s: unable to read %s\n", argv[0], argv[optind]);
+      return 1;
+    }
+
+  if(pedCacheWrite(c, cacheName) != 0)
+    {
+      fprintf(stderr, "%s: unable to write %s\n", argv[0], cacheName);
+      return 1;
+    }
+
+  printf("%s:\n", cacheName);
+  printCache(c);
+  free(c);
+
+  return 0;
+}
@@ -0,0 +1,80 @@
+/*************************************************************************
+ *
+ *  rolstat.c -
+ *
+ *   Print the rocTrigger stage histograms (stats_rol_include.c) of the
+ *   readout list running on this host, from its shared memory.
+ *
+ *   Usage:
+ *     rolstat [-i seconds]
+ *       -i <seconds>    print again every <seconds>, until interrupted
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#define ROL_STATS_READER
+#include "../stats_rol_include.c"
+
+int
+main(int argc, char *argv[])
+{
+  ROL_STATS *st;
+  int c, fd;
+  double interval = 0;
+
+  while((c = getopt(argc, argv, "i:h")) != -1)
+    {
+      switch(c)
+	{
+	case 'i':
+	  interval = atof(optarg);
+	  break;
+	default:
+	  fprintf(stderr, "Usage: %s [-i seconds]\n", argv[0]);
+	  return 1;
+	}
+    }
+
+  fd = shm_open(ROL_STATS_SHM, O_RDONLY, 0);
+  if(fd < 0)
+    {
+      perror("shm_open " ROL_STATS_SHM);
+      return 1;
+    }
+
+  st = (ROL_STATS *) mmap(NULL, sizeof(ROL_STATS), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(st == MAP_FAILED)
+    {
+      perror("mmap");
+      return 1;
+    }
+
+  if((st->magic != ROL_STATS_MAGIC) || (st->version != ROL_STATS_VERSION))
+    {
+      fprintf(stderr, "%s: %s is not version %d rocTrigger statistics\n",
+	      argv[0], ROL_STATS_SHM, ROL_STATS_VERSION);
+      return 1;
+    }
+
+  while(1)
+    {
+      printf("\nRun %d (%s) - rocTrigger stages (times in us)\n",
+	     st->runNumber, (st->running) ? "running" : "ended");
+      rolStatsPrintTable(st);
+      fflush(stdout);
+
+      if(interval <= 0)
+	break;
+      usleep((useconds_t)(interval * 1e6));
+    }
+
+  munmap(st, sizeof(ROL_STATS));
+
+  return 0;
+}
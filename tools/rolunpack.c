@@ -0,0 +1,289 @@
+/*************************************************************************
+ *
+ *  rolunpack.c -
+ *
+ *   Unpack the banks packed by the readout lists (pack_rol_include.c),
+ *   or check and time the packing.
+ *
+ *   Usage:
+ *     rolunpack [-o outfile] infile
+ *       infile: packed bank contents (after the two bank header words),
+ *       one or more back to back.  The words as read are written to
+ *       outfile (default: a count per bank only).
+ *     rolunpack -t [-n words] [-s seconds]
+ *       -t              pack FADC250 and MPD like data with both packers,
+ *                       check they agree and unpack to the same words,
+ *                       and print the size and speed
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#define ROL_PACK_READER
+#include "../pack_rol_include.c"
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static double
+gauss()
+{
+  return sqrt(-2. * log(drand48() + 1e-12)) * cos(2. * M_PI * drand48());
+}
+
+/* FADC250 raw window mode block, as read */
+static int
+makeFadc(uint32_t *d, int nmax)
+{
+  int n = 0, ich, is, ev = 0, ptw = 48;
+
+  while(n + 3 + 16 * (1 + ptw / 2) + 1 < nmax)
+    {
+      d[n++] = rolPackSwap((1u << 31) | (2 << 27) | (3 << 22) | (ev & 0x3FFFFF));
+      d[n++] = rolPackSwap((1u << 31) | (3 << 27) | ((ev * 977) & 0xFFFFFF));
+      d[n++] = rolPackSwap(0);
+      for(ich = 0; ich < 16; ich++)
+	{
+	  int base = 100 + 37 * ich, amp = (drand48() < 0.1) ? 2000 * drand48() : 0;
+	  d[n++] = rolPackSwap((1u << 31) | (4 << 27) | (ich << 23) | ptw);
+	  for(is = 0; is < ptw; is += 2)
+	    {
+	      int s0 = base + 2 * gauss() + ((is >= 20 && is < 26) ? amp : 0);
+	      int s1 = base + 2 * gauss() + ((is >= 20 && is < 26) ? amp : 0);
+	      d[n++] = rolPackSwap(((s0 & 0x1FFF) << 16) | (s1 & 0x1FFF));
+	    }
+	}
+      ev++;
+    }
+  d[n] = rolPackSwap((1u << 31) | (1 << 27) | (3 << 22) | ((n + 1) & 0x3FFFFF));
+  n++;
+
+  return n;
+}
+
+/* SSP MPD block, all samples, as read */
+static int
+makeMpd(uint32_t *d, int nmax)
+{
+  int n = 0, ifiber = 0, iapv, ich, is, s[6];
+  double cm[6];
+
+  d[n++] = rolPackSwap((1u << 31) | (2 << 27) | 1);
+  d[n++] = rolPackSwap((1u << 31) | (3 << 27) | 12345);
+  d[n++] = rolPackSwap(0);
+  while(n + 1 + 16 * 128 * 3 < nmax)
+    {
+      d[n++] = rolPackSwap((1u << 31) | (5 << 27) | (ifiber << 16) | ifiber);
+      for(iapv = 0; iapv < 16; iapv++)
+	{
+	  for(is = 0; is < 6; is++)
+	    cm[is] = 20 * gauss();
+	  for(ich = 0; ich < 128; ich++)
+	    {
+	      int ped = 500 + ((ifiber * 131 + iapv * 17 + ich * 7) % 300);
+	      for(is = 0; is < 6; is++)
+		s[is] = ped + cm[is] + 15 * gauss();
+	      d[n++] = rolPackSwap(((ich & 0x1F) << 26) | ((s[1] & 0x1FFF) << 13) | (s[0] & 0x1FFF));
+	      d[n++] = rolPackSwap((((ich >> 5) & 0x3) << 26) | ((s[3] & 0x1FFF) << 13) | (s[2] & 0x1FFF));
+	      d[n++] = rolPackSwap(((iapv & 0x1F) << 26) | ((s[5] & 0x1FFF) << 13) | (s[4] & 0x1FFF));
+	    }
+	}
+      ifiber = (ifiber + 1) & 0xf;
+    }
+  d[n] = rolPackSwap((1u << 31) | (1 << 27) | ((n + 1) & 0x3FFFFF));
+  n++;
+
+  return n;
+}
+
+static double
+timePack(int (*pack)(int, const uint32_t *, int, uint32_t *, uint32_t *),
+	 int layout, const uint32_t *raw, int n, uint32_t *out, uint32_t *scratch,
+	 double seconds)
+{
+  double t0 = now(), t;
+  long npass = 0;
+
+  do
+    {
+      pack(layout, raw, n, out, scratch);
+      npass++;
+      t = now() - t0;
+    }
+  while(t < seconds);
+
+  return 4e-6 * n * npass / t;
+}
+
+static int
+selfTest(int n, double seconds)
+{
+  uint32_t *raw, *out, *out2, *scratch, *back;
+  int layout, nraw, npack, npack2, nback, i;
+  double mbs_s, mbs_v;
+
+  raw = malloc(n * sizeof(uint32_t));
+  back = malloc(n * sizeof(uint32_t));
+  out = malloc(ROL_PACK_MAX_OUT(n) * sizeof(uint32_t));
+  out2 = malloc(ROL_PACK_MAX_OUT(n) * sizeof(uint32_t));
+  scratch = malloc(ROL_PACK_SCRATCH(n) * sizeof(uint32_t));
+  if(!raw || !back || !out || !out2 || !scratch)
+    {
+      fprintf(stderr, "out of memory\n");
+      return 1;
+    }
+
+  srand48(1);
+  for(layout = 0; layout < ROL_PACK_NLAYOUT; layout++)
+    {
+      nraw = (layout == ROL_PACK_FADC) ? makeFadc(raw, n) : makeMpd(raw, n);
+
+      npack = rolPackEncodeScalar(layout, raw, nraw, out, scratch);
+      npack2 = rolPackEncode(layout, raw, nraw, out2, scratch);
+      if((npack != npack2) || memcmp(out, out2, npack * sizeof(uint32_t)))
+	{
+	  fprintf(stderr, "%s: ERROR: packers differ (%d / %d words)\n",
+		  rolPackLayout[layout].name, npack, npack2);
+	  return 1;
+	}
+
+      nback = rolPackDecode(out, npack, back, n);
+      if(nback != nraw)
+	{
+	  fprintf(stderr, "%s: ERROR: unpacked %d words, not %d\n",
+		  rolPackLayout[layout].name, nback, nraw);
+	  return 1;
+	}
+      for(i = 0; i < nraw; i++)
+	if(back[i] != raw[i])
+	  {
+	    fprintf(stderr, "%s: ERROR: word %d unpacked 0x%08x, not 0x%08x\n",
+		    rolPackLayout[layout].name, i, back[i], raw[i]);
+	    return 1;
+	  }
+
+      mbs_s = timePack(rolPackEncodeScalar, layout, raw, nraw, out, scratch, seconds);
+      mbs_v = timePack(rolPackEncode, layout, raw, nraw, out, scratch, seconds);
+
+      printf("%-5s %7d -> %7d words (x %.2f)  scalar %7.1f MB/s  %s %7.1f MB/s\n",
+	     rolPackLayout[layout].name, nraw, npack, (double) nraw / npack, mbs_s,
+#if defined(__SSE2__)
+	     "sse2",
+#else
+	     "scalar",
+#endif
+	     mbs_v);
+    }
+
+  free(raw);
+  free(back);
+  free(out);
+  free(out2);
+  free(scratch);
+
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  const char *outName = NULL;
+  FILE *fin, *fout = NULL;
+  uint32_t *in, *out;
+  long size;
+  int ch, test = 0, n = 100000, pos, nbank = 0, nin, nout;
+  double seconds = 1.;
+
+  while((ch = getopt(argc, argv, "o:tn:s:h")) != -1)
+    {
+      switch(ch)
+	{
+	case 'o':
+	  outName = optarg;
+	  break;
+	case 't':
+	  test = 1;
+	  break;
+	case 'n':
+	  n = atoi(optarg);
+	  break;
+	case 's':
+	  seconds = atof(optarg);
+	  break;
+	default:
+	  fprintf(stderr,
+		  "Usage: %s [-o outfile] infile\n"
+		  "       %s -t [-n words] [-s seconds]\n", argv[0], argv[0]);
+	  return 1;
+	}
+    }
+
+  if(test)
+    return selfTest(n, seconds);
+
+  if(optind >= argc)
+    {
+      fprintf(stderr, "%s: no input file given\n", argv[0]);
+      return 1;
+    }
+
+  fin = fopen(argv[optind], "rb");
+  if(fin == NULL)
+    {
+      fprintf(stderr, "%s: unable to read %s\n", argv[0], argv[optind]);
+      return 1;
+    }
+  fseek(fin, 0, SEEK_END);
+  size = ftell(fin) / sizeof(uint32_t);
+  fseek(fin, 0, SEEK_SET);
+  in = malloc((size + 1) * sizeof(uint32_t));
+  if((in == NULL) || (fread(in, sizeof(uint32_t), size, fin) != size))
+    {
+      fprintf(stderr, "%s: unable to read %s\n", argv[0], argv[optind]);
+      return 1;
+    }
+  fclose(fin);
+
+  if(outName)
+    {
+      fout = fopen(outName, "wb");
+      if(fout == NULL)
+	{
+	  fprintf(stderr, "%s: unable to write %s\n", argv[0], outName);
+	  return 1;
+	}
+    }
+
+  for(pos = 0; pos + ROL_PACK_HEADER <= size; pos += nin)
+    {
+      nin = in[pos + 2];
+      out = malloc((in[pos + 1] + 1) * sizeof(uint32_t));
+      nout = (out) ? rolPackDecode(&in[pos], size - pos, out, in[pos + 1]) : -1;
+      if((nin < ROL_PACK_HEADER) || (nout < 0))
+	{
+	  fprintf(stderr, "%s: word %d: not a packed bank\n", argv[0], pos);
+	  return 1;
+	}
+
+      printf("bank %d: %s, %d -> %d words\n", nbank++,
+	     rolPackLayout[(in[pos] >> 8) & 0xFF].name, nin, nout);
+      if(fout)
+	fwrite(out, sizeof(uint32_t), nout, fout);
+      free(out);
+    }
+
+  if(fout)
+    fclose(fout);
+  free(in);
+
+  return 0;
+}